@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Enqueues synthetic frames and drains them in batches with the trace hook
+ * writing Chrome trace events, to be loaded in chrome://tracing or Perfetto:
+ *
+ *   ./chrome_trace > trace.json
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "kbvas.h"
+#include "kbvas_ring_backend.h"
+#include "kbvas_clock.h"
+
+#define NR_FRAMES			64
+#define BATCH_COUNT			8
+
+static const char *names[] = {
+	[KBVAS_TRACE_PARSE] = "parse",
+	[KBVAS_TRACE_ENCODE] = "encode",
+	[KBVAS_TRACE_PUSH] = "push",
+	[KBVAS_TRACE_BATCH_CALLBACK] = "batch_callback",
+	[KBVAS_TRACE_ITERATE] = "iterate",
+};
+
+static void write_event(struct kbvas *self, kbvas_trace_point_t point,
+		bool begin, uint64_t timestamp, void *ctx)
+{
+	FILE *out = (FILE *)ctx;
+	static bool first = true;
+
+	fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+			"\"pid\":1,\"tid\":1}",
+			first ? "" : ",\n", names[point], begin ? 'B' : 'E',
+			(double)timestamp / 1e3);
+	first = false;
+}
+
+static bool visit(struct kbvas *self, const struct kbvas_entry *entry,
+		void *ctx)
+{
+	return true;
+}
+
+static void on_batch_ready(struct kbvas *self, void *ctx)
+{
+	kbvas_iterate(self, visit, NULL);
+	kbvas_clear_batch(self);
+}
+
+static size_t make_frame(uint8_t *buf, uint32_t timestamp)
+{
+	size_t n = 0;
+
+	buf[n++] = KBVAS_TLV_TIMESTAMP; buf[n++] = 4;
+	buf[n++] = (uint8_t)(timestamp >> 24);
+	buf[n++] = (uint8_t)(timestamp >> 16);
+	buf[n++] = (uint8_t)(timestamp >> 8);
+	buf[n++] = (uint8_t)timestamp;
+	buf[n++] = KBVAS_TLV_VIN; buf[n++] = 17;
+	memcpy(&buf[n], "5YJZEC8E02A135025", 17); n += 17;
+	buf[n++] = KBVAS_TLV_SOC; buf[n++] = 1; buf[n++] = 0xc6;
+	buf[n++] = KBVAS_TLV_BSV; buf[n++] = 0; buf[n++] = 96;
+	for (int i = 0; i < 96; i++) {
+		buf[n++] = (uint8_t)(0x96 + i % 3);
+	}
+
+	return n;
+}
+
+int main(void)
+{
+	struct kbvas_backend_api *backend = kbvas_ring_backend_create(
+			BATCH_COUNT * 2, KBVAS_RING_OVERFLOW_REJECT);
+	struct kbvas *kbvas = kbvas_create(backend, NULL);
+	uint8_t frame[256];
+	int rc = 0;
+
+	if (kbvas == NULL) {
+		return 1;
+	}
+
+	kbvas_set_batch_count(kbvas, BATCH_COUNT);
+	kbvas_register_batch_callback(kbvas, on_batch_ready, NULL);
+	kbvas_set_clock(kbvas, kbvas_clock_monotonic_ns);
+	kbvas_register_trace_hook(kbvas, write_event, stdout);
+
+	printf("{\"traceEvents\":[\n");
+	for (uint32_t i = 1; i <= NR_FRAMES; i++) {
+		if (kbvas_enqueue(kbvas, frame, make_frame(frame, i))
+				!= KBVAS_ERROR_NONE) {
+			rc = 1;
+			break;
+		}
+	}
+	printf("\n]}\n");
+
+	kbvas_destroy(kbvas);
+	kbvas_ring_backend_destroy(backend);
+
+	return rc;
+}
@@ -6,6 +6,7 @@
 
 #include "kbvas.h"
 
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -26,408 +27,3051 @@
 #endif
 
 #define MIN_TLV_LEN			6
+#define STREAM_VALUE_BUFSIZE		32
+#define PACKED_HEADER_SIZE		4 /* count, base and width */
+#define PEEK_CHUNK			4 /* entries per peek_range() on iterating */
+
+/* The body of a backend_*() wrapper. The start is kept on the stack as
+ * backend calls nest, through iterators calling back into kbvas */
+#if defined(KBVAS_USE_STATS)
+#define RETURN_FROM_BACKEND(self, op, ...)				\
+	do {								\
+		const uint64_t called = read_clock(self);		\
+		const kbvas_error_t err = (*(self)->backend->op)(	\
+				(struct kbvas_backend *)(self)->backend,\
+				__VA_ARGS__);				\
+		return backend_called(self, called, err);		\
+	} while (0)
+#else
+#define RETURN_FROM_BACKEND(self, op, ...)				\
+	return (*(self)->backend->op)(					\
+			(struct kbvas_backend *)(self)->backend, __VA_ARGS__)
+#endif
+
+#if defined(KBVAS_USE_TRACE)
+#define TRACE_BEGIN(self, point)	trace(self, KBVAS_TRACE_##point, true)
+#define TRACE_END(self, point)		trace(self, KBVAS_TRACE_##point, false)
+#else
+#define TRACE_BEGIN(self, point)
+#define TRACE_END(self, point)
+#endif
+
+
+enum stream_state {
+	STREAM_IDLE,
+	STREAM_HEADER,
+	STREAM_VALUE,
+};
+
+/* A run of the oldest entries handed out by kbvas_checkout_batch() */
+struct checkout {
+	kbvas_batch_id_t id; /* 0 once returned by kbvas_nack_batch() */
+	bool acked;          /* waiting for the runs before it to go */
+	size_t count;
+	size_t bytes;        /* as in the running totals, when kept */
+	time_t first;        /* timestamp of its first entry, likewise */
+};
+
+#if defined(KBVAS_USE_CHANGE_FILTER)
+struct sample {
+	time_t timestamp;
+	struct kbvas_data data;
+};
+#endif
+
+struct kbvas {
+	struct kbvas_backend_api *backend;
+	void *backend_ctx;
+	kbvas_batch_count_t batch_count;
+	size_t batch_bytes; /* 0 for no byte budget */
+	time_t batch_age;   /* 0 for no age limit */
+
+	/* running totals of the queue, kept while a budget or age is set */
+	size_t queued;
+	size_t queued_bytes;
+	time_t oldest; /* of the entries following the checkouts */
+	time_t newest;
+
+	/* in queue order, from the head of the queue on */
+	struct checkout checkouts[KBVAS_MAX_CHECKOUTS];
+	size_t nr_checkouts;
+	kbvas_batch_id_t last_id;
+
+	kbvas_batch_callback_t batch_cb;
+	void *batch_cb_ctx;
+
+	/* entries in the queue for a backend without a constant-time count(),
+	 * valid while count_known */
+	size_t count;
+	bool count_known;
+
+	/* fingerprints of the last frames enqueued, up to dedup_window of them;
+	 * the oldest is overwritten at dedup_next once the window is full */
+	uint64_t *dedup;
+	size_t dedup_window; /* 0 for no deduplication */
+	size_t dedup_len;
+	size_t dedup_next;
+	size_t duplicates;
+	uint64_t duplicate_bytes;
+
+#if defined(KBVAS_USE_CHANGE_FILTER)
+	struct kbvas_change_filter filter;
+	bool filtering;
+	/* the frame last stored and the one passed to be stored next; which is
+	 * which flips once the latter is stored */
+	struct sample samples[2];
+	unsigned int last_sample;
+	bool has_last_sample;
+	size_t filtered;
+#endif
+
+#if defined(KBVAS_USE_STATS) || defined(KBVAS_USE_TRACE)
+	kbvas_clock_t clock; /* for latencies and trace points, if set */
+#endif
+#if defined(KBVAS_USE_STATS)
+	struct kbvas_stats stats;
+#endif
+#if defined(KBVAS_USE_TRACE)
+	kbvas_trace_hook_t trace_hook;
+	void *trace_ctx;
+#endif
+
+	/* parse buffer for backends without reserve(), allocated once */
+	struct kbvas_entry *scratch;
+	/* decode buffer for iterating records, or PEEK_CHUNK entries for
+	 * backends without iterate(), apart from scratch as the producer
+	 * may be parsing into it meanwhile */
+	struct kbvas_entry *iterbuf;
+#if defined(KBVAS_USE_RAW_ENCODING) && defined(KBVAS_USE_CELL_PACKING)
+	uint8_t *packbuf; /* grows to the largest frame packed so far */
+	size_t packbuf_size;
+#endif
+};
+
+struct kbvas_stream {
+	struct kbvas *kbvas;
+	enum stream_state state;
+	kbvas_error_t err; /* sticky until the end of the frame */
+
+	size_t framesize;
+	size_t received;
+
+	struct kbvas_entry *entry;
+	uint8_t *record; /* frame storage reserved from the backend */
+
+	struct kbvas_tlv tlv;
+	const struct tlv_desc *desc;
+	uint8_t header[3];
+	size_t header_len;
+	size_t header_size;
+
+	uint8_t *value_buf;
+	size_t value_cap;
+	size_t value_received;
+	uint8_t value[STREAM_VALUE_BUFSIZE];
+
+#if defined(KBVAS_USE_BASE64)
+	uint8_t carry[3];
+	size_t carry_len;
+	size_t encoded_len;
+#endif
+};
+
+/* Every known tag is described by one entry below, indexed by its type code
+ * relative to TLV_TYPE_FIRST. Header size, accepted lengths and where the
+ * value lands in struct kbvas_entry are all taken from here, so supporting a
+ * new tag is a matter of adding its row. Unused rows have header_size 0.
+ * Only the timestamp is decoded in base64, so no field offsets there. */
+#define TLV_TYPE_FIRST			KBVAS_TLV_TIMESTAMP
+#define TLV_TYPE_LAST			KBVAS_TLV_ENCRYPTED_VIN
+
+#if defined(KBVAS_USE_RAW_ENCODING)
+#define ENTRY_FIELD(f)			\
+	.offset = offsetof(struct kbvas_entry, f), \
+	.size = sizeof(((struct kbvas_entry *)0)->f)
+#define ENTRY_COUNT(f)			\
+	.count_offset = offsetof(struct kbvas_entry, f), \
+	.count_size = sizeof(((struct kbvas_entry *)0)->f)
+#else
+#define ENTRY_FIELD(f)			.offset = 0
+#define ENTRY_COUNT(f)			.count_offset = 0
+#endif
+
+enum tlv_kind {
+	TLV_KIND_TIMESTAMP,	/* big-endian seconds into kbvas_entry */
+	TLV_KIND_U8,
+	TLV_KIND_U16,		/* big-endian on the wire, native in memory */
+	TLV_KIND_U32,		/* as U16, but any length up to 4 bytes */
+	TLV_KIND_BYTES,		/* byte string truncated to .size */
+	TLV_KIND_ARRAY,		/* byte array with its length kept in a count */
+	TLV_KIND_PACKED,	/* ARRAY packed as in KBVAS_TLV_PACKED_BSV */
+};
+
+struct tlv_desc {
+	uint8_t header_size;
+	uint8_t kind;
+	uint8_t count_size;
+	uint8_t packed_type;	/* stored form of an ARRAY, if any */
+	uint16_t min_len;
+	uint16_t max_len;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t count_offset;
+};
+
+static const struct tlv_desc tlv_descs[TLV_TYPE_LAST - TLV_TYPE_FIRST + 1] = {
+	[KBVAS_TLV_TIMESTAMP - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_TIMESTAMP,
+		.min_len = 4, .max_len = 4,
+	},
+	[KBVAS_TLV_VIN - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_BYTES,
+		.min_len = 1, .max_len = UINT8_MAX, ENTRY_FIELD(data.vin),
+	},
+	[KBVAS_TLV_SOC - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_U8,
+		.min_len = 1, .max_len = 1, ENTRY_FIELD(data.soc),
+	},
+	[KBVAS_TLV_SOH - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_U8,
+		.min_len = 1, .max_len = 1, ENTRY_FIELD(data.soh),
+	},
+	[KBVAS_TLV_BPA - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_U16,
+		.min_len = 2, .max_len = 2, ENTRY_FIELD(data.bpa),
+	},
+	[KBVAS_TLV_BPV - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_U16,
+		.min_len = 2, .max_len = 2, ENTRY_FIELD(data.bpv),
+	},
+	[KBVAS_TLV_BSV - TLV_TYPE_FIRST] = {
+		.header_size = 3, .kind = TLV_KIND_ARRAY,
+		.min_len = 1, .max_len = UINT16_MAX,
+		.packed_type = KBVAS_TLV_PACKED_BSV,
+		ENTRY_FIELD(data.bsv), ENTRY_COUNT(data.bsv_count),
+	},
+	[KBVAS_TLV_BMT - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_ARRAY,
+		.min_len = 1, .max_len = UINT8_MAX,
+		.packed_type = KBVAS_TLV_PACKED_BMT,
+		ENTRY_FIELD(data.bmt), ENTRY_COUNT(data.bmt_count),
+	},
+	[KBVAS_TLV_SESSION_DURATION - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_U32,
+		.min_len = 1, .max_len = 4, ENTRY_FIELD(ext.session_duration),
+	},
+	[KBVAS_TLV_BATTERY_ID - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_ARRAY,
+		.min_len = 1, .max_len = UINT8_MAX,
+		ENTRY_FIELD(ext.battery_id), ENTRY_COUNT(ext.battery_id_len),
+	},
+	[KBVAS_TLV_BSV_MIN_MAX - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_BYTES,
+		.min_len = 2, .max_len = 2, ENTRY_FIELD(ext.bsv_min_max),
+	},
+	[KBVAS_TLV_BMT_MIN_MAX - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_BYTES,
+		.min_len = 2, .max_len = 2, ENTRY_FIELD(ext.bmt_min_max),
+	},
+	[KBVAS_TLV_COUNTER - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_U32,
+		.min_len = 1, .max_len = 4, ENTRY_FIELD(ext.counter),
+	},
+	[KBVAS_TLV_ENCRYPTED_VIN - TLV_TYPE_FIRST] = {
+		.header_size = 2, .kind = TLV_KIND_ARRAY,
+		.min_len = 1, .max_len = UINT8_MAX,
+		ENTRY_FIELD(ext.encrypted_vin),
+		ENTRY_COUNT(ext.encrypted_vin_len),
+	},
+};
+
+/* Private tags found only in stored records, see kbvas_tlv_type_t */
+static const struct tlv_desc packed_descs[] = {
+	[KBVAS_TLV_PACKED_BSV - KBVAS_TLV_PACKED_BSV] = {
+		.header_size = 3, .kind = TLV_KIND_PACKED,
+		.min_len = PACKED_HEADER_SIZE, .max_len = UINT16_MAX,
+		ENTRY_FIELD(data.bsv), ENTRY_COUNT(data.bsv_count),
+	},
+	[KBVAS_TLV_PACKED_BMT - KBVAS_TLV_PACKED_BSV] = {
+		.header_size = 3, .kind = TLV_KIND_PACKED,
+		.min_len = PACKED_HEADER_SIZE, .max_len = UINT16_MAX,
+		ENTRY_FIELD(data.bmt), ENTRY_COUNT(data.bmt_count),
+	},
+};
+
+static const struct tlv_desc *find_tlv_desc(uint8_t type)
+{
+	const uint8_t t = (uint8_t)(type - TLV_TYPE_FIRST);
+
+	if (t > TLV_TYPE_LAST - TLV_TYPE_FIRST || !tlv_descs[t].header_size) {
+		const uint8_t p = (uint8_t)(type - KBVAS_TLV_PACKED_BSV);
+		return p < sizeof(packed_descs) / sizeof(packed_descs[0]) ?
+			&packed_descs[p] : NULL;
+	}
+
+	return &tlv_descs[t];
+}
+
+/* as find_tlv_desc(), without the private tags only stored records carry */
+static const struct tlv_desc *find_frame_tlv_desc(uint8_t type)
+{
+	const struct tlv_desc *desc = find_tlv_desc(type);
+	return desc && desc->kind != TLV_KIND_PACKED ? desc : NULL;
+}
+
+static uint16_t tlv_length(const uint8_t *header, size_t header_size)
+{
+	if (header_size == 3) {
+		return (uint16_t)((uint16_t)header[1] << 8 | header[2]);
+	}
+
+	return header[1];
+}
+
+static size_t parse_tlv(struct kbvas_tlv *tlv, const struct tlv_desc **desc,
+		const uint8_t *data, size_t datasize)
+{
+	*desc = find_tlv_desc(data[0]);
+	const size_t header_size = *desc ? (*desc)->header_size : 0;
+	size_t expected_len;
+
+	memset(tlv, 0, sizeof(*tlv));
+	tlv->type = data[0];
+
+	if (header_size == 0 || datasize <= header_size) {
+		return 0;
+	}
+
+	tlv->length = tlv_length(data, header_size);
+	expected_len = (size_t)tlv->length + header_size;
+
+	if (datasize < expected_len) {
+		return 0;
+	}
+
+	tlv->value = &data[header_size];
+
+	return expected_len;
+}
+
+static uint16_t read_be16(const uint8_t *p)
+{
+	return (uint16_t)((uint16_t)p[0] << 8 | p[1]);
+}
+
+static uint32_t read_be32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+		(uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+static uint32_t read_be(const uint8_t *p, size_t len)
+{
+	uint32_t value = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		value = value << 8 | p[i];
+	}
+
+	return value;
+}
+
+static void write_u16(uint8_t *p, uint16_t value)
+{
+	memcpy(p, &value, sizeof(value));
+}
+
+static void write_u32(uint8_t *p, uint32_t value)
+{
+	memcpy(p, &value, sizeof(value));
+}
+
+static uint8_t *entry_fields(struct kbvas_entry *entry)
+{
+#if defined(KBVAS_USE_RAW_ENCODING)
+	return (uint8_t *)entry;
+#else
+	(void)entry; /* the frame is kept encoded; only the timestamp is used */
+	return NULL;
+#endif
+}
+
+static void write_count(const struct tlv_desc *desc, uint8_t *fields,
+		uint16_t count)
+{
+	if (desc->count_size == sizeof(uint8_t)) {
+		fields[desc->count_offset] = (uint8_t)count;
+	} else {
+		write_u16(&fields[desc->count_offset], count);
+	}
+}
+
+static size_t packed_value_size(size_t count, uint8_t width)
+{
+	return PACKED_HEADER_SIZE + (count * width + 7) / 8;
+}
+
+static void unpack_values(uint8_t *dst, size_t n,
+		const uint8_t *src, uint8_t base, uint8_t width)
+{
+	const unsigned int mask = (1u << width) - 1;
+
+	if (width == 0) {
+		memset(dst, base, n);
+		return;
+	}
+
+	for (size_t i = 0, bit = 0; i < n; i++, bit += width) {
+		unsigned int v = (unsigned int)src[bit / 8] >> (bit % 8);
+		if (bit % 8 + width > 8) {
+			v |= (unsigned int)src[bit / 8 + 1] << (8 - bit % 8);
+		}
+		dst[i] = (uint8_t)(base + (v & mask));
+	}
+}
+
+static kbvas_error_t decode_packed(const struct tlv_desc *desc,
+		const struct kbvas_tlv *tlv, uint8_t *fields)
+{
+	const uint16_t count = read_be16(tlv->value);
+	const uint8_t base = tlv->value[2];
+	const uint8_t width = tlv->value[3];
+
+	if (count == 0 || width > 7 ||
+			tlv->length != packed_value_size(count, width) ||
+			(desc->count_size == sizeof(uint8_t) &&
+					count > UINT8_MAX)) {
+		return KBVAS_ERROR_INVALID_FORMAT;
+	}
+
+	write_count(desc, fields, count);
+	unpack_values(&fields[desc->offset], MIN(count, desc->size),
+			&tlv->value[PACKED_HEADER_SIZE], base, width);
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t decode_value(const struct tlv_desc *desc,
+		const struct kbvas_tlv *tlv, struct kbvas_entry *info)
+{
+	uint8_t *fields = entry_fields(info);
+
+	switch (desc->kind) {
+	case TLV_KIND_TIMESTAMP:
+		info->timestamp = (time_t)read_be32(tlv->value);
+		break;
+	case TLV_KIND_U8:
+		fields[desc->offset] = tlv->value[0];
+		break;
+	case TLV_KIND_U16:
+		write_u16(&fields[desc->offset], read_be16(tlv->value));
+		break;
+	case TLV_KIND_U32:
+		write_u32(&fields[desc->offset],
+				read_be(tlv->value, tlv->length));
+		break;
+	case TLV_KIND_ARRAY:
+		write_count(desc, fields, tlv->length);
+		/* fall through */
+	case TLV_KIND_BYTES:
+		if (tlv->value != &fields[desc->offset]) { /* not in place */
+			memcpy(&fields[desc->offset], tlv->value,
+					MIN(tlv->length, desc->size));
+		}
+		break;
+	case TLV_KIND_PACKED:
+		return decode_packed(desc, tlv, fields);
+	default:
+		return KBVAS_ERROR_INTERNAL;
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t parse_battery(const struct tlv_desc *desc,
+		const struct kbvas_tlv *tlv, struct kbvas_entry *info)
+{
+	if (desc == NULL) {
+		KBVAS_ERROR("Unknown TLV type: 0x%02X", tlv->type);
+		return KBVAS_ERROR_INVALID_TYPE;
+	}
+
+#if defined(KBVAS_USE_BASE64)
+	if (desc->kind != TLV_KIND_TIMESTAMP) {
+		return KBVAS_ERROR_NONE; /* skip other types in base64 */
+	}
+#endif
+	if (tlv->length < desc->min_len || tlv->length > desc->max_len) {
+		return KBVAS_ERROR_INVALID_FORMAT;
+	}
+
+	return decode_value(desc, tlv, info);
+}
+
+/* Resets what parsing does not overwrite. In base64 that is only the
+ * timestamp: the text is written over the buffer and the rest of the entry
+ * is zeroed once its length is known, by clear_entry_tail(). */
+static void clear_entry(struct kbvas_entry *entry)
+{
+#if defined(KBVAS_USE_BASE64)
+	entry->timestamp = 0;
+#else
+	memset(entry, 0, sizeof(*entry));
+#endif
+}
+
+#if defined(KBVAS_USE_BASE64)
+static void clear_entry_tail(struct kbvas_entry *entry, size_t encoded_len)
+{
+	const size_t offset =
+		offsetof(struct kbvas_entry, base64_encoded) + encoded_len;
+
+	memset((uint8_t *)entry + offset, 0, sizeof(*entry) - offset);
+}
+
+static size_t encode_base64(char *buf, size_t bufsize,
+		const void *data, size_t datasize)
+{
+#if defined(KBVAS_USE_FAST_BASE64)
+	return kbvas_base64_encode(buf, bufsize, data, datasize);
+#else
+	return lm_base64_encode(buf, bufsize, data, datasize);
+#endif
+}
+
+/* Fills in the base64 text of the frame following the timestamp TLV */
+static void encode_entry(struct kbvas_entry *entry,
+		const uint8_t *frame, size_t framesize)
+{
+	const size_t len =
+		MIN(framesize - MIN_TLV_LEN, sizeof(entry->base64_encoded));
+	const size_t encoded_len = encode_base64(entry->base64_encoded,
+			sizeof(entry->base64_encoded), &frame[MIN_TLV_LEN], len);
+
+	clear_entry_tail(entry, encoded_len);
+	KBVAS_DEBUG("%lu bytes of data encoded to %lu bytes", len, encoded_len);
+}
+
+static size_t entry_text_len(const struct kbvas_entry *entry)
+{
+	const char *end = (const char *)memchr(entry->base64_encoded, '\0',
+			sizeof(entry->base64_encoded));
+
+	return end? (size_t)(end - entry->base64_encoded) :
+		sizeof(entry->base64_encoded);
+}
+#endif
+
+/* @p stored allows the private tags that only stored records carry */
+static kbvas_error_t process_tlv(const uint8_t *tlv, size_t tlv_len,
+		struct kbvas_entry *info, bool stored)
+{
+	const struct tlv_desc *desc;
+	struct kbvas_tlv item;
+	size_t bytes_parsed = 0;
+
+	for (size_t i = 0; i < tlv_len; i += bytes_parsed) {
+		if ((bytes_parsed = parse_tlv(&item, &desc,
+				&tlv[i], tlv_len - i)) == 0 ||
+				(!stored && desc->kind == TLV_KIND_PACKED)) {
+			KBVAS_ERROR("Failed to parse TLV");
+			return KBVAS_ERROR_INVALID_FORMAT;
+		}
+
+		if (parse_battery(desc, &item, info) != KBVAS_ERROR_NONE) {
+			KBVAS_ERROR("Failed to parse battery info");
+			return KBVAS_ERROR_INVALID_TYPE;
+		}
+
+		KBVAS_DEBUG("TLV type: 0x%02X, length: %d, value %p(%lu)",
+				item.type, item.length, item.value,
+				(uintptr_t)item.value - (uintptr_t)tlv);
+	}
+
+#if defined(KBVAS_USE_RAW_ENCODING)
+	KBVAS_DEBUG("Parsed battery info %lu: %.*s, %u.%u %u, %u %u",
+			info->timestamp, 17, info->data.vin,
+			info->data.soc / 2, info->data.soc * 10 / 2 % 10,
+			info->data.soh,
+			info->data.bpa, info->data.bpv);
+#endif
+	return KBVAS_ERROR_NONE;
+}
+
+static bool has_record_interface(const struct kbvas *self)
+{
+	return self->backend->push_record != NULL;
+}
+
+/* Raw and lazy base64 records hold the frame as received */
+static bool stores_frame(const struct kbvas *self)
+{
+#if defined(KBVAS_USE_RAW_ENCODING) || defined(KBVAS_USE_LAZY_BASE64)
+	return has_record_interface(self);
+#else
+	(void)self;
+	return false;
+#endif
+}
+
+static void make_record(struct kbvas_record *record,
+		const struct kbvas_entry *entry,
+		const uint8_t *frame, size_t framesize)
+{
+	record->timestamp = entry->timestamp;
+#if defined(KBVAS_USE_BASE64) && !defined(KBVAS_USE_LAZY_BASE64)
+	record->data = (const uint8_t *)entry->base64_encoded;
+	record->len = entry_text_len(entry);
+#else
+	record->data = frame;
+	record->len = framesize;
+#endif
+}
+
+/* What an entry counts against the batch byte budget: the length of its
+ * base64 text, or in raw encoding the bytes it takes in the backend */
+static size_t entry_size(const struct kbvas_entry *entry)
+{
+#if defined(KBVAS_USE_BASE64)
+	return entry_text_len(entry);
+#else
+	return sizeof(*entry);
+#endif
+}
+
+static size_t record_size(const struct kbvas_record *record)
+{
+#if defined(KBVAS_USE_LAZY_BASE64)
+	if (record->len < MIN_TLV_LEN) {
+		return 0;
+	}
+	return (record->len - MIN_TLV_LEN + 2) / 3 * 4;
+#else
+	return record->len;
+#endif
+}
+
+static void summarize_entry(struct kbvas_entry *entry)
+{
+#if defined(KBVAS_USE_RAW_ENCODING) && defined(KBVAS_USE_SUMMARY)
+	kbvas_summarize(entry->data.bsv, MIN(entry->data.bsv_count,
+			sizeof(entry->data.bsv)), &entry->bsv_summary);
+	kbvas_summarize(entry->data.bmt, MIN(entry->data.bmt_count,
+			sizeof(entry->data.bmt)), &entry->bmt_summary);
+#else
+	(void)entry;
+#endif
+}
+
+#if defined(KBVAS_USE_CHANGE_FILTER)
+static unsigned int distance(unsigned int a, unsigned int b)
+{
+	return a > b ? a - b : b - a;
+}
+
+static bool has_changed(const struct kbvas_change_filter *filter,
+		const struct sample *last, const struct kbvas_entry *entry)
+{
+	const struct kbvas_data *prev = &last->data;
+	const struct kbvas_data *data = &entry->data;
+
+	if (filter->max_interval &&
+			entry->timestamp - last->timestamp >= filter->max_interval) {
+		return true;
+	}
+
+	if (memcmp(data->vin, prev->vin, sizeof(data->vin)) ||
+			data->bsv_count != prev->bsv_count ||
+			data->bmt_count != prev->bmt_count) {
+		return true;
+	}
+
+	return distance(data->soc, prev->soc) > filter->soc ||
+		distance(data->soh, prev->soh) > filter->soh ||
+		distance(data->bpa, prev->bpa) > filter->bpa ||
+		distance(data->bpv, prev->bpv) > filter->bpv ||
+		kbvas_max_delta(data->bsv, prev->bsv, MIN(data->bsv_count,
+				sizeof(data->bsv))) > filter->bsv ||
+		kbvas_max_delta(data->bmt, prev->bmt, MIN(data->bmt_count,
+				sizeof(data->bmt))) > filter->bmt;
+}
+#endif
+
+/* A parsed entry passing the change filter is copied aside, as the entry may
+ * not be read once committed, and becomes the last stored by keep_sample() */
+static bool passes_filter(struct kbvas *self, const struct kbvas_entry *entry)
+{
+#if defined(KBVAS_USE_CHANGE_FILTER)
+	if (!self->filtering) {
+		return true;
+	}
+
+	if (self->has_last_sample && !has_changed(&self->filter,
+			&self->samples[self->last_sample], entry)) {
+		self->filtered++;
+		return false;
+	}
+
+	struct sample *next = &self->samples[!self->last_sample];
+	next->timestamp = entry->timestamp;
+	memcpy(&next->data, &entry->data, sizeof(next->data));
+#else
+	(void)self;
+	(void)entry;
+#endif
+	return true;
+}
+
+static void keep_sample(struct kbvas *self)
+{
+#if defined(KBVAS_USE_CHANGE_FILTER)
+	if (self->filtering) {
+		self->last_sample = !self->last_sample;
+		self->has_last_sample = true;
+	}
+#else
+	(void)self;
+#endif
+}
+
+static kbvas_error_t decode_record(const struct kbvas_record *record,
+		struct kbvas_entry *entry)
+{
+	clear_entry(entry);
+#if defined(KBVAS_USE_LAZY_BASE64)
+	if (record->len < MIN_TLV_LEN) {
+		return KBVAS_ERROR_INVALID_FORMAT;
+	}
+	encode_entry(entry, record->data, record->len);
+#elif defined(KBVAS_USE_BASE64)
+	if (record->len >= sizeof(entry->base64_encoded)) {
+		return KBVAS_ERROR_INVALID_FORMAT;
+	}
+	if (record->len) {
+		memcpy(entry->base64_encoded, record->data, record->len);
+	}
+	clear_entry_tail(entry, record->len);
+#else
+	kbvas_error_t err = process_tlv(record->data, record->len, entry, true);
+	if (err != KBVAS_ERROR_NONE) {
+		return err;
+	}
+	summarize_entry(entry);
+#endif
+	entry->timestamp = record->timestamp;
+
+	return KBVAS_ERROR_NONE;
+}
+
+#if defined(KBVAS_USE_RAW_ENCODING) && defined(KBVAS_USE_CELL_PACKING)
+static uint8_t bit_width(unsigned int range)
+{
+	uint8_t width = 0;
+
+	while (range >> width) {
+		width++;
+	}
+
+	return width;
+}
+
+/* Writes the packed form of @p tlv to @p dst and returns its size, or
+ * returns 0 if it would not be smaller than the @p tlv_size bytes it takes. */
+static size_t pack_tlv(uint8_t *dst, uint8_t packed_type,
+		const struct kbvas_tlv *tlv, size_t tlv_size)
+{
+	uint8_t lo = UINT8_MAX;
+	uint8_t hi = 0;
+
+	for (size_t i = 0; i < tlv->length; i++) {
+		lo = tlv->value[i] < lo ? tlv->value[i] : lo;
+		hi = tlv->value[i] > hi ? tlv->value[i] : hi;
+	}
+
+	const uint8_t width = bit_width((unsigned int)(hi - lo));
+	const size_t len = packed_value_size(tlv->length, width);
+
+	if (width >= 8 || 3 + len >= tlv_size) {
+		return 0;
+	}
+
+	dst[0] = packed_type;
+	dst[1] = (uint8_t)(len >> 8);
+	dst[2] = (uint8_t)len;
+	dst[3] = (uint8_t)(tlv->length >> 8);
+	dst[4] = (uint8_t)tlv->length;
+	dst[5] = lo;
+	dst[6] = width;
+
+	uint8_t *out = &dst[3 + PACKED_HEADER_SIZE];
+	memset(out, 0, len - PACKED_HEADER_SIZE);
+
+	for (size_t i = 0, bit = 0; width && i < tlv->length;
+			i++, bit += width) {
+		const unsigned int v =
+			(unsigned int)(tlv->value[i] - lo) << (bit % 8);
+		out[bit / 8] |= (uint8_t)v;
+		if (bit % 8 + width > 8) {
+			out[bit / 8 + 1] |= (uint8_t)(v >> 8);
+		}
+	}
+
+	return 3 + len;
+}
+
+/* Packs the cell arrays of a validated frame. Returns @p frame itself when
+ * there is nothing to gain, otherwise the packed copy in self->packbuf. */
+static const uint8_t *pack_frame(struct kbvas *self,
+		const uint8_t *frame, size_t *framesize)
+{
+	const struct tlv_desc *desc;
+	struct kbvas_tlv tlv;
+	size_t n = 0;
+	size_t len;
+	bool packed = false;
+
+	if (self->packbuf_size < *framesize) {
+		uint8_t *p = (uint8_t *)realloc(self->packbuf, *framesize);
+		if (p == NULL) {
+			return frame; /* stored unpacked */
+		}
+		self->packbuf = p;
+		self->packbuf_size = *framesize;
+	}
+
+	for (size_t i = 0; i < *framesize; i += len) {
+		if ((len = parse_tlv(&tlv, &desc,
+				&frame[i], *framesize - i)) == 0) {
+			return frame;
+		}
+
+		const size_t packed_len = desc->packed_type ?
+			pack_tlv(&self->packbuf[n], desc->packed_type,
+					&tlv, len) : 0;
+
+		if (packed_len) {
+			packed = true;
+			n += packed_len;
+		} else {
+			memcpy(&self->packbuf[n], &frame[i], len);
+			n += len;
+		}
+	}
+
+	if (!packed) {
+		return frame;
+	}
+
+	*framesize = n;
+	return self->packbuf;
+}
+#endif
+
+static bool tracks_batch(const struct kbvas *self)
+{
+	return self->batch_bytes != 0 || self->batch_age != 0;
+}
+
+/* Whether pushes are to tell the size of what they store */
+static bool sizes_entries(const struct kbvas *self)
+{
+#if defined(KBVAS_USE_STATS)
+	return true;
+#else
+	return tracks_batch(self);
+#endif
+}
+
+#if defined(KBVAS_USE_STATS) || defined(KBVAS_USE_TRACE)
+static uint64_t read_clock(const struct kbvas *self)
+{
+	return self->clock ? (*self->clock)() : 0;
+}
+#endif
+
+#if defined(KBVAS_USE_TRACE)
+static void trace(struct kbvas *self, kbvas_trace_point_t point, bool begin)
+{
+	if (self->trace_hook) {
+		(*self->trace_hook)(self, point, begin, read_clock(self),
+				self->trace_ctx);
+	}
+}
+#endif
+
+#if defined(KBVAS_USE_STATS)
+static void count_latency(const struct kbvas *self,
+		uint32_t buckets[KBVAS_STATS_LATENCY_BUCKETS], uint64_t start)
+{
+	if (!self->clock) {
+		return;
+	}
+
+	uint64_t ticks = (*self->clock)() - start;
+	unsigned int i = 0;
+
+	while ((ticks >>= 1) && i < KBVAS_STATS_LATENCY_BUCKETS - 1) {
+		i++;
+	}
+
+	buckets[i]++;
+}
+
+static kbvas_error_t backend_called(struct kbvas *self, uint64_t start,
+		kbvas_error_t err)
+{
+	self->stats.backend_calls++;
+	if (err != KBVAS_ERROR_NONE && err != KBVAS_ERROR_NOENT) {
+		self->stats.backend_errors++;
+	}
+	count_latency(self, self->stats.backend_latency, start);
+
+	return err;
+}
+#endif
+
+static kbvas_error_t backend_push(struct kbvas *self,
+		const struct kbvas_entry *entry)
+{
+	RETURN_FROM_BACKEND(self, push, entry, self->backend_ctx);
+}
+
+static kbvas_error_t backend_pop(struct kbvas *self, struct kbvas_entry *entry)
+{
+	RETURN_FROM_BACKEND(self, pop, entry, self->backend_ctx);
+}
+
+static kbvas_error_t backend_peek(struct kbvas *self, int index,
+		struct kbvas_entry *entry)
+{
+	RETURN_FROM_BACKEND(self, peek, index, entry, self->backend_ctx);
+}
+
+static kbvas_error_t backend_drop(struct kbvas *self, size_t n)
+{
+	RETURN_FROM_BACKEND(self, drop, n, self->backend_ctx);
+}
+
+static kbvas_error_t backend_clear(struct kbvas *self)
+{
+	RETURN_FROM_BACKEND(self, clear, self->backend_ctx);
+}
+
+static kbvas_error_t backend_count(struct kbvas *self, size_t *count)
+{
+	RETURN_FROM_BACKEND(self, count, count, self->backend_ctx);
+}
+
+static kbvas_error_t backend_iterate(struct kbvas *self,
+		kbvas_iterator_t iterator, void *ctx)
+{
+	RETURN_FROM_BACKEND(self, iterate, iterator, ctx, self);
+}
+
+static kbvas_error_t backend_push_record(struct kbvas *self,
+		const struct kbvas_record *record)
+{
+	RETURN_FROM_BACKEND(self, push_record, record, self->backend_ctx);
+}
+
+static kbvas_error_t backend_peek_record(struct kbvas *self, int index,
+		struct kbvas_record *record)
+{
+	RETURN_FROM_BACKEND(self, peek_record, index, record,
+			self->backend_ctx);
+}
+
+static kbvas_error_t backend_iterate_records(struct kbvas *self,
+		kbvas_record_iterator_t iterator, void *ctx)
+{
+	RETURN_FROM_BACKEND(self, iterate_records, iterator, ctx, self);
+}
+
+static kbvas_error_t backend_reserve(struct kbvas *self,
+		struct kbvas_entry **entry)
+{
+	RETURN_FROM_BACKEND(self, reserve, entry, self->backend_ctx);
+}
+
+static kbvas_error_t backend_commit(struct kbvas *self,
+		struct kbvas_entry *entry)
+{
+	RETURN_FROM_BACKEND(self, commit, entry, self->backend_ctx);
+}
+
+static kbvas_error_t backend_reserve_record(struct kbvas *self, size_t size,
+		uint8_t **buf)
+{
+	RETURN_FROM_BACKEND(self, reserve_record, size, buf,
+			self->backend_ctx);
+}
+
+static kbvas_error_t backend_commit_record(struct kbvas *self,
+		const struct kbvas_record *record)
+{
+	RETURN_FROM_BACKEND(self, commit_record, record, self->backend_ctx);
+}
+
+static kbvas_error_t backend_push_many(struct kbvas *self,
+		const struct kbvas_entry *entries, size_t n, size_t *pushed)
+{
+	RETURN_FROM_BACKEND(self, push_many, entries, n, pushed,
+			self->backend_ctx);
+}
+
+static kbvas_error_t backend_pop_many(struct kbvas *self,
+		struct kbvas_entry *entries, size_t n, size_t *popped)
+{
+	RETURN_FROM_BACKEND(self, pop_many, entries, n, popped,
+			self->backend_ctx);
+}
+
+static kbvas_error_t backend_peek_range(struct kbvas *self, size_t start,
+		struct kbvas_entry *entries, size_t n, size_t *peeked)
+{
+	RETURN_FROM_BACKEND(self, peek_range, start, entries, n, peeked,
+			self->backend_ctx);
+}
+
+/* Only where nothing but kbvas changes the queue, as the count would go
+ * stale otherwise */
+static bool keeps_count(const struct kbvas *self)
+{
+	return (self->backend->caps & (KBVAS_BACKEND_CAP_CONST_COUNT |
+			KBVAS_BACKEND_CAP_KBVAS_ONLY)) ==
+		KBVAS_BACKEND_CAP_KBVAS_ONLY;
+}
+
+/* The kept count follows what the backend did, or is counted afresh when a
+ * call failed partway and it is not known what it did */
+static void count_pushed(struct kbvas *self, kbvas_error_t err, size_t n)
+{
+	if (!keeps_count(self)) {
+		return;
+	}
+
+	if (err != KBVAS_ERROR_NONE) {
+		self->count_known = false;
+	} else {
+		self->count += n;
+	}
+}
+
+static void count_removed(struct kbvas *self, kbvas_error_t err, size_t n)
+{
+	if (!keeps_count(self) || err == KBVAS_ERROR_NOENT) {
+		return;
+	}
+
+	if (err != KBVAS_ERROR_NONE) {
+		self->count_known = false;
+	} else {
+		self->count -= MIN(n, self->count);
+	}
+}
+
+/* @p size is set to entry_size() or record_size() of what was pushed, though
+ * only when the totals are kept */
+static kbvas_error_t push_entry(struct kbvas *self,
+		const struct kbvas_entry *entry,
+		const uint8_t *frame, size_t framesize, size_t *size)
+{
+	kbvas_error_t err;
+
+	if (has_record_interface(self)) {
+		struct kbvas_record record;
+#if defined(KBVAS_USE_RAW_ENCODING) && defined(KBVAS_USE_CELL_PACKING)
+		frame = pack_frame(self, frame, &framesize);
+#endif
+		make_record(&record, entry, frame, framesize);
+		*size = record_size(&record);
+		err = backend_push_record(self, &record);
+	} else {
+		*size = sizes_entries(self) ? entry_size(entry) : 0;
+		err = backend_push(self, entry);
+	}
+
+	count_pushed(self, err, 1);
+
+	return err;
+}
+
+static bool has_reserve_interface(const struct kbvas *self)
+{
+	return self->backend->reserve != NULL && self->backend->commit != NULL;
+}
+
+static kbvas_error_t get_scratch(struct kbvas *self,
+		struct kbvas_entry **entry)
+{
+	if (self->scratch == NULL && (self->scratch = (struct kbvas_entry *)
+			calloc(1, sizeof(*self->scratch))) == NULL) {
+		return KBVAS_ERROR_OOM;
+	}
+
+	*entry = self->scratch;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t reserve_entry(struct kbvas *self,
+		struct kbvas_entry **entry)
+{
+	if (has_reserve_interface(self)) {
+		return backend_reserve(self, entry);
+	}
+
+	return get_scratch(self, entry);
+}
+
+static kbvas_error_t commit_entry(struct kbvas *self,
+		struct kbvas_entry *entry,
+		const uint8_t *frame, size_t framesize, size_t *size)
+{
+	if (!has_record_interface(self)) { /* records summarize on decoding */
+		summarize_entry(entry);
+	}
+
+	if (has_reserve_interface(self)) {
+		*size = sizes_entries(self) ? entry_size(entry) : 0;
+		kbvas_error_t err = backend_commit(self, entry);
+		count_pushed(self, err, 1);
+		return err;
+	}
+
+	return push_entry(self, entry, frame, framesize, size);
+}
+
+static kbvas_error_t peek_record(struct kbvas *self, int entry_index,
+		struct kbvas_entry *entry)
+{
+	if (!self->backend->peek_record) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	struct kbvas_record record;
+	kbvas_error_t err = backend_peek_record(self, entry_index, &record);
+
+	if (err == KBVAS_ERROR_NONE && entry != NULL) {
+		err = decode_record(&record, entry);
+	}
+
+	return err;
+}
+
+static kbvas_error_t pop_record(struct kbvas *self, struct kbvas_entry *entry)
+{
+	if (!self->backend->drop) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	kbvas_error_t err = peek_record(self, 0, entry);
+
+	if (err == KBVAS_ERROR_NONE) {
+		err = backend_drop(self, 1);
+		count_removed(self, err, 1);
+	}
+
+	return err;
+}
+
+struct record_iterator_adapter {
+	kbvas_iterator_t iterator;
+	void *ctx;
+	struct kbvas_entry *entry;
+};
+
+static bool iterate_record_as_entry(struct kbvas *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	struct record_iterator_adapter *adapter =
+		(struct record_iterator_adapter *)ctx;
+
+	if (decode_record(record, adapter->entry) != KBVAS_ERROR_NONE) {
+		KBVAS_ERROR("Failed to decode record");
+		return true;
+	}
+
+	return (*adapter->iterator)(self, adapter->entry, adapter->ctx);
+}
+
+static kbvas_error_t iterate_records(struct kbvas *self,
+		kbvas_record_iterator_t iterator, void *ctx)
+{
+	if (!self->backend->iterate_records) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	return backend_iterate_records(self, iterator, ctx);
+}
+
+/* A range of entries read in one walk, for backends whose peek at an index
+ * walks up to it */
+struct range_reader {
+	size_t skip;
+	struct kbvas_entry *entries;
+	size_t n;
+	size_t read;
+	kbvas_error_t err;
+};
+
+static bool read_entry(struct kbvas *self,
+		const struct kbvas_entry *entry, void *ctx)
+{
+	struct range_reader *reader = (struct range_reader *)ctx;
+
+	if (reader->skip) {
+		reader->skip--;
+		return true;
+	}
+
+	memcpy(&reader->entries[reader->read], entry, sizeof(*entry));
+
+	return ++reader->read < reader->n;
+}
+
+static bool read_record(struct kbvas *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	struct range_reader *reader = (struct range_reader *)ctx;
+
+	if (reader->skip) {
+		reader->skip--;
+		return true;
+	}
+
+	reader->err = decode_record(record, &reader->entries[reader->read]);
+
+	return reader->err == KBVAS_ERROR_NONE && ++reader->read < reader->n;
+}
+
+static kbvas_error_t read_range(struct kbvas *self, size_t start,
+		struct kbvas_entry *entries, size_t n, size_t *peeked)
+{
+	struct range_reader reader = {
+		.skip = start,
+		.entries = entries,
+		.n = n,
+	};
+	kbvas_error_t err = has_record_interface(self) ?
+		backend_iterate_records(self, read_record, &reader) :
+		backend_iterate(self, read_entry, &reader);
+
+	*peeked = reader.read;
+
+	return err != KBVAS_ERROR_NONE ? err : reader.err;
+}
+
+static bool has_random_peek(const struct kbvas *self)
+{
+	return (self->backend->caps & KBVAS_BACKEND_CAP_RANDOM_PEEK) != 0;
+}
+
+/* Peeks at up to @p n entries from @p start with as few calls as the backend
+ * allows. Running out of entries is not an error. */
+static kbvas_error_t peek_entries(struct kbvas *self, size_t start,
+		struct kbvas_entry *entries, size_t n, size_t *peeked)
+{
+	*peeked = 0;
+
+	if (n == 0) {
+		return KBVAS_ERROR_NONE;
+	}
+
+	if (!has_record_interface(self) && self->backend->peek_range) {
+		return backend_peek_range(self, start, entries, n, peeked);
+	}
+
+	if (!has_random_peek(self) && (has_record_interface(self) ?
+			self->backend->iterate_records != NULL :
+			self->backend->iterate != NULL)) {
+		return read_range(self, start, entries, n, peeked);
+	}
+
+	if (!has_record_interface(self) && !self->backend->peek) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	for (; *peeked < n && start + *peeked <= INT_MAX; (*peeked)++) {
+		const int index = (int)(start + *peeked);
+		struct kbvas_entry *entry = &entries[*peeked];
+		kbvas_error_t err = has_record_interface(self) ?
+			peek_record(self, index, entry) :
+			backend_peek(self, index, entry);
+
+		if (err == KBVAS_ERROR_NOENT) {
+			break;
+		} else if (err != KBVAS_ERROR_NONE) {
+			return err;
+		}
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+/* For a backend without iterate(), a few entries at a time */
+static kbvas_error_t iterate_in_chunks(struct kbvas *self,
+		kbvas_iterator_t iterator, void *ctx)
+{
+	if (!self->backend->peek_range && !self->backend->peek) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	struct kbvas_entry *chunk = self->iterbuf;
+	kbvas_error_t err;
+	size_t start = 0;
+	size_t peeked;
+	bool more = true;
+
+	do {
+		err = peek_entries(self, start, chunk, PEEK_CHUNK, &peeked);
+
+		for (size_t i = 0; err == KBVAS_ERROR_NONE && i < peeked; i++) {
+			if (!(*iterator)(self, &chunk[i], ctx)) {
+				more = false;
+				break;
+			}
+		}
+
+		start += peeked;
+	} while (err == KBVAS_ERROR_NONE && more && peeked == PEEK_CHUNK);
+
+	return err;
+}
+
+static kbvas_error_t iterate_entries(struct kbvas *self,
+		kbvas_iterator_t iterator, void *ctx)
+{
+	if (has_record_interface(self)) {
+		struct record_iterator_adapter adapter = {
+			.iterator = iterator,
+			.ctx = ctx,
+			.entry = self->iterbuf,
+		};
+
+		return iterate_records(self, iterate_record_as_entry, &adapter);
+	}
+
+	if (!self->backend->iterate) {
+		return iterate_in_chunks(self, iterator, ctx);
+	}
+
+	return backend_iterate(self, iterator, ctx);
+}
+
+/* A walk over the oldest entries, for the running totals and the batch */
+struct head_scan {
+	size_t skip;     /* entries passed over before taking any in */
+	size_t n;        /* entries to take in at most */
+	size_t budget;   /* bytes to take in at most, if not 0 */
+	size_t index;    /* entries visited, skipped ones included */
+	size_t bytes;    /* of the entries taken in */
+	time_t first;
+	time_t last;
+	time_t next;     /* of the entry following them, if has_next */
+	bool has_next;
+};
+
+static size_t scanned(const struct head_scan *scan)
+{
+	return scan->index - MIN(scan->skip, scan->index);
+}
+
+static bool scan_item(struct head_scan *scan, time_t timestamp, size_t size)
+{
+	if (scan->index < scan->skip) {
+		scan->index++;
+		return true;
+	}
+	/* the first entry is taken in even if it alone is over budget */
+	if (scanned(scan) == scan->n || (scan->budget && scanned(scan) &&
+			scan->bytes + size > scan->budget)) {
+		scan->next = timestamp;
+		scan->has_next = true;
+		return false;
+	}
+
+	if (scanned(scan) == 0) {
+		scan->first = timestamp;
+	}
+	scan->index++;
+	scan->last = timestamp;
+	scan->bytes += size;
+
+	return true;
+}
+
+static bool scan_entry(struct kbvas *self,
+		const struct kbvas_entry *entry, void *ctx)
+{
+	return scan_item((struct head_scan *)ctx,
+			entry->timestamp, entry_size(entry));
+}
+
+static bool scan_record(struct kbvas *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	return scan_item((struct head_scan *)ctx,
+			record->timestamp, record_size(record));
+}
+
+static void scan_queue(struct kbvas *self, struct head_scan *scan)
+{
+	if (has_record_interface(self)) {
+		iterate_records(self, scan_record, scan);
+	} else {
+		iterate_entries(self, scan_entry, scan);
+	}
+}
+
+/* Entries at the head of the queue that belong to a checkout */
+static size_t count_covered(const struct kbvas *self)
+{
+	size_t n = 0;
+
+	for (size_t i = 0; i < self->nr_checkouts; i++) {
+		n += self->checkouts[i].count;
+	}
+
+	return n;
+}
+
+/* Entries checked out and not returned, and their bytes */
+static size_t count_checked_out(const struct kbvas *self, size_t *bytes)
+{
+	size_t n = 0;
+
+	*bytes = 0;
+
+	for (size_t i = 0; i < self->nr_checkouts; i++) {
+		if (self->checkouts[i].id) {
+			n += self->checkouts[i].count;
+			*bytes += self->checkouts[i].bytes;
+		}
+	}
+
+	return n;
+}
+
+/* Recounts the totals from the queue itself */
+static void resync(struct kbvas *self)
+{
+	size_t start = 0;
+
+	self->queued_bytes = 0;
+
+	for (size_t i = 0; i < self->nr_checkouts; i++) {
+		struct checkout *c = &self->checkouts[i];
+		struct head_scan scan = { .skip = start, .n = c->count };
+
+		scan_queue(self, &scan);
+
+		c->bytes = scan.bytes;
+		c->first = scan.first;
+		self->queued_bytes += c->bytes;
+		start += c->count;
+	}
+
+	struct head_scan scan = { .skip = start, .n = SIZE_MAX };
+
+	scan_queue(self, &scan);
+
+	self->queued = start + scanned(&scan);
+	self->queued_bytes += scan.bytes;
+	self->oldest = scan.first;
+	if (scanned(&scan)) {
+		self->newest = scan.last;
+	}
+}
+
+/* Takes the entries @p scan covered off the totals once they are gone */
+static void untrack(struct kbvas *self, const struct head_scan *scan)
+{
+	self->queued -= MIN(scanned(scan), self->queued);
+	self->queued_bytes -= MIN(scan->bytes, self->queued_bytes);
+
+	if (scan->has_next) {
+		self->oldest = scan->next;
+	}
+}
+
+static void clear_all(struct kbvas *self)
+{
+	if (!self->backend->clear) {
+		KBVAS_ERROR("No support for clear()");
+		return;
+	}
+
+	kbvas_error_t err = backend_clear(self);
+	if (err != KBVAS_ERROR_NONE) {
+		KBVAS_ERROR("Failed to clear all: %d", err);
+	}
+	count_removed(self, err, SIZE_MAX);
+
+	/* written only when in use, as kbvas_enqueue() may be reading them on
+	 * another thread over a ring backend */
+	if (tracks_batch(self)) {
+		self->queued = 0;
+		self->queued_bytes = 0;
+	}
+	if (self->nr_checkouts) {
+		self->nr_checkouts = 0;
+	}
+}
+
+/* Entry backends without drop() have their entries popped and discarded */
+static kbvas_error_t pop_entries(struct kbvas *self, size_t n)
+{
+	struct kbvas_entry *entry;
+	size_t popped;
+
+	if (self->backend->pop_many) {
+		return backend_pop_many(self, NULL, n, &popped);
+	}
+
+	kbvas_error_t err = get_scratch(self, &entry);
+
+	for (size_t i = 0; err == KBVAS_ERROR_NONE && i < n; i++) {
+		err = backend_pop(self, entry);
+	}
+
+	return err == KBVAS_ERROR_NOENT ? KBVAS_ERROR_NONE : err;
+}
+
+static kbvas_error_t drop_entries(struct kbvas *self, size_t n)
+{
+	if (!self->backend->drop && (has_record_interface(self) ||
+			(!self->backend->pop_many && !self->backend->pop))) {
+		KBVAS_ERROR("No support for drop()");
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	kbvas_error_t err = self->backend->drop ?
+		backend_drop(self, n) :
+		pop_entries(self, n);
+	count_removed(self, err, n);
+	if (err != KBVAS_ERROR_NONE) {
+		KBVAS_ERROR("Failed to drop %zu entries: %d", n, err);
+	}
+
+	return err;
+}
+
+static void clear_entries(struct kbvas *self, size_t n)
+{
+	struct head_scan scan = { .n = n };
+
+	if (tracks_batch(self)) {
+		scan_queue(self, &scan);
+	}
+
+	if (drop_entries(self, n) == KBVAS_ERROR_NONE && tracks_batch(self)) {
+		untrack(self, &scan);
+	}
+}
+
+static size_t count_entries(struct kbvas *self)
+{
+	if (keeps_count(self) && self->count_known) {
+		return self->count;
+	}
+
+	if (!self->backend->count) {
+		KBVAS_ERROR("No support for count()");
+		return 0;
+	}
+
+	size_t count = 0;
+	kbvas_error_t err =
+		backend_count(self, &count);
+	if (err != KBVAS_ERROR_NONE) {
+		KBVAS_ERROR("Failed to count entries: %d", err);
+		return 0;
+	}
+
+	if (keeps_count(self)) {
+		self->count = count;
+		self->count_known = true;
+	}
+
+	return count;
+}
+
+/* Adds an entry just queued to the totals */
+static void track(struct kbvas *self, time_t timestamp, size_t size)
+{
+	if (!tracks_batch(self)) {
+		return;
+	}
+
+	/* otherwise something else changed the queue too, like a ring
+	 * overwriting its oldest entry */
+	if (count_entries(self) != self->queued + 1) {
+		resync(self);
+		return;
+	}
+
+	if (self->queued++ == count_covered(self)) {
+		self->oldest = timestamp;
+	}
+	self->queued_bytes += size;
+	self->newest = timestamp;
+}
+
+/* Adds @p n entries just queued at once to the totals */
+static void track_entries(struct kbvas *self,
+		const struct kbvas_entry *entries, size_t n)
+{
+	if (!tracks_batch(self) || n == 0) {
+		return;
+	}
+
+	if (count_entries(self) != self->queued + n) {
+		resync(self);
+		return;
+	}
+
+	if (self->queued == count_covered(self)) {
+		self->oldest = entries[0].timestamp;
+	}
+	for (size_t i = 0; i < n; i++) {
+		self->queued_bytes += entry_size(&entries[i]);
+	}
+	self->queued += n;
+	self->newest = entries[n - 1].timestamp;
+}
+
+/* Counts a frame given to kbvas_enqueue() or a stream, of @p framesize
+ * bytes, as dropped if @p dropped, for being a duplicate or by the change
+ * filter, else as rejected for @p err or as accepted and stored in @p size
+ * bytes */
+static void count_frame(struct kbvas *self, kbvas_error_t err,
+		size_t framesize, size_t size, bool dropped)
+{
+#if defined(KBVAS_USE_STATS)
+	struct kbvas_stats *stats = &self->stats;
+
+	stats->bytes_parsed += framesize;
+
+	if (dropped) {
+		stats->dropped++;
+		return;
+	}
+	if (err != KBVAS_ERROR_NONE) {
+		if ((size_t)err < sizeof(stats->rejected) /
+				sizeof(*stats->rejected)) {
+			stats->rejected[err]++;
+		}
+		return;
+	}
+
+	const size_t queued = count_entries(self);
+
+	stats->accepted++;
+	stats->bytes_encoded += size;
+	if (queued > stats->high_water) {
+		stats->high_water = queued;
+	}
+#else
+	(void)self;
+	(void)err;
+	(void)framesize;
+	(void)size;
+	(void)dropped;
+#endif
+}
+
+/* Returned checkouts come before the rest, so the oldest is theirs */
+static time_t oldest_pending(const struct kbvas *self)
+{
+	for (size_t i = 0; i < self->nr_checkouts; i++) {
+		if (!self->checkouts[i].id) {
+			return self->checkouts[i].first;
+		}
+	}
+
+	return self->oldest;
+}
+
+/* Only the entries not checked out make up a batch */
+static bool is_batch_ready_at(struct kbvas *self, time_t now)
+{
+	size_t bytes;
+	const size_t busy = count_checked_out(self, &bytes);
+
+	if (!tracks_batch(self)) {
+		const size_t count = count_entries(self);
+		return count - MIN(busy, count) >= self->batch_count;
+	}
+
+	const size_t pending = self->queued - MIN(busy, self->queued);
+
+	if (pending >= self->batch_count) {
+		return true;
+	}
+	if (pending == 0) {
+		return false;
+	}
+
+	return (self->batch_bytes &&
+			self->queued_bytes - bytes >= self->batch_bytes) ||
+		(self->batch_age &&
+			now - oldest_pending(self) >= self->batch_age);
+}
+
+/* The age is taken on the clock of the frames, up to the newest one */
+static bool is_batch_ready(struct kbvas *self)
+{
+	return is_batch_ready_at(self, self->newest);
+}
+
+static size_t count_batch(struct kbvas *self)
+{
+	const size_t n = MIN(self->batch_count, count_entries(self));
+
+	if (!self->batch_bytes || n < 2) {
+		return n;
+	}
+
+	struct head_scan scan = { .n = n, .budget = self->batch_bytes };
+	scan_queue(self, &scan);
+
+	return scanned(&scan) ? scanned(&scan) : n;
+}
+
+static struct checkout *find_checkout(struct kbvas *self,
+		kbvas_batch_id_t id, size_t *start)
+{
+	*start = 0;
+
+	for (size_t i = 0; id && i < self->nr_checkouts; i++) {
+		struct checkout *c = &self->checkouts[i];
+
+		if (c->id == id && !c->acked) {
+			return c;
+		}
+
+		*start += c->count;
+	}
+
+	return NULL;
+}
+
+static kbvas_batch_id_t new_checkout_id(struct kbvas *self)
+{
+	size_t start;
+
+	do {
+		self->last_id++;
+	} while (!self->last_id || find_checkout(self, self->last_id, &start));
+
+	return self->last_id;
+}
+
+static void insert_checkout(struct kbvas *self, size_t index,
+		const struct checkout *checkout)
+{
+	memmove(&self->checkouts[index + 1], &self->checkouts[index],
+			(self->nr_checkouts - index) * sizeof(*checkout));
+	self->checkouts[index] = *checkout;
+	self->nr_checkouts++;
+}
+
+static void remove_checkout(struct kbvas *self, size_t index)
+{
+	self->nr_checkouts--;
+	memmove(&self->checkouts[index], &self->checkouts[index + 1],
+			(self->nr_checkouts - index) * sizeof(self->checkouts[0]));
+}
+
+/* Merges adjacent returned runs and gives a returned run at the end back to
+ * the entries following the checkouts */
+static void tidy_checkouts(struct kbvas *self)
+{
+	size_t n = 0;
+
+	for (size_t i = 0; i < self->nr_checkouts; i++) {
+		const struct checkout *c = &self->checkouts[i];
+		struct checkout *prev = n ? &self->checkouts[n - 1] : NULL;
+
+		if (prev && !prev->id && !c->id) {
+			prev->count += c->count;
+			prev->bytes += c->bytes;
+			continue;
+		}
+
+		self->checkouts[n++] = *c;
+	}
+
+	if (n && !self->checkouts[n - 1].id) {
+		self->oldest = self->checkouts[--n].first;
+	}
+
+	self->nr_checkouts = n;
+}
+
+/* Takes the oldest entries not checked out, returned ones first */
+static kbvas_error_t checkout(struct kbvas *self, size_t max_entries,
+		kbvas_batch_id_t *id)
+{
+	size_t start = 0;
+	size_t i = 0;
+
+	for (; i < self->nr_checkouts && self->checkouts[i].id; i++) {
+		start += self->checkouts[i].count;
+	}
+
+	const bool returned = i < self->nr_checkouts;
+	size_t avail = returned ? self->checkouts[i].count : 0;
+
+	if (!returned) {
+		const size_t count = count_entries(self);
+		start = count_covered(self);
+		avail = count - MIN(start, count);
+	}
+
+	if (avail == 0 || max_entries == 0) {
+		return KBVAS_ERROR_EMPTY;
+	}
+
+	struct head_scan scan = {
+		.skip = start,
+		.n = MIN(max_entries, avail),
+		.budget = self->batch_bytes,
+	};
+	size_t n = scan.n;
+
+	if (tracks_batch(self)) {
+		scan_queue(self, &scan);
+		n = scanned(&scan) ? scanned(&scan) : n;
+	}
+
+	if ((!returned || n < avail) &&
+			self->nr_checkouts == KBVAS_MAX_CHECKOUTS) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	const struct checkout taken = {
+		.id = new_checkout_id(self),
+		.count = n,
+		.bytes = scan.bytes,
+		.first = returned ? self->checkouts[i].first : scan.first,
+	};
+
+	if (!returned) {
+		insert_checkout(self, i, &taken);
+		if (scan.has_next) {
+			self->oldest = scan.next;
+		}
+	} else if (n < avail) {
+		const struct checkout rest = {
+			.count = avail - n,
+			.bytes = self->checkouts[i].bytes -
+				MIN(scan.bytes, self->checkouts[i].bytes),
+			.first = scan.next,
+		};
+		self->checkouts[i] = taken;
+		insert_checkout(self, i + 1, &rest);
+	} else {
+		self->checkouts[i].id = taken.id;
+	}
+
+	*id = taken.id;
+
+	return KBVAS_ERROR_NONE;
+}
+
+/* Drops acknowledged runs from the head of the queue */
+static kbvas_error_t drop_acked(struct kbvas *self)
+{
+	while (self->nr_checkouts && self->checkouts[0].acked) {
+		const struct checkout *c = &self->checkouts[0];
+		kbvas_error_t err = drop_entries(self, c->count);
+
+		if (err != KBVAS_ERROR_NONE) {
+			return err;
+		}
+
+		if (tracks_batch(self)) {
+			self->queued -= MIN(c->count, self->queued);
+			self->queued_bytes -= MIN(c->bytes, self->queued_bytes);
+		}
+
+		remove_checkout(self, 0);
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+static void notify_if_batch_ready(struct kbvas *self)
+{
+	if (self->batch_cb != NULL && is_batch_ready(self)) {
+		TRACE_BEGIN(self, BATCH_CALLBACK);
+		(*self->batch_cb)(self, self->batch_cb_ctx);
+		TRACE_END(self, BATCH_CALLBACK);
+	}
+}
+
+static uint8_t *stream_value_dest(struct kbvas_stream *stream, size_t *cap)
+{
+#if defined(KBVAS_USE_RAW_ENCODING)
+	/* byte strings and arrays are written in place rather than buffered */
+	if (stream->desc->kind == TLV_KIND_ARRAY ||
+			stream->desc->kind == TLV_KIND_BYTES) {
+		*cap = stream->desc->size;
+		return entry_fields(stream->entry) + stream->desc->offset;
+	}
+#endif
+	*cap = sizeof(stream->value);
+	return stream->value;
+}
+
+static kbvas_error_t stream_finish_tlv(struct kbvas_stream *stream)
+{
+	stream->tlv.value = stream->value_buf;
+
+	if (parse_battery(stream->desc, &stream->tlv, stream->entry)
+			!= KBVAS_ERROR_NONE) {
+		KBVAS_ERROR("Failed to parse battery info");
+		return KBVAS_ERROR_INVALID_TYPE;
+	}
+
+	KBVAS_DEBUG("TLV type: 0x%02X, length: %d",
+			stream->tlv.type, stream->tlv.length);
+
+	stream->state = STREAM_HEADER;
+	stream->header_len = 0;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t stream_parse(struct kbvas_stream *stream,
+		const uint8_t *data, size_t datasize)
+{
+	size_t i = 0;
+
+	while (i < datasize) {
+		if (stream->state == STREAM_HEADER) {
+			stream->header[stream->header_len++] = data[i++];
+
+			if (stream->header_len == 1) {
+				if (!(stream->desc = find_frame_tlv_desc(
+						stream->header[0]))) {
+					KBVAS_ERROR("Failed to parse TLV");
+					return KBVAS_ERROR_INVALID_FORMAT;
+				}
+				stream->header_size = stream->desc->header_size;
+			}
+			if (stream->header_len < stream->header_size) {
+				continue;
+			}
+			/* same as parse_tlv(): a header alone is not a TLV */
+			if (stream->received + i == stream->framesize) {
+				KBVAS_ERROR("Failed to parse TLV");
+				return KBVAS_ERROR_INVALID_FORMAT;
+			}
+
+			stream->tlv = (struct kbvas_tlv) {
+				.type = stream->header[0],
+				.length = tlv_length(stream->header,
+						stream->header_size),
+			};
+			stream->value_buf =
+				stream_value_dest(stream, &stream->value_cap);
+			stream->value_received = 0;
+			stream->state = STREAM_VALUE;
+			continue;
+		}
+
+		const size_t n = MIN(datasize - i,
+				stream->tlv.length - stream->value_received);
+
+		if (stream->value_received < stream->value_cap) {
+			memcpy(&stream->value_buf[stream->value_received],
+					&data[i], MIN(n, stream->value_cap -
+						stream->value_received));
+		}
+
+		stream->value_received += n;
+		i += n;
+
+		if (stream->value_received == stream->tlv.length) {
+			kbvas_error_t err = stream_finish_tlv(stream);
+			if (err != KBVAS_ERROR_NONE) {
+				return err;
+			}
+		}
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+#if defined(KBVAS_USE_BASE64)
+static void stream_encode(struct kbvas_stream *stream,
+		const uint8_t *data, size_t datasize)
+{
+	char *out = stream->entry->base64_encoded;
+	const size_t outsize = sizeof(stream->entry->base64_encoded);
+
+	/* the timestamp TLV is carried separately as in process_tlv() */
+	if (stream->received < MIN_TLV_LEN) {
+		const size_t skip = MIN(datasize,
+				MIN_TLV_LEN - stream->received);
+		data += skip;
+		datasize -= skip;
+	}
+
+	while (stream->carry_len && stream->carry_len < 3 && datasize) {
+		stream->carry[stream->carry_len++] = *data++;
+		datasize--;
+	}
+
+	if (stream->carry_len == 3) {
+		stream->encoded_len += encode_base64(
+				&out[stream->encoded_len],
+				outsize - stream->encoded_len,
+				stream->carry, 3);
+		stream->carry_len = 0;
+	}
+
+	const size_t n = datasize / 3 * 3;
+	stream->encoded_len += encode_base64(&out[stream->encoded_len],
+			outsize - stream->encoded_len, data, n);
+
+	memcpy(stream->carry, &data[n], datasize - n);
+	stream->carry_len += datasize - n;
+}
+
+static void stream_encode_final(struct kbvas_stream *stream)
+{
+	char *out = stream->entry->base64_encoded;
+	const size_t outsize = sizeof(stream->entry->base64_encoded);
+
+	if (stream->carry_len) {
+		stream->encoded_len += encode_base64(
+				&out[stream->encoded_len],
+				outsize - stream->encoded_len,
+				stream->carry, stream->carry_len);
+	}
+
+	clear_entry_tail(stream->entry, stream->encoded_len);
+}
+#endif
+
+static kbvas_error_t stream_end(struct kbvas_stream *stream)
+{
+	struct kbvas *self = stream->kbvas;
+	kbvas_error_t err = stream->err;
+	size_t size = 0;
+
+	if (err == KBVAS_ERROR_NONE && (stream->state != STREAM_HEADER ||
+			stream->header_len != 0)) {
+		KBVAS_ERROR("Truncated TLV at the end of frame");
+		err = KBVAS_ERROR_INVALID_FORMAT;
+	}
+
+	const bool filtered = err == KBVAS_ERROR_NONE &&
+		!passes_filter(self, stream->entry);
+
+	if (err == KBVAS_ERROR_NONE && !filtered) {
+		const time_t timestamp = stream->entry->timestamp;
+#if defined(KBVAS_USE_BASE64)
+		if (!stream->record) {
+			TRACE_BEGIN(self, ENCODE);
+			stream_encode_final(stream);
+			TRACE_END(self, ENCODE);
+		}
+#endif
+		TRACE_BEGIN(self, PUSH);
+		if (stream->record) {
+			size_t len = stream->framesize;
+#if defined(KBVAS_USE_RAW_ENCODING) && defined(KBVAS_USE_CELL_PACKING)
+			const uint8_t *packed =
+				pack_frame(self, stream->record, &len);
+			if (packed != stream->record) {
+				memcpy(stream->record, packed, len);
+			}
+#endif
+			const struct kbvas_record record = {
+				.timestamp = stream->entry->timestamp,
+				.len = len,
+				.data = stream->record,
+			};
+			size = record_size(&record);
+			err = backend_commit_record(self, &record);
+			count_pushed(self, err, 1);
+		} else {
+			err = commit_entry(self, stream->entry,
+					NULL, 0, &size);
+		}
+		TRACE_END(self, PUSH);
+
+		if (err == KBVAS_ERROR_NONE) {
+			keep_sample(self);
+			track(self, timestamp, size);
+			notify_if_batch_ready(self);
+		}
+	}
+
+	count_frame(self, err, stream->framesize, size, filtered);
+
+	stream->state = STREAM_IDLE;
+	stream->entry = NULL;
+	stream->record = NULL;
+
+	return err;
+}
+
+void kbvas_clear(struct kbvas *self)
+{
+	if (self == NULL) {
+		return;
+	}
+
+	clear_all(self);
+}
+
+void kbvas_clear_batch(struct kbvas *self)
+{
+	if (self == NULL) {
+		return;
+	}
+
+	clear_entries(self, count_batch(self));
+}
+
+size_t kbvas_count_batch(struct kbvas *self)
+{
+	if (self == NULL) {
+		return 0;
+	}
+
+	return count_batch(self);
+}
+
+bool kbvas_is_batch_ready(struct kbvas *self)
+{
+	if (self == NULL) {
+		return false;
+	}
+
+	return is_batch_ready(self);
+}
+
+kbvas_batch_count_t kbvas_get_batch_count(const struct kbvas *self)
+{
+	if (self == NULL) {
+		return 0;
+	}
+
+	return self->batch_count;
+}
+
+void kbvas_set_batch_count(struct kbvas *self, kbvas_batch_count_t batch_count)
+{
+	if (self == NULL) {
+		return;
+	}
+
+	if (batch_count > KBVAS_MAX_BATCH_COUNT) {
+		KBVAS_ERROR("Batch count out of range: %u", batch_count);
+		return;
+	}
+
+	self->batch_count = batch_count;
+	KBVAS_INFO("Batch count set to %u", self->batch_count);
+}
+
+size_t kbvas_get_batch_bytes(const struct kbvas *self)
+{
+	if (self == NULL) {
+		return 0;
+	}
+
+	return self->batch_bytes;
+}
+
+void kbvas_set_batch_bytes(struct kbvas *self, size_t max_bytes)
+{
+	if (self == NULL) {
+		return;
+	}
+
+	const bool tracked = tracks_batch(self);
+
+	self->batch_bytes = max_bytes;
+	KBVAS_INFO("Batch bytes set to %zu", self->batch_bytes);
+
+	if (!tracked && tracks_batch(self)) {
+		resync(self);
+	}
+}
+
+kbvas_error_t kbvas_set_dedup_window(struct kbvas *self, size_t window)
+{
+	if (self == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	uint64_t *dedup = NULL;
+
+	if (window && !(dedup = (uint64_t *)calloc(window, sizeof(*dedup)))) {
+		return KBVAS_ERROR_OOM;
+	}
+
+	free(self->dedup);
+	self->dedup = dedup;
+	self->dedup_window = window;
+	self->dedup_len = 0;
+	self->dedup_next = 0;
+	KBVAS_INFO("Dedup window set to %lu", (unsigned long)window);
+
+	return KBVAS_ERROR_NONE;
+}
+
+size_t kbvas_count_duplicates(const struct kbvas *self, uint64_t *bytes)
+{
+	if (self == NULL) {
+		return 0;
+	}
+
+	if (bytes) {
+		*bytes = self->duplicate_bytes;
+	}
+
+	return self->duplicates;
+}
+
+#if defined(KBVAS_USE_CHANGE_FILTER)
+kbvas_error_t kbvas_set_change_filter(struct kbvas *self,
+		const struct kbvas_change_filter *filter)
+{
+	if (self == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	self->filtering = filter != NULL;
+	self->has_last_sample = false;
+
+	if (filter) {
+		self->filter = *filter;
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+size_t kbvas_count_filtered(const struct kbvas *self)
+{
+	if (self == NULL) {
+		return 0;
+	}
+
+	return self->filtered;
+}
+#endif
+
+time_t kbvas_get_batch_age(const struct kbvas *self)
+{
+	if (self == NULL) {
+		return 0;
+	}
+
+	return self->batch_age;
+}
+
+void kbvas_set_batch_age(struct kbvas *self, time_t max_age)
+{
+	if (self == NULL) {
+		return;
+	}
+
+	if (max_age < 0) {
+		KBVAS_ERROR("Batch age out of range: %ld", (long)max_age);
+		return;
+	}
+
+	const bool tracked = tracks_batch(self);
+
+	self->batch_age = max_age;
+	KBVAS_INFO("Batch age set to %ld", (long)self->batch_age);
+
+	if (!tracked && tracks_batch(self)) {
+		resync(self);
+	}
+}
+
+void kbvas_poll_batch(struct kbvas *self, time_t now)
+{
+	if (self == NULL) {
+		return;
+	}
+
+	if (self->batch_cb != NULL && is_batch_ready_at(self, now)) {
+		TRACE_BEGIN(self, BATCH_CALLBACK);
+		(*self->batch_cb)(self, self->batch_cb_ctx);
+		TRACE_END(self, BATCH_CALLBACK);
+	}
+}
+
+kbvas_error_t kbvas_checkout_batch(struct kbvas *self, size_t max_entries,
+		kbvas_batch_id_t *id)
+{
+	if (self == NULL || id == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	if (!self->backend->drop) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	return checkout(self, max_entries ? max_entries : self->batch_count,
+			id);
+}
+
+kbvas_error_t kbvas_ack_batch(struct kbvas *self, kbvas_batch_id_t id)
+{
+	if (self == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	size_t start;
+	struct checkout *c = find_checkout(self, id, &start);
+
+	if (c == NULL) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	c->acked = true;
+
+	return drop_acked(self);
+}
+
+kbvas_error_t kbvas_nack_batch(struct kbvas *self, kbvas_batch_id_t id)
+{
+	if (self == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	size_t start;
+	struct checkout *c = find_checkout(self, id, &start);
+
+	if (c == NULL) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	c->id = 0;
+	tidy_checkouts(self);
+
+	return KBVAS_ERROR_NONE;
+}
+
+kbvas_error_t kbvas_locate_batch(struct kbvas *self, kbvas_batch_id_t id,
+		size_t *index, size_t *count)
+{
+	if (self == NULL || index == NULL || count == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	const struct checkout *c = find_checkout(self, id, index);
+
+	if (c == NULL) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	*count = c->count;
+
+	return KBVAS_ERROR_NONE;
+}
+
+kbvas_error_t kbvas_peek(struct kbvas *self,
+		int entry_index, struct kbvas_entry *entry)
+{
+	if (self == NULL || entry == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	if (has_record_interface(self)) {
+		return peek_record(self, entry_index, entry);
+	}
+
+	if (!self->backend->peek) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	return backend_peek(self, entry_index, entry);
+}
+
+kbvas_error_t kbvas_peek_range(struct kbvas *self, size_t start,
+		struct kbvas_entry *entries, size_t n, size_t *peeked)
+{
+	if (self == NULL || entries == NULL || peeked == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	return peek_entries(self, start, entries, n, peeked);
+}
+
+/* Mixes the frame in eight bytes at a time, the length included so that
+ * trailing zero bytes count */
+static uint64_t fingerprint(const uint8_t *data, size_t datasize)
+{
+	const uint64_t k = 0x9e3779b97f4a7c15ull;
+	uint64_t h = (uint64_t)datasize * k;
+	uint64_t w;
+	size_t i;
+
+	for (i = 0; i + sizeof(w) <= datasize; i += sizeof(w)) {
+		memcpy(&w, &data[i], sizeof(w));
+		h = (h ^ w) * k;
+		h ^= h >> 29;
+	}
+
+	if (i < datasize) {
+		w = 0;
+		memcpy(&w, &data[i], datasize - i);
+		h = (h ^ w) * k;
+	}
+
+	h ^= h >> 32;
+	h *= k;
+	return h ^ (h >> 29);
+}
+
+/* The window is small, so it is scanned whole rather than hashed into;
+ * with no early exit the comparisons vectorize */
+static bool is_duplicate(const struct kbvas *self, uint64_t fp)
+{
+	bool found = false;
+
+	for (size_t i = 0; i < self->dedup_len; i++) {
+		found |= self->dedup[i] == fp;
+	}
+
+	return found;
+}
+
+static void remember_frame(struct kbvas *self, uint64_t fp)
+{
+	self->dedup[self->dedup_next] = fp;
+	self->dedup_next = (self->dedup_next + 1) % self->dedup_window;
+
+	if (self->dedup_len < self->dedup_window) {
+		self->dedup_len++;
+	}
+}
+
+static kbvas_error_t enqueue_frame(struct kbvas *self,
+		const void *data, size_t datasize, size_t *size, bool *filtered)
+{
+	if (datasize < MIN_TLV_LEN) {
+		return KBVAS_ERROR_INVALID_FORMAT;
+	}
+
+	if (!self->backend->push && !has_record_interface(self) &&
+			!has_reserve_interface(self)) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	struct kbvas_entry *entry;
+	kbvas_error_t err = reserve_entry(self, &entry);
+
+	if (err != KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	clear_entry(entry);
+	TRACE_BEGIN(self, PARSE);
+	err = process_tlv(data, datasize, entry, false);
+	TRACE_END(self, PARSE);
+
+	if (err == KBVAS_ERROR_NONE && !passes_filter(self, entry)) {
+		*filtered = true;
+		return KBVAS_ERROR_NONE;
+	}
+#if defined(KBVAS_USE_BASE64)
+	if (err == KBVAS_ERROR_NONE && !stores_frame(self)) {
+		TRACE_BEGIN(self, ENCODE);
+		encode_entry(entry, (const uint8_t *)data, datasize);
+		TRACE_END(self, ENCODE);
+	}
+#endif
+
+	if (err == KBVAS_ERROR_NONE) {
+		const time_t timestamp = entry->timestamp;
+
+		TRACE_BEGIN(self, PUSH);
+		err = commit_entry(self, entry,
+				(const uint8_t *)data, datasize, size);
+		TRACE_END(self, PUSH);
+
+		if (err == KBVAS_ERROR_NONE) {
+			keep_sample(self);
+			track(self, timestamp, *size);
+			notify_if_batch_ready(self);
+		}
+	}
+
+	return err;
+}
+
+kbvas_error_t kbvas_enqueue(struct kbvas *self,
+		const void *data, size_t datasize)
+{
+	if (self == NULL || data == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+#if defined(KBVAS_USE_STATS)
+	const uint64_t start = read_clock(self);
+#endif
+	const uint64_t fp = self->dedup_window ?
+		fingerprint((const uint8_t *)data, datasize) : 0;
+	const bool duplicate = self->dedup_window && is_duplicate(self, fp);
+	kbvas_error_t err = KBVAS_ERROR_NONE;
+	bool filtered = false;
+	size_t size = 0;
+
+	if (duplicate) {
+		self->duplicates++;
+		self->duplicate_bytes += datasize;
+	} else {
+		err = enqueue_frame(self, data, datasize, &size, &filtered);
+
+		if (err == KBVAS_ERROR_NONE && !filtered &&
+				self->dedup_window) {
+			remember_frame(self, fp);
+		}
+	}
+
+	count_frame(self, err, datasize, size, duplicate || filtered);
+#if defined(KBVAS_USE_STATS)
+	count_latency(self, self->stats.enqueue_latency, start);
+#endif
+
+	return err;
+}
+
+kbvas_error_t kbvas_enqueue_entries(struct kbvas *self,
+		const struct kbvas_entry *entries, size_t n, size_t *enqueued)
+{
+	if (self == NULL || entries == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	/* a record of the frame cannot be rebuilt from the entry */
+	if (stores_frame(self) || (!has_record_interface(self) &&
+			!self->backend->push_many && !self->backend->push)) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	kbvas_error_t err = KBVAS_ERROR_NONE;
+	size_t pushed = 0;
+
+	TRACE_BEGIN(self, PUSH);
+	if (!has_record_interface(self) && self->backend->push_many) {
+		err = backend_push_many(self, entries, n, &pushed);
+		count_pushed(self, err, pushed);
+	} else {
+		for (size_t size; pushed < n; pushed++) {
+			err = push_entry(self, &entries[pushed], NULL, 0, &size);
+			if (err != KBVAS_ERROR_NONE) {
+				break;
+			}
+		}
+	}
+	TRACE_END(self, PUSH);
+
+	if (enqueued) {
+		*enqueued = pushed;
+	}
+
+	if (pushed) {
+		track_entries(self, entries, pushed);
+		notify_if_batch_ready(self);
+	}
+
+	return err;
+}
+
+kbvas_error_t kbvas_stream_begin(struct kbvas_stream *stream, size_t framesize)
+{
+	if (stream == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	struct kbvas *self = stream->kbvas;
+
+	stream->state = STREAM_IDLE;
+
+	if (framesize < MIN_TLV_LEN) {
+		return KBVAS_ERROR_INVALID_FORMAT;
+	}
+
+	if (!self->backend->push && !has_record_interface(self) &&
+			!has_reserve_interface(self)) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	uint8_t *record = NULL;
+	kbvas_error_t err;
+
+	/* such records hold the frame itself, so it goes to the backend as is */
+	if (stores_frame(self)) {
+		if (!self->backend->reserve_record ||
+				!self->backend->commit_record) {
+			return KBVAS_ERROR_UNSUPPORTED;
+		}
+		if ((err = backend_reserve_record(self, framesize, &record))
+				!= KBVAS_ERROR_NONE) {
+			return err;
+		}
+	}
+
+	if ((err = reserve_entry(self, &stream->entry)) != KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	clear_entry(stream->entry);
+
+	stream->record = record;
+	stream->framesize = framesize;
+	stream->received = 0;
+	stream->err = KBVAS_ERROR_NONE;
+	stream->header_len = 0;
+#if defined(KBVAS_USE_BASE64)
+	stream->carry_len = 0;
+	stream->encoded_len = 0;
+#endif
+	stream->state = STREAM_HEADER;
+
+	return KBVAS_ERROR_NONE;
+}
+
+kbvas_error_t kbvas_stream_feed(struct kbvas_stream *stream,
+		const void *data, size_t datasize)
+{
+	if (stream == NULL || data == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	if (stream->state == STREAM_IDLE) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	if (datasize > stream->framesize - stream->received) {
+		return KBVAS_ERROR_OUT_OF_RANGE_VALUE;
+	}
+
+	const uint8_t *p = (const uint8_t *)data;
+
+	if (stream->err == KBVAS_ERROR_NONE) {
+		TRACE_BEGIN(stream->kbvas, PARSE);
+		stream->err = stream_parse(stream, p, datasize);
+		TRACE_END(stream->kbvas, PARSE);
+	}
+
+	if (stream->err == KBVAS_ERROR_NONE) {
+		if (stream->record) {
+			memcpy(&stream->record[stream->received], p, datasize);
+		}
+#if defined(KBVAS_USE_BASE64)
+		if (!stream->record) {
+			TRACE_BEGIN(stream->kbvas, ENCODE);
+			stream_encode(stream, p, datasize);
+			TRACE_END(stream->kbvas, ENCODE);
+		}
+#endif
+	}
+
+	stream->received += datasize;
+
+	if (stream->received < stream->framesize) {
+		return stream->err;
+	}
+
+	return stream_end(stream);
+}
+
+struct kbvas_stream *kbvas_stream_create(struct kbvas *kbvas)
+{
+	struct kbvas_stream *stream;
+
+	if (!kbvas || !(stream = (struct kbvas_stream *)
+			calloc(1, sizeof(*stream)))) {
+		return NULL;
+	}
+
+	stream->kbvas = kbvas;
+	stream->state = STREAM_IDLE;
+
+	return stream;
+}
+
+void kbvas_stream_destroy(struct kbvas_stream *stream)
+{
+	free(stream);
+}
+
+kbvas_error_t kbvas_dequeue(struct kbvas *self, struct kbvas_entry *entry)
+{
+	if (self == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	if (!has_record_interface(self) && !self->backend->pop) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
+
+	struct head_scan scan = { .n = 1 };
+	kbvas_error_t err;
 
-enum data_type {
-	TYPE_TIMESTAMP		= 0xA1,
-	TYPE_VIN		= 0xA2,
-	TYPE_SOC		= 0xA3,
-	TYPE_SOH		= 0xA4,
-	TYPE_BPA		= 0xA5,
-	TYPE_BPV		= 0xA6,
-	TYPE_BSV		= 0xA7,
-	TYPE_BMT		= 0xA8,
-	TYPE_SESSION_DURATION	= 0xB1,
-	TYPE_BATTERY_ID		= 0xB2,
-	TYPE_BSV_MIN_MAX	= 0xB7,
-	TYPE_BMT_MIN_MAX	= 0xB8,
-	TYPE_COUNTER		= 0xC1,
-	TYPE_ENCRYPTED_VIN	= 0xC2,
-};
+	if (tracks_batch(self)) {
+		scan_queue(self, &scan);
+	}
 
-struct tlv {
-	uint8_t type;
-	uint16_t length;
-	const uint8_t *value;
-};
+	if (has_record_interface(self)) {
+		err = pop_record(self, entry);
+	} else {
+		err = backend_pop(self, entry);
+		count_removed(self, err, 1);
+	}
 
-struct kbvas {
-	struct kbvas_backend_api *backend;
-	void *backend_ctx;
-	kbvas_batch_count_t batch_count;
+	if (err == KBVAS_ERROR_NONE && tracks_batch(self)) {
+		untrack(self, &scan);
+	}
 
-	kbvas_batch_callback_t batch_cb;
-	void *batch_cb_ctx;
-};
+	return err;
+}
 
-static size_t parse_tlv(struct tlv *tlv, const uint8_t *data, size_t datasize)
+/* Takes the entries out with the fewest backend calls: all at once by
+ * pop_many(), or peeked and then dropped together */
+static kbvas_error_t dequeue_entries(struct kbvas *self,
+		struct kbvas_entry *entries, size_t n, size_t *dequeued)
 {
-	size_t bytes_parsed = 0;
-	size_t expected_len;
+	kbvas_error_t err;
 
-	memset(tlv, 0, sizeof(*tlv));
-	tlv->type = data[0];
+	if (!has_record_interface(self) && self->backend->pop_many) {
+		return backend_pop_many(self, entries, n, dequeued);
+	}
 
-	switch (tlv->type) {
-	case TYPE_BSV:
-		if (datasize < 4) {
-			break;
-		}
-		tlv->length = (uint16_t)((uint16_t)data[1] << 8 | data[2]);
-		expected_len = (size_t)tlv->length + 3;
-		if (datasize >= expected_len) {
-			tlv->value = &data[3];
-			bytes_parsed = expected_len;
-		}
-		break;
-	case TYPE_TIMESTAMP: /* fall through */
-	case TYPE_VIN: /* fall through */
-	case TYPE_SOC: /* fall through */
-	case TYPE_SOH: /* fall through */
-	case TYPE_BPA: /* fall through */
-	case TYPE_BPV: /* fall through */
-	case TYPE_BMT:
-		if (datasize < 3) {
-			break;
+	if (self->backend->drop) {
+		err = peek_entries(self, 0, entries, n, dequeued);
+
+		if (err == KBVAS_ERROR_NONE && *dequeued) {
+			err = backend_drop(self, *dequeued);
 		}
-		tlv->length = data[1];
-		expected_len = (size_t)tlv->length + 2;
-		if (datasize >= expected_len) {
-			tlv->value = &data[2];
-			bytes_parsed = expected_len;
+		if (err != KBVAS_ERROR_NONE) {
+			*dequeued = 0;
 		}
-		break;
-	default:
-		break;
+
+		return err;
 	}
 
-	return bytes_parsed;
-}
+	if (has_record_interface(self) || !self->backend->pop) {
+		return KBVAS_ERROR_UNSUPPORTED;
+	}
 
-static kbvas_error_t parse_battery(const struct tlv *tlv,
-		struct kbvas_entry *info)
-{
-	switch (tlv->type) {
-	case TYPE_TIMESTAMP:
-		if (tlv->length != 4) {
-			return KBVAS_ERROR_INVALID_FORMAT;
-		}
-		info->timestamp = (time_t)((uint32_t)tlv->value[0] << 24 |
-				(uint32_t)tlv->value[1] << 16 |
-				(uint32_t)tlv->value[2] << 8 |
-				(uint32_t)tlv->value[3]);
-		break;
-#if defined(KBVAS_USE_RAW_ENCODING)
-	case TYPE_VIN:
-		if (!tlv->length) {
-			return KBVAS_ERROR_INVALID_FORMAT;
-		}
-		memcpy(info->data.vin, tlv->value,
-				MIN(tlv->length, sizeof(info->data.vin)));
-		break;
-	case TYPE_SOC:
-		if (tlv->length != 1) {
-			return KBVAS_ERROR_INVALID_FORMAT;
-		}
-		info->data.soc = tlv->value[0];
-		break;
-	case TYPE_SOH:
-		if (tlv->length != 1) {
-			return KBVAS_ERROR_INVALID_FORMAT;
-		}
-		info->data.soh = tlv->value[0];
-		break;
-	case TYPE_BPA:
-		if (tlv->length != 2) {
-			return KBVAS_ERROR_INVALID_FORMAT;
-		}
-		info->data.bpa = (uint16_t)((uint16_t)tlv->value[0] << 8
-				| tlv->value[1]);
-		break;
-	case TYPE_BPV:
-		if (tlv->length != 2) {
-			return KBVAS_ERROR_INVALID_FORMAT;
-		}
-		info->data.bpv = (uint16_t)((uint16_t)tlv->value[0] << 8
-				| tlv->value[1]);
-		break;
-	case TYPE_BSV:
-		if (!tlv->length) {
-			return KBVAS_ERROR_INVALID_FORMAT;
-		}
-		info->data.bsv_count = tlv->length;
-		memcpy(info->data.bsv, tlv->value,
-				MIN(tlv->length, sizeof(info->data.bsv)));
-		break;
-	case TYPE_BMT:
-		if (!tlv->length) {
-			return KBVAS_ERROR_INVALID_FORMAT;
+	for (*dequeued = 0; *dequeued < n; (*dequeued)++) {
+		err = backend_pop(self, &entries[*dequeued]);
+
+		if (err == KBVAS_ERROR_NOENT) {
+			break;
+		} else if (err != KBVAS_ERROR_NONE) {
+			return err;
 		}
-		info->data.bmt_count = (uint8_t)tlv->length;
-		memcpy(info->data.bmt, tlv->value,
-				MIN(tlv->length, sizeof(info->data.bmt)));
-		break;
-#else /* KBVAS_USE_BASE64 */
-	case TYPE_VIN: /* fall through */
-	case TYPE_SOC: /* fall through */
-	case TYPE_SOH: /* fall through */
-	case TYPE_BPA: /* fall through */
-	case TYPE_BPV: /* fall through */
-	case TYPE_BSV: /* fall through */
-	case TYPE_BMT:
-		/* skip other types when using base64 encoding */
-		break;
-#endif
-	default:
-		KBVAS_ERROR("Unknown TLV type: 0x%02X", tlv->type);
-		return KBVAS_ERROR_INVALID_TYPE;
 	}
 
 	return KBVAS_ERROR_NONE;
 }
 
-static kbvas_error_t process_tlv(const uint8_t *tlv, size_t tlv_len,
-		struct kbvas_entry *info)
+kbvas_error_t kbvas_dequeue_many(struct kbvas *self,
+		struct kbvas_entry *entries, size_t n, size_t *dequeued)
 {
-	struct tlv item;
-	size_t bytes_parsed = 0;
+	if (self == NULL || entries == NULL || dequeued == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
 
-	for (size_t i = 0; i < tlv_len; i += bytes_parsed) {
-		if ((bytes_parsed = parse_tlv(&item, &tlv[i], tlv_len - i)) == 0) {
-			KBVAS_ERROR("Failed to parse TLV");
-			return KBVAS_ERROR_INVALID_FORMAT;
-		}
+	struct head_scan scan = { .n = n };
 
-		if (parse_battery(&item, info) != KBVAS_ERROR_NONE) {
-			KBVAS_ERROR("Failed to parse battery info");
-			return KBVAS_ERROR_INVALID_TYPE;
-		}
+	*dequeued = 0;
 
-		KBVAS_DEBUG("TLV type: 0x%02X, length: %d, value %p(%lu)",
-				item.type, item.length, item.value,
-				(uintptr_t)item.value - (uintptr_t)tlv);
+	if (n == 0) {
+		return KBVAS_ERROR_NONE;
 	}
 
-#if defined(KBVAS_USE_BASE64)
-	const size_t len =
-		MIN(tlv_len - MIN_TLV_LEN, sizeof(info->base64_encoded));
+	if (tracks_batch(self)) {
+		scan_queue(self, &scan);
+	}
 
-	memset(info->base64_encoded, 0, sizeof(info->base64_encoded));
-	const size_t encoded_len = lm_base64_encode(info->base64_encoded,
-			sizeof(info->base64_encoded), &tlv[MIN_TLV_LEN], len);
-	KBVAS_DEBUG("%lu bytes of data encoded to %lu bytes", len, encoded_len);
-	(void)encoded_len; /* Suppress unused warning when debug is disabled */
-#else
-	KBVAS_DEBUG("Parsed battery info %lu: %.*s, %u.%u %u, %u %u",
-			info->timestamp, 17, info->data.vin,
-			info->data.soc / 2, info->data.soc * 10 / 2 % 10,
-			info->data.soh,
-			info->data.bpa, info->data.bpv);
-#endif
-	return KBVAS_ERROR_NONE;
+	kbvas_error_t err = dequeue_entries(self, entries, n, dequeued);
+
+	count_removed(self, err, *dequeued);
+
+	if (*dequeued && tracks_batch(self)) {
+		if (*dequeued == scanned(&scan)) {
+			untrack(self, &scan);
+		} else {
+			resync(self);
+		}
+	}
+
+	return err;
 }
 
-static void clear_all(struct kbvas *self)
+void kbvas_iterate(struct kbvas *self, kbvas_iterator_t iterator, void *ctx)
 {
-	if (!self->backend->clear) {
-		KBVAS_ERROR("No support for clear()");
+	if (self == NULL || iterator == NULL) {
 		return;
 	}
 
-	struct kbvas_backend *backend = (struct kbvas_backend *)self->backend;
-	kbvas_error_t err = (*self->backend->clear)(backend, self->backend_ctx);
+	TRACE_BEGIN(self, ITERATE);
+	kbvas_error_t err = iterate_entries(self, iterator, ctx);
+	TRACE_END(self, ITERATE);
+
 	if (err != KBVAS_ERROR_NONE) {
-		KBVAS_ERROR("Failed to clear all: %d", err);
+		KBVAS_ERROR("Failed to iterate entries: %d", err);
 	}
 }
 
-static void clear_entries(struct kbvas *self, size_t n)
+kbvas_error_t kbvas_peek_record(struct kbvas *self,
+		int entry_index, struct kbvas_record *record)
 {
-	if (!self->backend->drop) {
-		KBVAS_ERROR("No support for drop()");
-		return;
+	if (self == NULL || record == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
 	}
 
-	struct kbvas_backend *backend = (struct kbvas_backend *)self->backend;
-	kbvas_error_t err =
-		(*self->backend->drop)(backend, n, self->backend_ctx);
-	if (err != KBVAS_ERROR_NONE) {
-		KBVAS_ERROR("Failed to drop %zu entries: %d", n, err);
+	if (!self->backend->peek_record) {
+		return KBVAS_ERROR_UNSUPPORTED;
 	}
+
+	return backend_peek_record(self, entry_index, record);
 }
 
-static size_t count_entries(struct kbvas *self)
+void kbvas_iterate_records(struct kbvas *self,
+		kbvas_record_iterator_t iterator, void *ctx)
 {
-	if (!self->backend->count) {
-		KBVAS_ERROR("No support for count()");
-		return 0;
+	if (self == NULL || iterator == NULL) {
+		return;
 	}
 
-	struct kbvas_backend *backend = (struct kbvas_backend *)self->backend;
-	size_t count = 0;
-	kbvas_error_t err =
-		(*self->backend->count)(backend, &count, self->backend_ctx);
+	TRACE_BEGIN(self, ITERATE);
+	kbvas_error_t err = iterate_records(self, iterator, ctx);
+	TRACE_END(self, ITERATE);
+
 	if (err != KBVAS_ERROR_NONE) {
-		KBVAS_ERROR("Failed to count entries: %d", err);
-		return 0;
+		KBVAS_ERROR("Failed to iterate records: %d", err);
 	}
-
-	return count;
 }
 
-static bool is_batch_ready(struct kbvas *self)
+kbvas_error_t kbvas_decode_record(const struct kbvas_record *record,
+		struct kbvas_entry *entry)
 {
-	return count_entries(self) >= self->batch_count;
+	if (record == NULL || entry == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	return decode_record(record, entry);
 }
 
-void kbvas_clear(struct kbvas *self)
+kbvas_error_t kbvas_encode_record(const struct kbvas_record *record,
+		char *buf, size_t bufsize, size_t *len)
 {
-	if (self == NULL) {
-		return;
+	if (record == NULL || buf == NULL || len == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
 	}
 
-	clear_all(self);
+#if defined(KBVAS_USE_LAZY_BASE64)
+	if (record->len < MIN_TLV_LEN) {
+		return KBVAS_ERROR_INVALID_FORMAT;
+	}
+
+	const size_t n = record->len - MIN_TLV_LEN;
+	if (bufsize < (n + 2) / 3 * 4) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	*len = encode_base64(buf, bufsize, &record->data[MIN_TLV_LEN], n);
+
+	return KBVAS_ERROR_NONE;
+#elif defined(KBVAS_USE_BASE64)
+	if (bufsize < record->len) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	if (record->len) {
+		memcpy(buf, record->data, record->len);
+	}
+	*len = record->len;
+
+	return KBVAS_ERROR_NONE;
+#else
+	(void)bufsize;
+	return KBVAS_ERROR_UNSUPPORTED;
+#endif
 }
 
-void kbvas_clear_batch(struct kbvas *self)
+void kbvas_tlv_cursor_init(struct kbvas_tlv_cursor *cursor,
+		const void *data, size_t datasize)
 {
-	if (self == NULL) {
+	if (cursor == NULL) {
 		return;
 	}
 
-	clear_entries(self, MIN(self->batch_count, count_entries(self)));
+	*cursor = (struct kbvas_tlv_cursor) {
+		.data = (const uint8_t *)data,
+		.datasize = data? datasize : 0,
+	};
 }
 
-bool kbvas_is_batch_ready(struct kbvas *self)
+kbvas_error_t kbvas_tlv_next(struct kbvas_tlv_cursor *cursor,
+		struct kbvas_tlv *tlv)
 {
-	if (self == NULL) {
-		return false;
+	if (cursor == NULL || tlv == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
 	}
 
-	return is_batch_ready(self);
-}
+	if (cursor->offset >= cursor->datasize) {
+		return KBVAS_ERROR_NOENT;
+	}
 
-kbvas_batch_count_t kbvas_get_batch_count(const struct kbvas *self)
-{
-	if (self == NULL) {
-		return 0;
+	const struct tlv_desc *desc;
+	const size_t bytes_parsed = parse_tlv(tlv, &desc,
+			&cursor->data[cursor->offset],
+			cursor->datasize - cursor->offset);
+
+	if (bytes_parsed == 0) {
+		return KBVAS_ERROR_INVALID_FORMAT;
 	}
 
-	return self->batch_count;
+	cursor->offset += bytes_parsed;
+
+	return KBVAS_ERROR_NONE;
 }
 
-void kbvas_set_batch_count(struct kbvas *self, kbvas_batch_count_t batch_count)
+kbvas_error_t kbvas_tlv_find(const void *data, size_t datasize,
+		uint8_t type, struct kbvas_tlv *tlv)
 {
-	if (self == NULL) {
-		return;
+	struct kbvas_tlv_cursor cursor;
+	kbvas_error_t err;
+
+	if (tlv == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
 	}
 
-	if (batch_count > KBVAS_MAX_BATCH_COUNT) {
-		KBVAS_ERROR("Batch count out of range: %u", batch_count);
-		return;
+	kbvas_tlv_cursor_init(&cursor, data, datasize);
+
+	while ((err = kbvas_tlv_next(&cursor, tlv)) == KBVAS_ERROR_NONE) {
+		if (tlv->type == type) {
+			break;
+		}
 	}
 
-	self->batch_count = batch_count;
-	KBVAS_INFO("Batch count set to %u", self->batch_count);
+	return err;
 }
 
-kbvas_error_t kbvas_peek(struct kbvas *self,
-		int entry_index, struct kbvas_entry *entry)
+kbvas_error_t kbvas_tlv_get_u8(const struct kbvas_tlv *tlv, uint8_t *value)
 {
-	if (self == NULL || entry == NULL) {
+	if (tlv == NULL || value == NULL) {
 		return KBVAS_ERROR_MISSING_PARAM;
 	}
 
-	if (!self->backend->peek) {
-		return KBVAS_ERROR_UNSUPPORTED;
+	if (tlv->length != 1) {
+		return KBVAS_ERROR_INVALID_FORMAT;
 	}
 
-	struct kbvas_backend *backend = (struct kbvas_backend *)self->backend;
-	return (*self->backend->peek)(backend, entry_index,
-			entry, self->backend_ctx);
+	*value = tlv->value[0];
+
+	return KBVAS_ERROR_NONE;
 }
 
-kbvas_error_t kbvas_enqueue(struct kbvas *self,
-		const void *data, size_t datasize)
+kbvas_error_t kbvas_tlv_get_u16(const struct kbvas_tlv *tlv, uint16_t *value)
 {
-	if (self == NULL || data == NULL) {
+	if (tlv == NULL || value == NULL) {
 		return KBVAS_ERROR_MISSING_PARAM;
 	}
 
-	if (datasize < MIN_TLV_LEN) {
+	if (tlv->length != 2) {
 		return KBVAS_ERROR_INVALID_FORMAT;
 	}
 
-	if (!self->backend->push) {
-		return KBVAS_ERROR_UNSUPPORTED;
-	}
+	*value = (uint16_t)((uint16_t)tlv->value[0] << 8 | tlv->value[1]);
 
-	struct kbvas_entry *entry = (struct kbvas_entry *)
-		calloc(1, sizeof(*entry));
+	return KBVAS_ERROR_NONE;
+}
 
-	if (entry == NULL) {
-		return KBVAS_ERROR_OOM;
+kbvas_error_t kbvas_tlv_get_u32(const struct kbvas_tlv *tlv, uint32_t *value)
+{
+	if (tlv == NULL || value == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
 	}
 
-	kbvas_error_t err = process_tlv(data, datasize, entry);
-
-	if (err == KBVAS_ERROR_NONE) {
-		struct kbvas_backend *backend =
-			(struct kbvas_backend *)self->backend;
-		err = (*self->backend->push)(backend, entry, self->backend_ctx);
-
-		if (err == KBVAS_ERROR_NONE && self->batch_cb != NULL &&
-				is_batch_ready(self)) {
-			(*self->batch_cb)(self, self->batch_cb_ctx);
-		}
+	if (tlv->length != 4) {
+		return KBVAS_ERROR_INVALID_FORMAT;
 	}
 
-	free(entry);
+	*value = (uint32_t)tlv->value[0] << 24 | (uint32_t)tlv->value[1] << 16 |
+		(uint32_t)tlv->value[2] << 8 | (uint32_t)tlv->value[3];
 
-	return err;
+	return KBVAS_ERROR_NONE;
 }
 
-kbvas_error_t kbvas_dequeue(struct kbvas *self, struct kbvas_entry *entry)
+size_t kbvas_count(struct kbvas *self)
 {
 	if (self == NULL) {
-		return KBVAS_ERROR_MISSING_PARAM;
-	}
-
-	if (!self->backend->pop) {
-		return KBVAS_ERROR_UNSUPPORTED;
+		return 0;
 	}
 
-	struct kbvas_backend *backend = (struct kbvas_backend *)self->backend;
-	return (*self->backend->pop)(backend, entry, self->backend_ctx);
+	return count_entries(self);
 }
 
-void kbvas_iterate(struct kbvas *self, kbvas_iterator_t iterator, void *ctx)
+#if defined(KBVAS_USE_STATS) || defined(KBVAS_USE_TRACE)
+void kbvas_set_clock(struct kbvas *self, kbvas_clock_t clock)
 {
-	if (self == NULL || iterator == NULL) {
+	if (self == NULL) {
 		return;
 	}
 
-	if (!self->backend->iterate) {
-		KBVAS_ERROR("No support for iterate()");
-		return;
+	self->clock = clock;
+}
+#endif
+
+#if defined(KBVAS_USE_TRACE)
+kbvas_error_t kbvas_register_trace_hook(struct kbvas *self,
+		kbvas_trace_hook_t hook, void *ctx)
+{
+	if (self == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
 	}
 
-	struct kbvas_backend *backend = (struct kbvas_backend *)self->backend;
-	kbvas_error_t err = (*self->backend->iterate)(backend,
-			iterator, ctx, self);
+	self->trace_hook = hook;
+	self->trace_ctx = ctx;
 
-	if (err != KBVAS_ERROR_NONE) {
-		KBVAS_ERROR("Failed to iterate entries: %d", err);
+	return KBVAS_ERROR_NONE;
+}
+#endif
+
+#if defined(KBVAS_USE_STATS)
+kbvas_error_t kbvas_get_stats(const struct kbvas *self,
+		struct kbvas_stats *stats)
+{
+	if (self == NULL || stats == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
 	}
+
+	memcpy(stats, &self->stats, sizeof(*stats));
+
+	return KBVAS_ERROR_NONE;
 }
 
-size_t kbvas_count(struct kbvas *self)
+void kbvas_reset_stats(struct kbvas *self)
 {
 	if (self == NULL) {
-		return 0;
+		return;
 	}
 
-	return count_entries(self);
+	memset(&self->stats, 0, sizeof(self->stats));
 }
+#endif
 
 kbvas_error_t kbvas_register_batch_callback(struct kbvas *self,
 		kbvas_batch_callback_t cb, void *cb_ctx)
@@ -442,6 +3086,20 @@ kbvas_error_t kbvas_register_batch_callback(struct kbvas *self,
 	return KBVAS_ERROR_NONE;
 }
 
+/* Entries iterate_entries() decodes or peeks into at a time */
+static size_t iterbuf_entries(const struct kbvas *self)
+{
+	if (has_record_interface(self)) {
+		return 1;
+	}
+	if (!self->backend->iterate &&
+			(self->backend->peek_range || self->backend->peek)) {
+		return PEEK_CHUNK;
+	}
+
+	return 0;
+}
+
 struct kbvas *kbvas_create(struct kbvas_backend_api *api, void *backend_ctx)
 {
 	struct kbvas *self;
@@ -454,6 +3112,14 @@ struct kbvas *kbvas_create(struct kbvas_backend_api *api, void *backend_ctx)
 	self->backend_ctx = backend_ctx;
 	self->batch_count = 1;
 
+	const size_t n = iterbuf_entries(self);
+
+	if (n && !(self->iterbuf = (struct kbvas_entry *)
+			calloc(n, sizeof(*self->iterbuf)))) {
+		free(self);
+		return NULL;
+	}
+
 	return self;
 }
 
@@ -463,6 +3129,11 @@ void kbvas_destroy(struct kbvas *self)
 		return;
 	}
 
-	clear_all(self);
+	free(self->scratch);
+	free(self->iterbuf);
+	free(self->dedup);
+#if defined(KBVAS_USE_RAW_ENCODING) && defined(KBVAS_USE_CELL_PACKING)
+	free(self->packbuf);
+#endif
 	free(self);
 }
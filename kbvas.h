@@ -21,12 +21,22 @@ extern "C" {
 
 #if !defined(KBVAS_USE_RAW_ENCODING)
 #define KBVAS_USE_BASE64
+#elif defined(KBVAS_USE_LAZY_BASE64)
+#error "KBVAS_USE_LAZY_BASE64 applies to base64 encoding only"
+#endif
+
+#if defined(KBVAS_USE_CHANGE_FILTER) && !defined(KBVAS_USE_RAW_ENCODING)
+#error "KBVAS_USE_CHANGE_FILTER applies to raw encoding only"
 #endif
 
 #if !defined(KBVAS_MAX_BATCH_COUNT)
 #define KBVAS_MAX_BATCH_COUNT			20
 #endif
 
+#if !defined(KBVAS_MAX_CHECKOUTS)
+#define KBVAS_MAX_CHECKOUTS			4 /* batches checked out at once */
+#endif
+
 #if !defined(KBVAS_CELL_VOLTAGE_MAX_COUNT)
 #define KBVAS_CELL_VOLTAGE_MAX_COUNT		192 /* up to 0xffff */
 #endif
@@ -35,6 +45,14 @@ extern "C" {
 #define KBVAS_MODULE_TEMPERATURE_MAX_COUNT	20 /* up to 0xff */
 #endif
 
+#if !defined(KBVAS_BATTERY_ID_MAX_LEN)
+#define KBVAS_BATTERY_ID_MAX_LEN		32 /* up to 0xff */
+#endif
+
+#if !defined(KBVAS_ENCRYPTED_VIN_MAX_LEN)
+#define KBVAS_ENCRYPTED_VIN_MAX_LEN		64 /* up to 0xff */
+#endif
+
 typedef enum {
 	KBVAS_ERROR_NONE			= 0,
 	KBVAS_ERROR_INTERNAL			= 1,
@@ -53,7 +71,30 @@ typedef enum {
 	KBVAS_ERROR_UNSUPPORTED			= 14,
 } kbvas_error_t;
 
+typedef enum {
+	KBVAS_TLV_TIMESTAMP			= 0xA1,
+	KBVAS_TLV_VIN				= 0xA2,
+	KBVAS_TLV_SOC				= 0xA3,
+	KBVAS_TLV_SOH				= 0xA4,
+	KBVAS_TLV_BPA				= 0xA5,
+	KBVAS_TLV_BPV				= 0xA6,
+	KBVAS_TLV_BSV				= 0xA7,
+	KBVAS_TLV_BMT				= 0xA8,
+	KBVAS_TLV_SESSION_DURATION		= 0xB1,
+	KBVAS_TLV_BATTERY_ID			= 0xB2,
+	KBVAS_TLV_BSV_MIN_MAX			= 0xB7,
+	KBVAS_TLV_BMT_MIN_MAX			= 0xB8,
+	KBVAS_TLV_COUNTER			= 0xC1,
+	KBVAS_TLV_ENCRYPTED_VIN			= 0xC2,
+	/* Private: A7/A8 as stored in raw records under KBVAS_USE_CELL_PACKING.
+	 * The value is count (2 bytes, big-endian), base (1), width (1) and
+	 * count values minus base, width bits each, packed LSB first. */
+	KBVAS_TLV_PACKED_BSV			= 0xE7,
+	KBVAS_TLV_PACKED_BMT			= 0xE8,
+} kbvas_tlv_type_t;
+
 typedef uint8_t kbvas_batch_count_t;
+typedef uint16_t kbvas_batch_id_t; /* 0 is never a valid id */
 
 struct kbvas_data {
 	uint8_t vin[17]; /* A2: vehicle identification number */
@@ -69,17 +110,174 @@ struct kbvas_data {
 						temperature in the unit of 1C */
 };
 
+/* Extended tags. Kept apart from struct kbvas_data, whose size determines
+ * the base64 entry buffer, so adding them does not change that layout. */
+struct kbvas_ext_data {
+	uint32_t session_duration; /* B1: charging session duration */
+	uint8_t battery_id_len;
+	uint8_t battery_id[KBVAS_BATTERY_ID_MAX_LEN]; /* B2 */
+	uint8_t bsv_min_max[2]; /* B7: lowest and highest cell voltage in the
+				   unit of 0.02V */
+	uint8_t bmt_min_max[2]; /* B8: lowest and highest module temperature in
+				   the unit of 1C */
+	uint32_t counter; /* C1 */
+	uint8_t encrypted_vin_len;
+	uint8_t encrypted_vin[KBVAS_ENCRYPTED_VIN_MAX_LEN]; /* C2 */
+};
+
+/**
+ * @brief Statistics over a byte array such as kbvas_data::bsv.
+ *
+ * Values are in the unit of the array they summarize. All fields are zero
+ * for an empty array.
+ */
+struct kbvas_summary {
+	uint8_t min;
+	uint8_t max;
+	uint8_t spread;   /* max - min */
+	uint16_t argmin;  /* index of the first minimum */
+	uint16_t argmax;  /* index of the first maximum */
+	uint16_t mean_q8; /* mean in the unit of 1/256, rounded */
+	uint16_t count;   /* number of values summarized */
+};
+
+#if defined(KBVAS_USE_CHANGE_FILTER)
+/**
+ * @brief Changes a frame must make to be stored, in the units of
+ *        struct kbvas_data.
+ *
+ * A frame is stored if any value moved by more than its threshold since the
+ * frame last stored, so 0 stores on any change of that value. A frame of
+ * another VIN or number of cells or modules is always stored.
+ */
+struct kbvas_change_filter {
+	uint8_t soc;
+	uint8_t soh;
+	uint16_t bpa;
+	uint16_t bpv;
+	uint8_t bsv; /* of any cell */
+	uint8_t bmt; /* of any module */
+	time_t max_interval; /* stored anyway once this many seconds passed by
+				the timestamps, or 0 for no limit */
+};
+#endif
+
+/**
+ * @brief Read-only view of a single TLV inside a frame.
+ *
+ * @ref value points into the buffer being parsed; nothing is copied.
+ */
+struct kbvas_tlv {
+	uint8_t type;     /* kbvas_tlv_type_t */
+	uint16_t length;
+	const uint8_t *value;
+};
+
+/**
+ * @brief Position of a TLV walk over a byte span.
+ */
+struct kbvas_tlv_cursor {
+	const uint8_t *data;
+	size_t datasize;
+	size_t offset;
+};
+
 struct kbvas_entry {
 	time_t timestamp;
 #if defined(KBVAS_USE_BASE64)
 	char base64_encoded[(sizeof(struct kbvas_data)+2)/3*4 + 1];
 #else
 	struct kbvas_data data;
+	struct kbvas_ext_data ext;
+#if defined(KBVAS_USE_SUMMARY)
+	/* of the stored values, computed once when the entry is queued */
+	struct kbvas_summary bsv_summary;
+	struct kbvas_summary bmt_summary;
+#endif
 #endif
 };
 
+/**
+ * @brief Compact, variable-length view of a queued entry.
+ *
+ * Unlike struct kbvas_entry, which is sized for the worst case, a record
+ * carries only the bytes actually produced for a frame:
+ * - KBVAS_USE_BASE64: the base64 text (no terminator) of the frame following
+ *   the timestamp TLV, exactly as in kbvas_entry::base64_encoded. With
+ *   KBVAS_USE_LAZY_BASE64, the TLV frame as received instead; the text is
+ *   produced by kbvas_decode_record() or kbvas_encode_record() on demand.
+ * - KBVAS_USE_RAW_ENCODING: the TLV frame as received. With
+ *   KBVAS_USE_CELL_PACKING, A7 and A8 may be replaced by the smaller
+ *   KBVAS_TLV_PACKED_BSV and KBVAS_TLV_PACKED_BMT, which
+ *   kbvas_decode_record() expands back.
+ *
+ * @note @ref data points into backend storage and is valid only until the
+ *       next mutating call on the queue.
+ */
+struct kbvas_record {
+	time_t timestamp;
+	size_t len;
+	const uint8_t *data;
+};
+
 struct kbvas;
 struct kbvas_backend;
+struct kbvas_stream;
+
+#if defined(KBVAS_USE_STATS) || defined(KBVAS_USE_TRACE)
+/**
+ * @brief Clock latencies are measured and trace points stamped by, in ticks
+ *        of any fixed unit such as nanoseconds or CPU cycles.
+ */
+typedef uint64_t (*kbvas_clock_t)(void);
+#endif
+
+#if defined(KBVAS_USE_STATS)
+#define KBVAS_STATS_LATENCY_BUCKETS		32
+
+/**
+ * @brief Counters a kbvas instance keeps under KBVAS_USE_STATS.
+ *
+ * Latencies are counted in log2 buckets of clock ticks: bucket 0 holds those
+ * under 2 ticks, bucket i those in [2^i, 2^(i+1)) and the last bucket also
+ * all longer ones. They stay zero until a clock is set by kbvas_set_clock().
+ */
+struct kbvas_stats {
+	uint32_t accepted; /* frames enqueued */
+	uint32_t rejected[KBVAS_ERROR_UNSUPPORTED + 1]; /* by kbvas_error_t */
+	uint32_t dropped; /* duplicate or unchanged frames, not enqueued */
+	uint64_t bytes_parsed;  /* of all frames given */
+	uint64_t bytes_encoded; /* of frames enqueued, as counted for batches */
+	uint32_t backend_calls;
+	uint32_t backend_errors; /* calls failing with other than NOENT */
+	size_t high_water; /* most entries queued at once */
+	uint32_t enqueue_latency[KBVAS_STATS_LATENCY_BUCKETS];
+	uint32_t backend_latency[KBVAS_STATS_LATENCY_BUCKETS];
+};
+#endif
+
+#if defined(KBVAS_USE_TRACE)
+typedef enum {
+	KBVAS_TRACE_PARSE, /* decoding the TLVs of a frame */
+	KBVAS_TRACE_ENCODE, /* base64 encoding of a frame */
+	KBVAS_TRACE_PUSH, /* storing an entry or record in the backend */
+	KBVAS_TRACE_BATCH_CALLBACK,
+	KBVAS_TRACE_ITERATE,
+} kbvas_trace_point_t;
+
+/**
+ * @brief Called at the beginning and the end of each trace point.
+ *
+ * @param[in] self Pointer to the kbvas instance.
+ * @param[in] point Trace point.
+ * @param[in] begin true at the beginning, false at the end.
+ * @param[in] timestamp Clock set by kbvas_set_clock(), or 0 if none.
+ * @param[in] ctx User context given on registration.
+ */
+typedef void (*kbvas_trace_hook_t)(struct kbvas *self,
+		kbvas_trace_point_t point, bool begin, uint64_t timestamp,
+		void *ctx);
+#endif
 
 typedef void (*kbvas_batch_callback_t)(struct kbvas *self, void *ctx);
 
@@ -100,6 +298,41 @@ typedef void (*kbvas_batch_callback_t)(struct kbvas *self, void *ctx);
 typedef bool (*kbvas_iterator_t)(struct kbvas *self,
 		const struct kbvas_entry *entry, void *ctx);
 
+/**
+ * @brief Callback type for iterating kbvas records.
+ *
+ * Same as kbvas_iterator_t, but receives a compact view of each entry
+ * without materializing a full struct kbvas_entry.
+ *
+ * @param[in] self   Pointer to the kbvas instance.
+ * @param[in] record View of the record being visited.
+ * @param[in] ctx    User-defined context provided to the iterate function.
+ *
+ * @retval true  Continue iteration.
+ * @retval false Stop iteration early.
+ */
+typedef bool (*kbvas_record_iterator_t)(struct kbvas *self,
+		const struct kbvas_record *record, void *ctx);
+
+/**
+ * @brief Guarantees a backend advertises in kbvas_backend_api::caps.
+ */
+typedef enum {
+	/* count() runs in constant time */
+	KBVAS_BACKEND_CAP_CONST_COUNT		= 1u << 0,
+	/* peek() or peek_record() reaches any index in constant time.
+	 * Otherwise kbvas reads ranges of entries by iterating instead. */
+	KBVAS_BACKEND_CAP_RANDOM_PEEK		= 1u << 1,
+	/* one producer and one consumer thread may use the queue at once
+	 * without a lock */
+	KBVAS_BACKEND_CAP_SPSC			= 1u << 2,
+	/* the queue changes only through kbvas calls, never by the backend
+	 * evicting or overwriting entries on its own. Without constant-time
+	 * count(), kbvas then keeps the count itself and calls count() only
+	 * when it has lost track. */
+	KBVAS_BACKEND_CAP_KBVAS_ONLY		= 1u << 3,
+} kbvas_backend_cap_t;
+
 /**
  * @brief Non-volatile backend interface for kbvas.
  */
@@ -157,6 +390,139 @@ struct kbvas_backend_api {
 	kbvas_error_t (*iterate)(struct kbvas_backend *self,
 			kbvas_iterator_t iterator, void *iterator_ctx,
 			struct kbvas *kbvas_instance);
+
+	/*
+	 * Optional variable-length record interface. A backend implementing
+	 * push_record stores struct kbvas_record payloads length-prefixed
+	 * instead of worst-case-sized struct kbvas_entry, and kbvas then uses
+	 * the record operations below in place of push, pop, peek and iterate.
+	 */
+
+	/**
+	 * @brief Enqueue a record by deep-copying its @p record->len bytes.
+	 */
+	kbvas_error_t (*push_record)(struct kbvas_backend *self,
+			const struct kbvas_record *record, void *ctx);
+	/**
+	 * @brief Get a view of the record at @p entry_index.
+	 *
+	 * Indexing follows peek(). The returned view is valid until the next
+	 * mutating call.
+	 */
+	kbvas_error_t (*peek_record)(struct kbvas_backend *self,
+			int entry_index, struct kbvas_record *record,
+			void *ctx);
+	/**
+	 * @brief Iterate over queued records in FIFO order.
+	 *
+	 * Termination rules are the same as iterate().
+	 */
+	kbvas_error_t (*iterate_records)(struct kbvas_backend *self,
+			kbvas_record_iterator_t iterator, void *iterator_ctx,
+			struct kbvas *kbvas_instance);
+
+	/*
+	 * Optional zero-copy enqueue interface. When both are provided, kbvas
+	 * parses frames directly into backend-owned storage instead of a
+	 * scratch entry followed by push().
+	 */
+
+	/**
+	 * @brief Reserve storage for the next entry without publishing it.
+	 *
+	 * A reservation does not affect queued entries and is discarded if
+	 * not committed before the next reserve().
+	 *
+	 * @param[out] entry Backend-owned slot to be filled in by the caller.
+	 * @param[in]  ctx   Backend context.
+	 */
+	kbvas_error_t (*reserve)(struct kbvas_backend *self,
+			struct kbvas_entry **entry, void *ctx);
+	/**
+	 * @brief Publish the entry previously obtained from reserve().
+	 *
+	 * @param[in] entry Slot returned by the last reserve().
+	 * @param[in] ctx   Backend context.
+	 */
+	kbvas_error_t (*commit)(struct kbvas_backend *self,
+			struct kbvas_entry *entry, void *ctx);
+
+	/**
+	 * @brief Reserve @p size bytes of record storage to be filled in place.
+	 *
+	 * Record counterpart of reserve(), used by struct kbvas_stream to
+	 * store a frame as it arrives without reassembling it first.
+	 *
+	 * @param[in]  size Number of payload bytes to reserve.
+	 * @param[out] buf  Backend-owned buffer of at least @p size bytes.
+	 * @param[in]  ctx  Backend context.
+	 */
+	kbvas_error_t (*reserve_record)(struct kbvas_backend *self,
+			size_t size, uint8_t **buf, void *ctx);
+	/**
+	 * @brief Publish the record previously obtained from reserve_record().
+	 *
+	 * @param[in] record Record whose @p data is the reserved buffer and
+	 *                   whose @p len does not exceed the reserved size.
+	 * @param[in] ctx    Backend context.
+	 */
+	kbvas_error_t (*commit_record)(struct kbvas_backend *self,
+			const struct kbvas_record *record, void *ctx);
+
+	/*
+	 * Optional batched entry interface. When provided, kbvas moves several
+	 * entries in one call instead of one push, pop or peek per entry, and
+	 * falls back to those otherwise.
+	 */
+
+	/**
+	 * @brief Enqueue up to @p n entries in order.
+	 *
+	 * Stops at the first entry that cannot be enqueued, which is then
+	 * the error returned.
+	 *
+	 * @param[in]  entries Entries to be enqueued. Backend must copy them.
+	 * @param[in]  n       Number of entries in @p entries.
+	 * @param[out] pushed  Number of entries enqueued.
+	 * @param[in]  ctx     Backend context.
+	 */
+	kbvas_error_t (*push_many)(struct kbvas_backend *self,
+			const struct kbvas_entry *entries, size_t n,
+			size_t *pushed, void *ctx);
+	/**
+	 * @brief Remove up to @p n of the oldest entries.
+	 *
+	 * Removing fewer than @p n because the queue runs out is not an error.
+	 *
+	 * @param[out] entries Dequeued entries, or NULL to discard them.
+	 * @param[in]  n       Number of entries to remove at most.
+	 * @param[out] popped  Number of entries removed.
+	 * @param[in]  ctx     Backend context.
+	 */
+	kbvas_error_t (*pop_many)(struct kbvas_backend *self,
+			struct kbvas_entry *entries, size_t n,
+			size_t *popped, void *ctx);
+	/**
+	 * @brief Copy up to @p n entries starting at index @p start.
+	 *
+	 * @param[in]  start   Index of the first entry, 0 being the oldest.
+	 * @param[out] entries Array of at least @p n entries.
+	 * @param[in]  n       Number of entries to copy at most.
+	 * @param[out] peeked  Number of entries copied, fewer than @p n when
+	 *                     the queue runs out.
+	 * @param[in]  ctx     Backend context.
+	 */
+	kbvas_error_t (*peek_range)(struct kbvas_backend *self, size_t start,
+			struct kbvas_entry *entries, size_t n,
+			size_t *peeked, void *ctx);
+
+	/**
+	 * @brief kbvas_backend_cap_t flags of what the backend guarantees.
+	 *
+	 * Operations provided are told by their pointers being set; these
+	 * tell how they behave. 0 promises nothing.
+	 */
+	unsigned int caps;
 };
 
 /**
@@ -183,6 +549,9 @@ struct kbvas *kbvas_create(struct kbvas_backend_api *api, void *backend_ctx);
  * state. After calling this function, the kbvas instance should no
  * longer be used.
  *
+ * Queued entries are left to the backend, which frees them when it is
+ * destroyed or, if it is persistent, keeps them for the next instance.
+ *
  * @param[in] self A pointer to the kbvas instance to be destroyed.
  */
 void kbvas_destroy(struct kbvas *self);
@@ -218,16 +587,31 @@ kbvas_error_t kbvas_register_batch_callback(struct kbvas *self,
 /**
  * @brief Removes a batch of entries from the kbvas instance.
  *
- * This function removes up to the configured batch count of entries
+ * This function removes the entries counted by kbvas_count_batch()
  * from the internal queue. It is typically called after a successful
  * transmission of the batched data.
  *
  * @note If fewer than the batch count of entries exist, all entries are removed.
+ * @note For batches checked out by kbvas_checkout_batch(), use
+ *       kbvas_ack_batch() instead.
  *
  * @param[in] self Pointer to the kbvas instance.
  */
 void kbvas_clear_batch(struct kbvas *self);
 
+/**
+ * @brief Counts the entries in the batch at the head of the queue.
+ *
+ * That is the oldest entries up to the batch count, cut short where the
+ * next one would take them over the byte budget. The first entry always
+ * counts, even when it alone is over budget.
+ *
+ * @param[in] self Pointer to the kbvas instance.
+ *
+ * @return The number of entries kbvas_clear_batch() would remove.
+ */
+size_t kbvas_count_batch(struct kbvas *self);
+
 /**
  * @brief Sets the batch count for the kbvas instance.
  *
@@ -251,11 +635,117 @@ void kbvas_set_batch_count(struct kbvas *self, kbvas_batch_count_t batch_count);
  */
 kbvas_batch_count_t kbvas_get_batch_count(const struct kbvas *self);
 
+/**
+ * @brief Sets the byte budget of a batch.
+ *
+ * A batch is also ready once the queued entries add up to @p max_bytes, and
+ * holds no more entries than fit in it. An entry counts as the length of
+ * its base64 text, or in raw encoding as the bytes it takes in the backend:
+ * kbvas_record::len, or sizeof(struct kbvas_entry) without a record
+ * interface. Leave room for the message around the entries, such as the
+ * DataTransfer envelope.
+ *
+ * The running totals this needs are kept only while a byte budget or an age
+ * limit is set, so that readiness stays O(1).
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] max_bytes Budget in bytes, or 0 for none.
+ */
+void kbvas_set_batch_bytes(struct kbvas *self, size_t max_bytes);
+
+/**
+ * @brief Retrieves the byte budget of a batch.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ *
+ * @return The byte budget, or 0 if none is set.
+ */
+size_t kbvas_get_batch_bytes(const struct kbvas *self);
+
+/**
+ * @brief Sets the age limit of a batch.
+ *
+ * A batch is also ready once its oldest entry is @p max_age seconds older
+ * than the newest, as given by their timestamps. To keep to the limit while
+ * no frames arrive, call kbvas_poll_batch() periodically.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] max_age Age limit in seconds, or 0 for none.
+ */
+void kbvas_set_batch_age(struct kbvas *self, time_t max_age);
+
+/**
+ * @brief Retrieves the age limit of a batch.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ *
+ * @return The age limit in seconds, or 0 if none is set.
+ */
+time_t kbvas_get_batch_age(const struct kbvas *self);
+
+/**
+ * @brief Sets how many recent frames kbvas_enqueue() drops duplicates of.
+ *
+ * A 64-bit fingerprint of each frame enqueued, timestamp TLV included, is
+ * kept for the last @p window frames. A frame matching one of them is
+ * dropped before it is parsed, and kbvas_enqueue() returns KBVAS_ERROR_NONE
+ * for it as it is queued already. Frames fed to a stream are not checked.
+ *
+ * Setting the window forgets the fingerprints kept so far but not the count
+ * of duplicates.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] window Number of frames to remember, or 0 to drop none.
+ *
+ * @return KBVAS_ERROR_NONE, KBVAS_ERROR_MISSING_PARAM or KBVAS_ERROR_OOM.
+ */
+kbvas_error_t kbvas_set_dedup_window(struct kbvas *self, size_t window);
+
+/**
+ * @brief Retrieves the number of frames dropped as duplicates.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ *
+ * @return Frames dropped since creation, and bytes of them in @p bytes if
+ *         not NULL.
+ */
+size_t kbvas_count_duplicates(const struct kbvas *self, uint64_t *bytes);
+
+#if defined(KBVAS_USE_CHANGE_FILTER)
+/**
+ * @brief Sets the changes a frame must make to be stored.
+ *
+ * A frame that parses but makes too little change since the frame last
+ * stored is dropped, and kbvas_enqueue() or kbvas_stream_feed() returns
+ * KBVAS_ERROR_NONE for it. Extended tags are not compared. Setting a filter
+ * forgets the frame last stored, so the next one is stored. Cells and
+ * modules are compared by kbvas_max_delta(), so kbvas_summary.c is to be
+ * built in.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] filter Thresholds, or NULL to store every frame.
+ *
+ * @return KBVAS_ERROR_NONE, or KBVAS_ERROR_MISSING_PARAM.
+ */
+kbvas_error_t kbvas_set_change_filter(struct kbvas *self,
+		const struct kbvas_change_filter *filter);
+
+/**
+ * @brief Retrieves the number of frames dropped by the change filter.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ *
+ * @return Frames dropped since creation.
+ */
+size_t kbvas_count_filtered(const struct kbvas *self);
+#endif
+
 /**
  * @brief Checks if the current batch is ready for processing.
  *
  * This function determines whether the number of queued entries
- * has reached the configured batch count.
+ * has reached the configured batch count, or the byte budget or age limit
+ * has been reached where set.
  *
  * @param[in] self A pointer to the kbvas instance.
  *
@@ -263,12 +753,97 @@ kbvas_batch_count_t kbvas_get_batch_count(const struct kbvas *self);
  */
 bool kbvas_is_batch_ready(struct kbvas *self);
 
+/**
+ * @brief Invokes the batch callback if a batch is ready at @p now.
+ *
+ * Same as the check made on every enqueue, except that the age of the
+ * oldest entry is taken at @p now rather than at the newest entry.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] now Current time on the clock of the frame timestamps.
+ */
+void kbvas_poll_batch(struct kbvas *self, time_t now);
+
+/**
+ * @brief Checks out the next batch for sending, leaving it queued.
+ *
+ * Takes the oldest entries not already checked out, those returned by
+ * kbvas_nack_batch() first, up to @p max_entries and the byte budget. They
+ * stay at the head of the queue until acknowledged, while new entries keep
+ * arriving behind them and further batches can be checked out, so that
+ * several uploads are in flight at once. Checked-out entries no longer count
+ * towards a ready batch.
+ *
+ * Use kbvas_locate_batch() to read the entries. Do not remove entries by
+ * kbvas_dequeue() or kbvas_clear_batch() while batches are checked out, nor
+ * let a ring backend overwrite them.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] max_entries Maximum number of entries, or 0 for the batch count.
+ * @param[out] id Id of the batch.
+ *
+ * @return KBVAS_ERROR_NONE on success, KBVAS_ERROR_EMPTY if there is no entry
+ *         to check out, or KBVAS_ERROR_NOSPC if KBVAS_MAX_CHECKOUTS are
+ *         already out.
+ */
+kbvas_error_t kbvas_checkout_batch(struct kbvas *self, size_t max_entries,
+		kbvas_batch_id_t *id);
+
+/**
+ * @brief Acknowledges a checked-out batch, removing its entries.
+ *
+ * Batches may be acknowledged in any order. As entries leave from the head
+ * of the queue only, the entries of a batch are removed once those of every
+ * batch checked out before it are.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] id Id given by kbvas_checkout_batch().
+ *
+ * @return KBVAS_ERROR_NONE on success, or KBVAS_ERROR_NOENT if no batch of
+ *         @p id is checked out.
+ */
+kbvas_error_t kbvas_ack_batch(struct kbvas *self, kbvas_batch_id_t id);
+
+/**
+ * @brief Returns a checked-out batch to the queue.
+ *
+ * Its entries are checked out again before any other.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] id Id given by kbvas_checkout_batch().
+ *
+ * @return KBVAS_ERROR_NONE on success, or KBVAS_ERROR_NOENT if no batch of
+ *         @p id is checked out.
+ */
+kbvas_error_t kbvas_nack_batch(struct kbvas *self, kbvas_batch_id_t id);
+
+/**
+ * @brief Finds where the entries of a checked-out batch are in the queue.
+ *
+ * The position moves as batches ahead of it are acknowledged.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] id Id given by kbvas_checkout_batch().
+ * @param[out] index Index of its first entry, as for kbvas_peek().
+ * @param[out] count Number of its entries.
+ *
+ * @return KBVAS_ERROR_NONE on success, or KBVAS_ERROR_NOENT if no batch of
+ *         @p id is checked out.
+ */
+kbvas_error_t kbvas_locate_batch(struct kbvas *self, kbvas_batch_id_t id,
+		size_t *index, size_t *count);
+
 /**
  * @brief Enqueues data into the kbvas instance.
  *
  * This function adds a new data entry to the queue in the kbvas
  * instance.
  *
+ * @note With a backend implementing reserve() and commit(), the frame is
+ *       parsed straight into backend storage and no heap allocation takes
+ *       place. Otherwise a single parse buffer is allocated on first use
+ *       and kept until kbvas_destroy().
+ *
  * @param[in] self A pointer to the kbvas instance.
  * @param[in] data A pointer to the data to be enqueued.
  * @param[in] datasize The size of the data in bytes.
@@ -278,6 +853,72 @@ bool kbvas_is_batch_ready(struct kbvas *self);
 kbvas_error_t kbvas_enqueue(struct kbvas *self,
 		const void *data, size_t datasize);
 
+/**
+ * @brief Enqueues entries already parsed, such as ones dequeued elsewhere.
+ *
+ * Entries are pushed with the backend's push_many() when it has one and one
+ * by one otherwise, stopping at the first one that fails.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] entries Entries to enqueue, oldest first.
+ * @param[in] n Number of entries in @p entries.
+ * @param[out] enqueued Number of entries enqueued. May be NULL.
+ *
+ * @return KBVAS_ERROR_UNSUPPORTED if the backend stores records that cannot
+ *         be rebuilt from an entry, otherwise the result of the first push
+ *         that failed, or KBVAS_ERROR_NONE.
+ */
+kbvas_error_t kbvas_enqueue_entries(struct kbvas *self,
+		const struct kbvas_entry *entries, size_t n, size_t *enqueued);
+
+/**
+ * @brief Creates an incremental frame parser bound to a kbvas instance.
+ *
+ * A stream accepts a frame in arbitrary chunks, e.g. straight from the
+ * fragments of a transport receive buffer, and enqueues it once the last
+ * byte arrives, without reassembling the frame in a contiguous buffer.
+ *
+ * @note A kbvas instance holds at most one frame in progress: do not call
+ *       kbvas_enqueue() or feed another stream of the same instance while
+ *       a frame is partially fed.
+ *
+ * @param[in] kbvas kbvas instance the parsed entries are enqueued into.
+ *
+ * @return A pointer to the stream, or NULL if the allocation fails.
+ */
+struct kbvas_stream *kbvas_stream_create(struct kbvas *kbvas);
+void kbvas_stream_destroy(struct kbvas_stream *stream);
+
+/**
+ * @brief Starts a new frame of @p framesize bytes.
+ *
+ * Any frame still in progress is discarded.
+ *
+ * @param[in] stream Stream instance.
+ * @param[in] framesize Total size of the frame in bytes.
+ *
+ * @return A kbvas_error_t indicating the result of the operation.
+ */
+kbvas_error_t kbvas_stream_begin(struct kbvas_stream *stream, size_t framesize);
+
+/**
+ * @brief Feeds the next chunk of the current frame.
+ *
+ * The entry is enqueued, and the batch callback invoked if applicable,
+ * when the chunk completing the frame is fed. Once a parse error occurs,
+ * it is returned for every remaining chunk of the frame.
+ *
+ * @param[in] stream Stream instance.
+ * @param[in] data Chunk of frame bytes.
+ * @param[in] datasize Size of the chunk in bytes.
+ *
+ * @return KBVAS_ERROR_NOENT if no frame is in progress,
+ *         KBVAS_ERROR_OUT_OF_RANGE_VALUE if the chunk exceeds the frame size,
+ *         otherwise a kbvas_error_t as kbvas_enqueue() would return.
+ */
+kbvas_error_t kbvas_stream_feed(struct kbvas_stream *stream,
+		const void *data, size_t datasize);
+
 /**
  * @brief Removes and retrieves the oldest entry from the kbvas queue.
  *
@@ -289,6 +930,23 @@ kbvas_error_t kbvas_enqueue(struct kbvas *self,
  */
 kbvas_error_t kbvas_dequeue(struct kbvas *self, struct kbvas_entry *entry);
 
+/**
+ * @brief Removes and retrieves up to @p n of the oldest entries.
+ *
+ * Uses the backend's pop_many() when it has one, or peeks the entries and
+ * drops them at once, so that a persistent backend updates its head once.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[out] entries Array of at least @p n entries to store them in.
+ * @param[in] n Number of entries to dequeue at most.
+ * @param[out] dequeued Number of entries dequeued, fewer than @p n when the
+ *             queue runs out.
+ *
+ * @return A kbvas_error_t indicating the result of the operation.
+ */
+kbvas_error_t kbvas_dequeue_many(struct kbvas *self,
+		struct kbvas_entry *entries, size_t n, size_t *dequeued);
+
 /**
  * @brief Peeks at the next entry in the kbvas queue.
  *
@@ -308,6 +966,21 @@ kbvas_error_t kbvas_dequeue(struct kbvas *self, struct kbvas_entry *entry);
 kbvas_error_t kbvas_peek(struct kbvas *self,
 		int entry_index, struct kbvas_entry *entry);
 
+/**
+ * @brief Peeks at up to @p n entries starting at index @p start.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] start Index of the first entry, 0 being the oldest.
+ * @param[out] entries Array of at least @p n entries to store them in.
+ * @param[in] n Number of entries to peek at most.
+ * @param[out] peeked Number of entries peeked, fewer than @p n when the
+ *             queue runs out.
+ *
+ * @return A kbvas_error_t indicating the result of the operation.
+ */
+kbvas_error_t kbvas_peek_range(struct kbvas *self, size_t start,
+		struct kbvas_entry *entries, size_t n, size_t *peeked);
+
 /**
  * @brief Iterates over queued entries in the kbvas instance.
  *
@@ -319,12 +992,176 @@ kbvas_error_t kbvas_peek(struct kbvas *self,
  * The callback function receives a pointer to each entry and a user-defined
  * context. This allows for batch processing, filtering, or data aggregation.
  *
+ * @note Entries decoded from records share one buffer per instance, so the
+ *       callback must not iterate the same instance again.
+ *
  * @param[in] self       Pointer to the kbvas instance.
  * @param[in] iterator   Callback function to invoke for each entry.
  * @param[in] ctx        User-defined context passed to the callback.
  */
 void kbvas_iterate(struct kbvas *self, kbvas_iterator_t iterator, void *ctx);
 
+/**
+ * @brief Peeks at a queued entry as a compact record view.
+ *
+ * @param[in] self A pointer to the kbvas instance.
+ * @param[in] entry_index The index of the entry to peek at, as in kbvas_peek().
+ * @param[out] record View of the record, valid until the next mutating call.
+ *
+ * @return KBVAS_ERROR_UNSUPPORTED if the backend has no record interface,
+ *         otherwise the result of the backend operation.
+ */
+kbvas_error_t kbvas_peek_record(struct kbvas *self,
+		int entry_index, struct kbvas_record *record);
+
+/**
+ * @brief Iterates over queued entries as compact record views.
+ *
+ * Works like kbvas_iterate() without materializing a struct kbvas_entry per
+ * entry. Nothing is visited if the backend has no record interface.
+ *
+ * @param[in] self       Pointer to the kbvas instance.
+ * @param[in] iterator   Callback function to invoke for each record.
+ * @param[in] ctx        User-defined context passed to the callback.
+ */
+void kbvas_iterate_records(struct kbvas *self,
+		kbvas_record_iterator_t iterator, void *ctx);
+
+/**
+ * @brief Expands a record into a full struct kbvas_entry.
+ *
+ * @param[in] record Record to expand.
+ * @param[out] entry Entry to fill in.
+ *
+ * @return A kbvas_error_t indicating the result of the operation.
+ */
+kbvas_error_t kbvas_decode_record(const struct kbvas_record *record,
+		struct kbvas_entry *entry);
+
+/**
+ * @brief Writes the base64 text of a record into a caller-supplied buffer.
+ *
+ * The text is that of kbvas_entry::base64_encoded, without a terminator.
+ * With KBVAS_USE_LAZY_BASE64 this is where the encoding happens, so a batch
+ * can be encoded straight into a transmit buffer without going through
+ * struct kbvas_entry.
+ *
+ * @param[in] record Record to encode.
+ * @param[out] buf Output buffer.
+ * @param[in] bufsize Size of @p buf in bytes.
+ * @param[out] len Number of characters written.
+ *
+ * @return KBVAS_ERROR_NONE on success, KBVAS_ERROR_NOSPC if @p buf is too
+ *         small, or KBVAS_ERROR_UNSUPPORTED in raw encoding.
+ */
+kbvas_error_t kbvas_encode_record(const struct kbvas_record *record,
+		char *buf, size_t bufsize, size_t *len);
+
+/**
+ * @brief Starts a TLV walk over a frame without copying it.
+ *
+ * Any byte span holding TLVs can be walked: a frame handed to
+ * kbvas_enqueue(), or the data of a struct kbvas_record in raw encoding.
+ * Base64 payloads have to be decoded first.
+ *
+ * @param[out] cursor Cursor to initialize.
+ * @param[in] data Frame to walk. Must outlive the cursor and views from it.
+ * @param[in] datasize Size of the frame in bytes.
+ */
+void kbvas_tlv_cursor_init(struct kbvas_tlv_cursor *cursor,
+		const void *data, size_t datasize);
+
+/**
+ * @brief Advances the cursor to the next TLV.
+ *
+ * @param[in,out] cursor Cursor initialized by kbvas_tlv_cursor_init().
+ * @param[out] tlv View of the TLV, pointing into the frame.
+ *
+ * @return KBVAS_ERROR_NONE on success, KBVAS_ERROR_NOENT at the end of the
+ *         frame, or KBVAS_ERROR_INVALID_FORMAT on an unknown type or a
+ *         truncated TLV, in which case the cursor does not advance.
+ */
+kbvas_error_t kbvas_tlv_next(struct kbvas_tlv_cursor *cursor,
+		struct kbvas_tlv *tlv);
+
+/**
+ * @brief Finds the first TLV of the given type in a frame.
+ *
+ * @param[in] data Frame to search.
+ * @param[in] datasize Size of the frame in bytes.
+ * @param[in] type kbvas_tlv_type_t to look for.
+ * @param[out] tlv View of the TLV found.
+ *
+ * @return KBVAS_ERROR_NONE if found, otherwise as kbvas_tlv_next().
+ */
+kbvas_error_t kbvas_tlv_find(const void *data, size_t datasize,
+		uint8_t type, struct kbvas_tlv *tlv);
+
+/**
+ * @brief Typed accessors for fixed-size big-endian TLV values.
+ *
+ * For instance, kbvas_tlv_get_u8() reads A3 (SOC) and A4 (SOH),
+ * kbvas_tlv_get_u16() reads A5 (BPA) and A6 (BPV) and kbvas_tlv_get_u32()
+ * reads A1 (timestamp).
+ *
+ * @return KBVAS_ERROR_INVALID_FORMAT if the TLV length does not match the
+ *         size of the requested type.
+ */
+kbvas_error_t kbvas_tlv_get_u8(const struct kbvas_tlv *tlv, uint8_t *value);
+kbvas_error_t kbvas_tlv_get_u16(const struct kbvas_tlv *tlv, uint16_t *value);
+kbvas_error_t kbvas_tlv_get_u32(const struct kbvas_tlv *tlv, uint32_t *value);
+
+/**
+ * @brief Computes min, max, their first positions, spread and mean of bytes.
+ *
+ * Runs SSE2 or NEON kernels where available and a portable SWAR kernel
+ * otherwise; defining KBVAS_NO_SIMD forces the portable one. With
+ * KBVAS_USE_SUMMARY defined in raw encoding, entries carry
+ * kbvas_entry::bsv_summary and kbvas_entry::bmt_summary filled by this on
+ * enqueue, so iteration never rescans the cells. Implemented in
+ * kbvas_summary.c, which is only needed when this is used.
+ *
+ * @param[in] values Bytes to summarize.
+ * @param[in] n Number of bytes, up to UINT16_MAX.
+ * @param[out] summary Result, zeroed when @p n is zero or out of range.
+ */
+void kbvas_summarize(const uint8_t *values, size_t n,
+		struct kbvas_summary *summary);
+
+/**
+ * @brief Finds the largest difference between bytes at the same positions.
+ *
+ * Runs the same kind of kernels as kbvas_summarize(), and is implemented in
+ * kbvas_summary.c as well.
+ *
+ * @param[in] a Bytes to compare.
+ * @param[in] b Bytes to compare with, as many as @p a.
+ * @param[in] n Number of bytes.
+ *
+ * @return The largest |a[i] - b[i]|, or 0 if @p n is zero.
+ */
+uint8_t kbvas_max_delta(const uint8_t *a, const uint8_t *b, size_t n);
+
+/**
+ * @brief Encodes bytes to padded base64 text, without a terminator.
+ *
+ * Produces the same text as lm_base64_encode(). When @p buf is too small,
+ * only the whole 4-character groups that fit are written. Runs AVX2, SSSE3 or
+ * NEON kernels when the compiler targets them and a scalar loop otherwise;
+ * KBVAS_NO_SIMD forces the scalar one. Defining KBVAS_USE_FAST_BASE64 makes
+ * the base64 encoding use this in place of lm_base64_encode(). Implemented
+ * in kbvas_base64.c, which is only needed when this is used.
+ *
+ * @param[out] buf Output buffer.
+ * @param[in] bufsize Size of @p buf in bytes.
+ * @param[in] data Bytes to encode.
+ * @param[in] datasize Number of bytes in @p data.
+ *
+ * @return Number of characters written.
+ */
+size_t kbvas_base64_encode(char *buf, size_t bufsize,
+		const void *data, size_t datasize);
+
 /**
  * @brief Retrieves the number of elements in the kbvas instance.
  *
@@ -336,6 +1173,57 @@ void kbvas_iterate(struct kbvas *self, kbvas_iterator_t iterator, void *ctx);
  */
 size_t kbvas_count(struct kbvas *self);
 
+#if defined(KBVAS_USE_STATS) || defined(KBVAS_USE_TRACE)
+/**
+ * @brief Sets the clock latencies are measured and trace points stamped by.
+ *
+ * @param[in] self Pointer to the kbvas instance.
+ * @param[in] clock Clock to read, or NULL to read none.
+ */
+void kbvas_set_clock(struct kbvas *self, kbvas_clock_t clock);
+#endif
+
+#if defined(KBVAS_USE_STATS)
+/**
+ * @brief Takes a snapshot of the counters of the kbvas instance.
+ *
+ * Counting takes a few increments per frame and per backend call, plus a
+ * count() call per frame enqueued for the high-water mark and two clock
+ * reads per measured operation when a clock is set.
+ *
+ * @note Statistics are for instances used from a single thread. The
+ *       counters are plain integers, so do not define KBVAS_USE_STATS where
+ *       a producer and a consumer thread share a ring.
+ *
+ * @param[in] self Pointer to the kbvas instance.
+ * @param[out] stats Snapshot.
+ *
+ * @return KBVAS_ERROR_NONE, or KBVAS_ERROR_MISSING_PARAM.
+ */
+kbvas_error_t kbvas_get_stats(const struct kbvas *self,
+		struct kbvas_stats *stats);
+void kbvas_reset_stats(struct kbvas *self);
+#endif
+
+#if defined(KBVAS_USE_TRACE)
+/**
+ * @brief Registers a hook to be called at the trace points.
+ *
+ * A frame is parsed, encoded and pushed in turn, then the batch callback is
+ * called if the push made a batch ready. On a stream, parse and encode are
+ * traced per chunk fed. Without KBVAS_USE_TRACE, no trace point is compiled
+ * in.
+ *
+ * @param[in] self Pointer to the kbvas instance.
+ * @param[in] hook Hook to call, or NULL to stop tracing.
+ * @param[in] ctx User context to be passed to the hook.
+ *
+ * @return KBVAS_ERROR_NONE, or KBVAS_ERROR_MISSING_PARAM.
+ */
+kbvas_error_t kbvas_register_trace_hook(struct kbvas *self,
+		kbvas_trace_hook_t hook, void *ctx);
+#endif
+
 #if defined(__cplusplus)
 }
 #endif
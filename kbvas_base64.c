@@ -0,0 +1,193 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "kbvas.h"
+#include <string.h>
+
+#if defined(KBVAS_NO_SIMD)
+#define USE_SCALAR
+#elif defined(__AVX2__)
+#define USE_AVX2
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#define USE_SSSE3
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define USE_NEON
+#include <arm_neon.h>
+#else
+#define USE_SCALAR
+#endif
+
+static const char alphabet[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* The x86 kernels follow Wojciech Muła's method: a byte shuffle spreads each
+ * 3-byte group over a 32-bit lane, two multiplies move the four 6-bit indices
+ * into place and a 16-entry table gives the offset of each index's range. */
+#if defined(USE_SSSE3) || defined(USE_AVX2)
+#define SPREAD_SHUFFLE	\
+	1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+#define RANGE_OFFSETS	\
+	65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0
+
+static __m128i encode_block(__m128i in)
+{
+	in = _mm_shuffle_epi8(in, _mm_setr_epi8(SPREAD_SHUFFLE));
+
+	const __m128i hi = _mm_mulhi_epu16(
+			_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+			_mm_set1_epi32(0x04000040));
+	const __m128i lo = _mm_mullo_epi16(
+			_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+			_mm_set1_epi32(0x01000010));
+	const __m128i idx = _mm_or_si128(hi, lo);
+
+	/* 0 for A-Z, 1 for a-z, 2..11 for 0-9, 12 for '+' and 13 for '/' */
+	const __m128i range = _mm_sub_epi8(
+			_mm_subs_epu8(idx, _mm_set1_epi8(51)),
+			_mm_cmpgt_epi8(idx, _mm_set1_epi8(25)));
+
+	return _mm_add_epi8(idx, _mm_shuffle_epi8(
+			_mm_setr_epi8(RANGE_OFFSETS), range));
+}
+#endif
+
+/* Each kernel encodes whole blocks while a full-width load stays within
+ * @p n and returns how many input bytes it consumed; the rest is left to the
+ * scalar loop. */
+#if defined(USE_AVX2)
+static __m256i encode_block2(__m256i in)
+{
+	in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(SPREAD_SHUFFLE,
+			SPREAD_SHUFFLE));
+
+	const __m256i hi = _mm256_mulhi_epu16(
+			_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+			_mm256_set1_epi32(0x04000040));
+	const __m256i lo = _mm256_mullo_epi16(
+			_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+			_mm256_set1_epi32(0x01000010));
+	const __m256i idx = _mm256_or_si256(hi, lo);
+	const __m256i range = _mm256_sub_epi8(
+			_mm256_subs_epu8(idx, _mm256_set1_epi8(51)),
+			_mm256_cmpgt_epi8(idx, _mm256_set1_epi8(25)));
+
+	return _mm256_add_epi8(idx, _mm256_shuffle_epi8(
+			_mm256_setr_epi8(RANGE_OFFSETS, RANGE_OFFSETS),
+			range));
+}
+
+static size_t kernel(char *out, const uint8_t *in, size_t n)
+{
+	size_t i = 0;
+
+	/* 24 bytes in, 32 out; the upper lane loads from in[12] */
+	for (; i + 28 <= n; i += 24, out += 32) {
+		const __m256i v = _mm256_inserti128_si256(
+				_mm256_castsi128_si256(_mm_loadu_si128(
+						(const __m128i *)&in[i])),
+				_mm_loadu_si128((const __m128i *)&in[i + 12]),
+				1);
+		_mm256_storeu_si256((__m256i *)out, encode_block2(v));
+	}
+
+	for (; i + 16 <= n; i += 12, out += 16) {
+		_mm_storeu_si128((__m128i *)out, encode_block(
+				_mm_loadu_si128((const __m128i *)&in[i])));
+	}
+
+	return i;
+}
+#elif defined(USE_SSSE3)
+static size_t kernel(char *out, const uint8_t *in, size_t n)
+{
+	size_t i = 0;
+
+	/* 12 bytes in, 16 out */
+	for (; i + 16 <= n; i += 12, out += 16) {
+		_mm_storeu_si128((__m128i *)out, encode_block(
+				_mm_loadu_si128((const __m128i *)&in[i])));
+	}
+
+	return i;
+}
+#elif defined(USE_NEON)
+static size_t kernel(char *out, const uint8_t *in, size_t n)
+{
+	const uint8x16x4_t table = vld1q_u8_x4((const uint8_t *)alphabet);
+	const uint8x16_t mask = vdupq_n_u8(0x3f);
+	size_t i = 0;
+
+	/* 48 bytes in, 64 out, deinterleaved by the structure load/store */
+	for (; i + 48 <= n; i += 48, out += 64) {
+		const uint8x16x3_t v = vld3q_u8(&in[i]);
+		uint8x16x4_t idx;
+
+		idx.val[0] = vshrq_n_u8(v.val[0], 2);
+		idx.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(v.val[1], 4),
+				vshlq_n_u8(v.val[0], 4)), mask);
+		idx.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(v.val[2], 6),
+				vshlq_n_u8(v.val[1], 2)), mask);
+		idx.val[3] = vandq_u8(v.val[2], mask);
+
+		idx.val[0] = vqtbl4q_u8(table, idx.val[0]);
+		idx.val[1] = vqtbl4q_u8(table, idx.val[1]);
+		idx.val[2] = vqtbl4q_u8(table, idx.val[2]);
+		idx.val[3] = vqtbl4q_u8(table, idx.val[3]);
+
+		vst4q_u8((uint8_t *)out, idx);
+	}
+
+	return i;
+}
+#elif defined(USE_SCALAR)
+static size_t kernel(char *out, const uint8_t *in, size_t n)
+{
+	(void)out;
+	(void)in;
+	(void)n;
+	return 0;
+}
+#endif
+
+size_t kbvas_base64_encode(char *buf, size_t bufsize,
+		const void *data, size_t datasize)
+{
+	const uint8_t *in = (const uint8_t *)data;
+
+	if (buf == NULL || (data == NULL && datasize)) {
+		return 0;
+	}
+
+	/* truncate to the whole groups that fit */
+	if (datasize > bufsize / 4 * 3) {
+		datasize = bufsize / 4 * 3;
+	}
+
+	size_t i = kernel(buf, in, datasize);
+	char *out = &buf[i / 3 * 4];
+
+	for (; i + 3 <= datasize; i += 3) {
+		const uint32_t v = (uint32_t)in[i] << 16 |
+			(uint32_t)in[i + 1] << 8 | in[i + 2];
+		*out++ = alphabet[v >> 18];
+		*out++ = alphabet[v >> 12 & 0x3f];
+		*out++ = alphabet[v >> 6 & 0x3f];
+		*out++ = alphabet[v & 0x3f];
+	}
+
+	if (i < datasize) {
+		const uint32_t v = (uint32_t)in[i] << 16 |
+			(i + 1 < datasize ? (uint32_t)in[i + 1] << 8 : 0);
+		*out++ = alphabet[v >> 18];
+		*out++ = alphabet[v >> 12 & 0x3f];
+		*out++ = i + 1 < datasize ? alphabet[v >> 6 & 0x3f] : '=';
+		*out++ = '=';
+	}
+
+	return (size_t)(out - buf);
+}
@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* for clock_gettime(), which macOS hides once it is defined */
+#if !defined(_POSIX_C_SOURCE) && !defined(__APPLE__)
+#define _POSIX_C_SOURCE		200809L
+#endif
+
+#include "kbvas_clock.h"
+
+#if defined(KBVAS_CLOCK_HAS_MONOTONIC)
+#include <time.h>
+
+uint64_t kbvas_clock_monotonic_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		return 0;
+	}
+
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#if defined(KBVAS_CLOCK_HAS_DWT)
+#define DEMCR			(*(volatile uint32_t *)0xE000EDFCu)
+#define DEMCR_TRCENA		(1u << 24)
+#define DWT_CTRL		(*(volatile uint32_t *)0xE0001000u)
+#define DWT_CTRL_CYCCNTENA	(1u << 0)
+#define DWT_CYCCNT		(*(volatile uint32_t *)0xE0001004u)
+#define DWT_LAR			(*(volatile uint32_t *)0xE0001FB0u)
+#define DWT_LAR_KEY		0xC5ACCE55u
+
+static uint32_t last_cycles;
+static uint32_t wraps;
+
+void kbvas_clock_dwt_init(void)
+{
+	DEMCR |= DEMCR_TRCENA;
+	DWT_LAR = DWT_LAR_KEY; /* locked out of reset on the M7 */
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+
+	last_cycles = 0;
+	wraps = 0;
+}
+
+uint64_t kbvas_clock_dwt_cycles(void)
+{
+	const uint32_t cycles = DWT_CYCCNT;
+
+	if (cycles < last_cycles) {
+		wraps++;
+	}
+	last_cycles = cycles;
+
+	return ((uint64_t)wraps << 32) | cycles;
+}
+#endif
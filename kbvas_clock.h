@@ -0,0 +1,55 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KOREA_BATTERY_VAS_CLOCK_H
+#define KOREA_BATTERY_VAS_CLOCK_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* Clocks to hand to kbvas_set_clock(), each built where its platform is */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define KBVAS_CLOCK_HAS_MONOTONIC
+/**
+ * @brief Reads CLOCK_MONOTONIC in nanoseconds.
+ *
+ * @return Nanoseconds since an unspecified point, or 0 if the clock could
+ *         not be read.
+ */
+uint64_t kbvas_clock_monotonic_ns(void);
+#endif
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || \
+		defined(__ARM_ARCH_8M_MAIN__)
+#define KBVAS_CLOCK_HAS_DWT
+/**
+ * @brief Enables and zeroes the DWT cycle counter of a Cortex-M3/M4/M7/M33.
+ *
+ * Call once before kbvas_clock_dwt_cycles(), with no debugger relying on
+ * the counter.
+ */
+void kbvas_clock_dwt_init(void);
+/**
+ * @brief Reads the DWT cycle counter, extended to 64 bits.
+ *
+ * The 32-bit counter is widened by counting its wraps, so it must be read
+ * at least once a wrap, about 25 seconds at 168MHz, and from one context
+ * at a time.
+ *
+ * @return CPU cycles since kbvas_clock_dwt_init().
+ */
+uint64_t kbvas_clock_dwt_cycles(void);
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* KOREA_BATTERY_VAS_CLOCK_H */
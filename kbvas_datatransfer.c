@@ -0,0 +1,438 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "kbvas_datatransfer.h"
+#include <string.h>
+
+#if defined(KBVAS_USE_BASE64)
+#if !defined(MIN)
+#define MIN(a, b)			(((a) > (b))? (b) : (a))
+#endif
+
+#if defined(KBVAS_USE_LAZY_BASE64)
+#define TIMESTAMP_TLV_LEN		6 /* not part of the base64 text */
+#endif
+#define ENCODE_CHUNK			72 /* input bytes encoded at a time */
+
+#define HEADER				"{\"vendorId\":\"" KBVAS_VENDOR_NAME \
+					"\",\"messageId\":\"" KBVAS_DT_IDSTR \
+					"\",\"data\":\"["
+#define FOOTER				"]\"}"
+#define ITEM_SEPARATOR			","
+#define ITEM_HEAD			"{\\\"timestamp\\\":"
+#define ITEM_VALUE			",\\\"value\\\":\\\""
+#define ITEM_TAIL			"\\\"}"
+
+#define LITERAL_LEN(s)			(sizeof(s) - 1)
+
+/* An entry as found in the backend: the text itself, or the frame it is
+ * encoded from when records are stored lazily. */
+struct item {
+	time_t timestamp;
+	const uint8_t *data;
+	size_t len;
+	bool encoded;
+};
+
+struct sink {
+	kbvas_dt_writer_t writer;
+	void *ctx;
+	size_t skip; /* bytes of the current piece produced by earlier calls */
+	size_t sent; /* bytes of the current piece produced by this call */
+	bool blocked;
+};
+
+typedef bool (*item_visitor_t)(const struct item *item, void *ctx);
+
+struct visit {
+	item_visitor_t visitor;
+	void *ctx;
+	size_t start; /* items before this are skipped */
+	size_t index;
+};
+
+struct buffer {
+	uint8_t *buf;
+	size_t bufsize;
+	size_t len;
+};
+
+static size_t format_timestamp(char *buf, time_t timestamp)
+{
+	char tmp[24];
+	const bool negative = timestamp < 0;
+	/* negated in unsigned so that the minimum value does not overflow */
+	uint64_t v = negative ? 0 - (uint64_t)timestamp : (uint64_t)timestamp;
+	size_t n = 0;
+
+	do {
+		tmp[n++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v);
+
+	size_t len = 0;
+	if (negative) {
+		buf[len++] = '-';
+	}
+	while (n) {
+		buf[len++] = tmp[--n];
+	}
+
+	return len;
+}
+
+static size_t text_len(const struct item *item)
+{
+	return item->encoded ? item->len : (item->len + 2) / 3 * 4;
+}
+
+static size_t item_size(const struct item *item, size_t index)
+{
+	char digits[24];
+
+	return (index ? LITERAL_LEN(ITEM_SEPARATOR) : 0) +
+		LITERAL_LEN(ITEM_HEAD) +
+		format_timestamp(digits, item->timestamp) +
+		LITERAL_LEN(ITEM_VALUE) + text_len(item) +
+		LITERAL_LEN(ITEM_TAIL);
+}
+
+static bool put(struct sink *sink, const void *data, size_t datasize)
+{
+	if (sink->skip >= datasize) {
+		sink->skip -= datasize;
+		return true;
+	}
+
+	const uint8_t *p = (const uint8_t *)data + sink->skip;
+	const size_t n = datasize - sink->skip;
+	const size_t accepted = (*sink->writer)(p, n, sink->ctx);
+
+	sink->skip = 0;
+	sink->sent += MIN(accepted, n);
+	sink->blocked = accepted < n;
+
+	return !sink->blocked;
+}
+
+static bool put_base64(struct sink *sink, const uint8_t *data, size_t n)
+{
+	const size_t len = (n + 2) / 3 * 4;
+
+	if (sink->skip >= len) {
+		sink->skip -= len;
+		return true;
+	}
+
+	char buf[ENCODE_CHUNK / 3 * 4];
+	size_t i = sink->skip / 4 * 3; /* resume at the group cut off */
+	sink->skip %= 4;
+
+	for (; i < n; i += ENCODE_CHUNK) {
+		const size_t encoded = kbvas_base64_encode(buf, sizeof(buf),
+				&data[i], MIN(n - i, ENCODE_CHUNK));
+		if (!put(sink, buf, encoded)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool put_item(struct sink *sink, const struct item *item, size_t index)
+{
+	char digits[24];
+	const size_t ndigits = format_timestamp(digits, item->timestamp);
+
+	return (!index || put(sink, ITEM_SEPARATOR,
+				LITERAL_LEN(ITEM_SEPARATOR))) &&
+		put(sink, ITEM_HEAD, LITERAL_LEN(ITEM_HEAD)) &&
+		put(sink, digits, ndigits) &&
+		put(sink, ITEM_VALUE, LITERAL_LEN(ITEM_VALUE)) &&
+		(item->encoded ? put(sink, item->data, item->len) :
+				put_base64(sink, item->data, item->len)) &&
+		put(sink, ITEM_TAIL, LITERAL_LEN(ITEM_TAIL));
+}
+
+static bool visit_record(struct kbvas *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	struct visit *visit = (struct visit *)ctx;
+
+	if (visit->index++ < visit->start) {
+		return true;
+	}
+
+#if defined(KBVAS_USE_LAZY_BASE64)
+	if (record->len < TIMESTAMP_TLV_LEN) {
+		return false;
+	}
+	const struct item item = {
+		.timestamp = record->timestamp,
+		.data = &record->data[TIMESTAMP_TLV_LEN],
+		.len = record->len - TIMESTAMP_TLV_LEN,
+	};
+#else
+	const struct item item = {
+		.timestamp = record->timestamp,
+		.data = record->data,
+		.len = record->len,
+		.encoded = true,
+	};
+#endif
+
+	return (*visit->visitor)(&item, visit->ctx);
+}
+
+static bool visit_entry(struct kbvas *self,
+		const struct kbvas_entry *entry, void *ctx)
+{
+	struct visit *visit = (struct visit *)ctx;
+
+	if (visit->index++ < visit->start) {
+		return true;
+	}
+
+	const char *end = (const char *)memchr(entry->base64_encoded, '\0',
+			sizeof(entry->base64_encoded));
+	const struct item item = {
+		.timestamp = entry->timestamp,
+		.data = (const uint8_t *)entry->base64_encoded,
+		.len = end ? (size_t)(end - entry->base64_encoded) :
+			sizeof(entry->base64_encoded),
+		.encoded = true,
+	};
+
+	return (*visit->visitor)(&item, visit->ctx);
+}
+
+/* Visits queued items from @p start on, in one pass over the backend */
+static void visit_items(struct kbvas *kbvas, size_t start,
+		item_visitor_t visitor, void *ctx)
+{
+	struct kbvas_record record;
+	struct visit visit = {
+		.visitor = visitor,
+		.ctx = ctx,
+		.start = start,
+	};
+
+	if (kbvas_peek_record(kbvas, 0, &record) != KBVAS_ERROR_UNSUPPORTED) {
+		kbvas_iterate_records(kbvas, visit_record, &visit);
+	} else {
+		kbvas_iterate(kbvas, visit_entry, &visit);
+	}
+}
+
+struct measure {
+	struct kbvas_dt_cursor *cursor;
+	size_t limit;
+};
+
+static bool measure_item(const struct item *item, void *ctx)
+{
+	struct measure *measure = (struct measure *)ctx;
+	struct kbvas_dt_cursor *cursor = measure->cursor;
+
+	cursor->size += item_size(item, cursor->count);
+
+	return ++cursor->count < measure->limit;
+}
+
+struct output {
+	struct kbvas_dt_cursor *cursor;
+	struct sink sink;
+};
+
+/* Moves the cursor past what this call produced of the current piece */
+static bool advance(struct output *out, bool done)
+{
+	struct kbvas_dt_cursor *cursor = out->cursor;
+
+	cursor->written += out->sink.sent;
+	cursor->offset += out->sink.sent;
+	out->sink.sent = 0;
+
+	if (done) {
+		cursor->piece++;
+		cursor->offset = 0;
+	}
+
+	return done;
+}
+
+static bool write_item(const struct item *item, void *ctx)
+{
+	struct output *out = (struct output *)ctx;
+	const size_t index = out->cursor->piece - 1;
+
+	if (index >= out->cursor->count) {
+		return false;
+	}
+
+	return advance(out, put_item(&out->sink, item, index));
+}
+
+static kbvas_error_t write_message(struct kbvas_dt_cursor *cursor,
+		kbvas_dt_writer_t writer, void *ctx)
+{
+	struct output out = {
+		.cursor = cursor,
+		.sink = {
+			.writer = writer,
+			.ctx = ctx,
+			.skip = cursor->offset,
+		},
+	};
+
+	if (cursor->piece == 0 && !advance(&out, put(&out.sink,
+			HEADER, LITERAL_LEN(HEADER)))) {
+		return KBVAS_ERROR_NONE;
+	}
+
+	if (cursor->piece <= cursor->count) {
+		size_t start = 0;
+		size_t count;
+
+		if (cursor->batch && kbvas_locate_batch(cursor->kbvas,
+				cursor->batch, &start, &count)
+				!= KBVAS_ERROR_NONE) {
+			return KBVAS_ERROR_NOENT;
+		}
+
+		visit_items(cursor->kbvas, start + cursor->piece - 1,
+				write_item, &out);
+
+		if (out.sink.blocked) {
+			return KBVAS_ERROR_NONE;
+		}
+		if (cursor->piece <= cursor->count) {
+			/* entries left the queue before the message was done */
+			return KBVAS_ERROR_NOENT;
+		}
+	}
+
+	if (cursor->piece == cursor->count + 1) {
+		advance(&out, put(&out.sink, FOOTER, LITERAL_LEN(FOOTER)));
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+static void begin(struct kbvas_dt_cursor *cursor, struct kbvas *kbvas,
+		kbvas_batch_id_t batch, size_t start, size_t count)
+{
+	struct measure measure = {
+		.cursor = cursor,
+		.limit = count,
+	};
+
+	*cursor = (struct kbvas_dt_cursor) {
+		.kbvas = kbvas,
+		.batch = batch,
+		.size = LITERAL_LEN(HEADER) + LITERAL_LEN(FOOTER),
+	};
+
+	if (measure.limit) {
+		visit_items(kbvas, start, measure_item, &measure);
+	}
+}
+
+static size_t write_buffer(const void *data, size_t datasize, void *ctx)
+{
+	struct buffer *buffer = (struct buffer *)ctx;
+	const size_t n = MIN(datasize, buffer->bufsize - buffer->len);
+
+	memcpy(&buffer->buf[buffer->len], data, n);
+	buffer->len += n;
+
+	return n;
+}
+#endif /* KBVAS_USE_BASE64 */
+
+kbvas_error_t kbvas_dt_begin(struct kbvas_dt_cursor *cursor,
+		struct kbvas *kbvas, size_t max_entries)
+{
+	if (cursor == NULL || kbvas == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+#if defined(KBVAS_USE_BASE64)
+	if (max_entries == 0) {
+		max_entries = kbvas_count_batch(kbvas);
+	}
+
+	begin(cursor, kbvas, 0, 0, MIN(max_entries, kbvas_count(kbvas)));
+
+	return cursor->count ? KBVAS_ERROR_NONE : KBVAS_ERROR_EMPTY;
+#else
+	(void)max_entries;
+	return KBVAS_ERROR_UNSUPPORTED;
+#endif
+}
+
+kbvas_error_t kbvas_dt_begin_batch(struct kbvas_dt_cursor *cursor,
+		struct kbvas *kbvas, kbvas_batch_id_t id)
+{
+	if (cursor == NULL || kbvas == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+#if defined(KBVAS_USE_BASE64)
+	size_t start;
+	size_t count;
+	kbvas_error_t err = kbvas_locate_batch(kbvas, id, &start, &count);
+
+	if (err != KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	begin(cursor, kbvas, id, start, count);
+
+	return cursor->count == count ? KBVAS_ERROR_NONE : KBVAS_ERROR_NOENT;
+#else
+	(void)id;
+	return KBVAS_ERROR_UNSUPPORTED;
+#endif
+}
+
+kbvas_error_t kbvas_dt_write(struct kbvas_dt_cursor *cursor,
+		kbvas_dt_writer_t writer, void *ctx)
+{
+	if (cursor == NULL || writer == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+#if defined(KBVAS_USE_BASE64)
+	return write_message(cursor, writer, ctx);
+#else
+	return KBVAS_ERROR_UNSUPPORTED;
+#endif
+}
+
+kbvas_error_t kbvas_dt_read(struct kbvas_dt_cursor *cursor,
+		void *buf, size_t bufsize, size_t *len)
+{
+	if (cursor == NULL || buf == NULL || len == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+#if defined(KBVAS_USE_BASE64)
+	struct buffer buffer = {
+		.buf = (uint8_t *)buf,
+		.bufsize = bufsize,
+	};
+	const kbvas_error_t err = write_message(cursor, write_buffer, &buffer);
+
+	*len = buffer.len;
+
+	return err;
+#else
+	(void)bufsize;
+	*len = 0;
+	return KBVAS_ERROR_UNSUPPORTED;
+#endif
+}
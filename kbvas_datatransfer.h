@@ -0,0 +1,125 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KOREA_BATTERY_VAS_DATATRANSFER_H
+#define KOREA_BATTERY_VAS_DATATRANSFER_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "kbvas.h"
+
+/**
+ * @brief Sink for kbvas_dt_write().
+ *
+ * @param[in] data Next bytes of the message.
+ * @param[in] datasize Number of bytes in @p data.
+ * @param[in] ctx User-defined context passed to kbvas_dt_write().
+ *
+ * @return Number of bytes accepted. Accepting fewer than @p datasize pauses
+ *         the serialization until the next kbvas_dt_write().
+ */
+typedef size_t (*kbvas_dt_writer_t)(const void *data, size_t datasize,
+		void *ctx);
+
+/**
+ * @brief Position of a DataTransfer message being serialized.
+ *
+ * @ref size and @ref written may be read by the caller; the rest is private.
+ */
+struct kbvas_dt_cursor {
+	struct kbvas *kbvas;
+	kbvas_batch_id_t batch; /* checked-out batch, or 0 for the oldest */
+	size_t count;   /* entries in the message */
+	size_t size;    /* total size of the message in bytes */
+	size_t written; /* bytes produced so far */
+
+	size_t piece;   /* 0: header, 1..count: entries, count + 1: footer */
+	size_t offset;  /* bytes of the piece already produced */
+};
+
+/**
+ * @brief Starts serializing the oldest entries as a DataTransfer request.
+ *
+ * The message is the OCPP DataTransfer.req payload with vendorId
+ * KBVAS_VENDOR_NAME, messageId KBVAS_DT_IDSTR and, as data, a JSON array in
+ * a string holding the timestamp and the base64 text of each entry:
+ *
+ *   {"vendorId":"kr.or.keco","messageId":"BatteryInfo",
+ *    "data":"[{\"timestamp\":1723624739,\"value\":\"ohE1...\"},...]"}
+ *
+ * without line breaks. Its exact size is known up front in
+ * kbvas_dt_cursor::size. Nothing is allocated or copied aside from the
+ * output itself; lazily stored records are encoded as they are written.
+ * The entries must stay queued until the message is done, so send it
+ * before kbvas_clear_batch(). Entries queued meanwhile are not included.
+ *
+ * Needs base64 encoding and kbvas_base64.c in the build.
+ *
+ * @param[out] cursor Cursor to initialize.
+ * @param[in] kbvas Queue to read from.
+ * @param[in] max_entries Maximum number of entries in the message, or 0 for
+ *            those of the next batch as counted by kbvas_count_batch().
+ *
+ * @return KBVAS_ERROR_NONE on success, KBVAS_ERROR_EMPTY if there is no
+ *         entry to send, or KBVAS_ERROR_UNSUPPORTED in raw encoding.
+ */
+kbvas_error_t kbvas_dt_begin(struct kbvas_dt_cursor *cursor,
+		struct kbvas *kbvas, size_t max_entries);
+
+/**
+ * @brief Starts serializing a batch checked out by kbvas_checkout_batch().
+ *
+ * Same as kbvas_dt_begin() except for the entries taken. Batches checked
+ * out earlier may be acknowledged in the meantime.
+ *
+ * @param[out] cursor Cursor to initialize.
+ * @param[in] kbvas Queue to read from.
+ * @param[in] id Id of the batch.
+ *
+ * @return KBVAS_ERROR_NONE on success, KBVAS_ERROR_NOENT if no batch of @p id
+ *         is checked out, or KBVAS_ERROR_UNSUPPORTED in raw encoding.
+ */
+kbvas_error_t kbvas_dt_begin_batch(struct kbvas_dt_cursor *cursor,
+		struct kbvas *kbvas, kbvas_batch_id_t id);
+
+/**
+ * @brief Writes the next part of the message into a buffer.
+ *
+ * Call again with a fresh buffer until kbvas_dt_cursor::written reaches
+ * kbvas_dt_cursor::size.
+ *
+ * @param[in,out] cursor Cursor initialized by kbvas_dt_begin().
+ * @param[out] buf Output buffer.
+ * @param[in] bufsize Size of @p buf in bytes.
+ * @param[out] len Number of bytes written to @p buf.
+ *
+ * @return A kbvas_error_t indicating the result of the operation.
+ */
+kbvas_error_t kbvas_dt_read(struct kbvas_dt_cursor *cursor,
+		void *buf, size_t bufsize, size_t *len);
+
+/**
+ * @brief Hands the rest of the message to @p writer in chunks.
+ *
+ * Stops early when @p writer accepts fewer bytes than offered; calling
+ * again resumes from there.
+ *
+ * @param[in,out] cursor Cursor initialized by kbvas_dt_begin().
+ * @param[in] writer Sink for the message.
+ * @param[in] ctx User-defined context passed to @p writer.
+ *
+ * @return A kbvas_error_t indicating the result of the operation.
+ */
+kbvas_error_t kbvas_dt_write(struct kbvas_dt_cursor *cursor,
+		kbvas_dt_writer_t writer, void *ctx);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* KOREA_BATTERY_VAS_DATATRANSFER_H */
@@ -0,0 +1,475 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "kbvas_file_backend.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAGIC				0x4642564bu /* "KBVF" */
+#define NR_HEADERS			2
+#define DATA_OFFSET			(NR_HEADERS * sizeof(struct header))
+#define ALIGN				8u
+#define NIL				UINT32_MAX
+#define WRAP				UINT32_MAX /* rest of the segment unused */
+
+/* The header copy with the higher sequence number and a matching CRC is the
+ * current one. Offsets are into the data segment. */
+struct header {
+	uint32_t magic;
+	uint32_t capacity;
+	uint32_t seq;
+	uint32_t head;  /* oldest record */
+	uint32_t tail;  /* past the newest record */
+	uint32_t last;  /* newest record */
+	uint32_t count;
+	uint32_t crc;   /* CRC-32 of the fields above */
+};
+
+struct record {
+	uint32_t len; /* or WRAP */
+	uint32_t reserved;
+	int64_t timestamp;
+	uint8_t data[];
+};
+
+struct kbvas_backend {
+	struct kbvas_backend_api api;
+	kbvas_file_sync_t sync;
+	int fd;
+	uint8_t *map;
+	size_t map_size;
+	uint32_t capacity;
+	struct header state; /* as last published */
+
+	uint32_t reserved; /* handed out by reserve_record() */
+	size_t reserved_size;
+};
+
+static uint32_t crc32(const void *data, size_t datasize)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	uint32_t crc = 0xffffffffu;
+
+	for (size_t i = 0; i < datasize; i++) {
+		crc ^= p[i];
+		for (int k = 0; k < 8; k++) {
+			crc = crc >> 1 ^ (0xedb88320u & -(crc & 1));
+		}
+	}
+
+	return ~crc;
+}
+
+static uint32_t record_size(size_t len)
+{
+	const size_t size = sizeof(struct record) + len;
+	return (uint32_t)((size + ALIGN - 1) / ALIGN * ALIGN);
+}
+
+static struct record *record_at(const struct kbvas_backend *self,
+		uint32_t offset)
+{
+	return (struct record *)&self->map[DATA_OFFSET + offset];
+}
+
+/* Where the record following one that ends at @p offset starts. */
+static uint32_t wrap(const struct kbvas_backend *self, uint32_t offset)
+{
+	if (self->capacity - offset < sizeof(struct record) ||
+			record_at(self, offset)->len == WRAP) {
+		return 0;
+	}
+	return offset;
+}
+
+static uint32_t next_record(const struct kbvas_backend *self, uint32_t offset)
+{
+	return wrap(self, offset + record_size(record_at(self, offset)->len));
+}
+
+static void flush(const struct kbvas_backend *self, size_t offset, size_t len)
+{
+	if (self->sync == KBVAS_FILE_SYNC_NONE || len == 0) {
+		return;
+	}
+
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t start = offset / page * page;
+
+	msync(&self->map[start], offset + len - start,
+			self->sync == KBVAS_FILE_SYNC_FULL ? MS_SYNC : MS_ASYNC);
+}
+
+static void publish(struct kbvas_backend *self, struct header *next)
+{
+	next->magic = MAGIC;
+	next->capacity = self->capacity;
+	next->seq = self->state.seq + 1;
+	next->crc = crc32(next, offsetof(struct header, crc));
+
+	const size_t offset = next->seq % NR_HEADERS * sizeof(*next);
+	memcpy(&self->map[offset], next, sizeof(*next));
+	flush(self, offset, sizeof(*next));
+
+	self->state = *next;
+}
+
+static bool is_valid(const struct kbvas_backend *self,
+		const struct header *header)
+{
+	return header->magic == MAGIC &&
+		header->capacity == self->capacity &&
+		header->crc == crc32(header, offsetof(struct header, crc)) &&
+		header->head < self->capacity &&
+		header->tail <= self->capacity &&
+		header->last < self->capacity;
+}
+
+static bool recover(struct kbvas_backend *self)
+{
+	const struct header *found = NULL;
+
+	for (int i = 0; i < NR_HEADERS; i++) {
+		const struct header *header = (const struct header *)
+			&self->map[(size_t)i * sizeof(*header)];
+
+		if (is_valid(self, header) &&
+				(!found || header->seq > found->seq)) {
+			found = header;
+		}
+	}
+
+	if (found) {
+		self->state = *found;
+	}
+
+	return found != NULL;
+}
+
+/* Finds room for @p size bytes after the newest record, going around to the
+ * start of the segment if the end is too short. */
+static kbvas_error_t find_space(const struct kbvas_backend *self,
+		uint32_t size, uint32_t *offset)
+{
+	const struct header *s = &self->state;
+
+	if (s->count == 0) {
+		*offset = 0;
+		return size <= self->capacity ?
+			KBVAS_ERROR_NONE : KBVAS_ERROR_NOSPC;
+	}
+
+	if (s->tail > s->head) {
+		if (self->capacity - s->tail >= size) {
+			*offset = s->tail;
+			return KBVAS_ERROR_NONE;
+		}
+		if (s->head >= size) {
+			*offset = 0;
+			return KBVAS_ERROR_NONE;
+		}
+	} else if (s->tail < s->head && s->head - s->tail >= size) {
+		*offset = s->tail;
+		return KBVAS_ERROR_NONE;
+	}
+
+	return KBVAS_ERROR_NOSPC;
+}
+
+static void append(struct kbvas_backend *self, uint32_t offset,
+		size_t len, time_t timestamp)
+{
+	struct header next = self->state;
+	struct record *r = record_at(self, offset);
+
+	r->len = (uint32_t)len;
+	r->reserved = 0;
+	r->timestamp = (int64_t)timestamp;
+
+	if (next.count == 0) {
+		next.head = offset;
+	} else if (offset != next.tail &&
+			self->capacity - next.tail >= sizeof(struct record)) {
+		record_at(self, next.tail)->len = WRAP;
+		flush(self, DATA_OFFSET + next.tail, sizeof(struct record));
+	}
+
+	flush(self, DATA_OFFSET + offset, sizeof(*r) + len);
+
+	next.tail = offset + record_size(len);
+	next.last = offset;
+	next.count++;
+
+	publish(self, &next);
+}
+
+static void to_record(const struct record *r, struct kbvas_record *record)
+{
+	*record = (struct kbvas_record) {
+		.timestamp = (time_t)r->timestamp,
+		.len = r->len,
+		.data = r->data,
+	};
+}
+
+static kbvas_error_t do_push_record(struct kbvas_backend *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	uint32_t offset;
+	kbvas_error_t err;
+
+	if (record->len > UINT16_MAX) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	if ((err = find_space(self, record_size(record->len), &offset))
+			!= KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	if (record->len) {
+		memcpy(record_at(self, offset)->data, record->data,
+				record->len);
+	}
+
+	append(self, offset, record->len, record->timestamp);
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_reserve_record(struct kbvas_backend *self,
+		size_t size, uint8_t **buf, void *ctx)
+{
+	uint32_t offset;
+	kbvas_error_t err;
+
+	self->reserved = NIL;
+
+	if (size > UINT16_MAX) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	if ((err = find_space(self, record_size(size), &offset))
+			!= KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	self->reserved = offset;
+	self->reserved_size = size;
+	*buf = record_at(self, offset)->data;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_commit_record(struct kbvas_backend *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	const uint32_t offset = self->reserved;
+
+	if (offset == NIL || record->data != record_at(self, offset)->data ||
+			record->len > self->reserved_size) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	self->reserved = NIL;
+	append(self, offset, record->len, record->timestamp);
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_peek_record(struct kbvas_backend *self,
+		int entry_index, struct kbvas_record *record, void *ctx)
+{
+	const size_t count = self->state.count;
+
+	if (count == 0 || entry_index >= (int)count ||
+			entry_index < -(int)count) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	size_t idx = entry_index >= 0 ?
+		(size_t)entry_index : count - (size_t)(-entry_index - 1) - 1;
+	uint32_t offset = self->state.last;
+
+	if (idx != count - 1) {
+		for (offset = self->state.head; idx; idx--) {
+			offset = next_record(self, offset);
+		}
+	}
+
+	to_record(record_at(self, offset), record);
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_drop(struct kbvas_backend *self, size_t n, void *ctx)
+{
+	struct header next = self->state;
+
+	if (n == 0) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	for (; n && next.count; n--, next.count--) {
+		next.head = next_record(self, next.head);
+	}
+
+	if (next.count == 0) {
+		next.head = next.tail = next.last = 0;
+	}
+
+	publish(self, &next);
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_clear(struct kbvas_backend *self, void *ctx)
+{
+	if (self) {
+		struct header next = { .seq = 0, };
+		publish(self, &next);
+	}
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_count(struct kbvas_backend *self,
+		size_t *count, void *ctx)
+{
+	(void)ctx;
+
+	if (count == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	*count = self ? self->state.count : 0;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_iterate_records(struct kbvas_backend *self,
+		kbvas_record_iterator_t iterator,
+		void *iterator_ctx, struct kbvas *kbvas_instance)
+{
+	if (self == NULL || iterator == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	uint32_t offset = self->state.head;
+
+	for (size_t i = 0; i < self->state.count; i++) {
+		struct kbvas_record record;
+
+		to_record(record_at(self, offset), &record);
+
+		if (!(*iterator)(kbvas_instance, &record, iterator_ctx)) {
+			break;
+		}
+
+		offset = next_record(self, offset);
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+static bool open_file(struct kbvas_backend *self, const char *path)
+{
+	struct stat st;
+	bool fresh = false;
+
+	if ((self->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0) {
+		return false;
+	}
+
+	if (fstat(self->fd, &st) != 0) {
+		return false;
+	}
+
+	if ((size_t)st.st_size != self->map_size) {
+		if (ftruncate(self->fd, 0) != 0 ||
+				ftruncate(self->fd, (off_t)self->map_size)
+				!= 0) {
+			return false;
+		}
+		fresh = true;
+	}
+
+	void *map = mmap(NULL, self->map_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, self->fd, 0);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	self->map = (uint8_t *)map;
+
+	if (fresh || !recover(self)) {
+		memset(self->map, 0, DATA_OFFSET);
+		do_clear(self, NULL);
+	}
+
+	return true;
+}
+
+struct kbvas_backend_api *kbvas_file_backend_create(const char *path,
+		size_t capacity, kbvas_file_sync_t sync)
+{
+	struct kbvas_backend *backend;
+
+	capacity -= capacity % ALIGN;
+
+	if (path == NULL || capacity < record_size(0) ||
+			capacity > UINT32_MAX - DATA_OFFSET - ALIGN) {
+		return NULL;
+	}
+
+	if (!(backend = (struct kbvas_backend *)calloc(1, sizeof(*backend)))) {
+		return NULL;
+	}
+
+	*backend = (struct kbvas_backend) {
+		.api = {
+			.drop = do_drop,
+			.clear = do_clear,
+			.count = do_count,
+			.push_record = do_push_record,
+			.peek_record = do_peek_record,
+			.iterate_records = do_iterate_records,
+			.reserve_record = do_reserve_record,
+			.commit_record = do_commit_record,
+			.caps = KBVAS_BACKEND_CAP_CONST_COUNT,
+		},
+		.sync = sync,
+		.fd = -1,
+		.map_size = DATA_OFFSET + capacity,
+		.capacity = (uint32_t)capacity,
+		.reserved = NIL,
+	};
+
+	if (!open_file(backend, path)) {
+		kbvas_file_backend_destroy(&backend->api);
+		return NULL;
+	}
+
+	return &backend->api;
+}
+
+void kbvas_file_backend_destroy(struct kbvas_backend_api *backend)
+{
+	if (backend) {
+		struct kbvas_backend *self = (struct kbvas_backend *)backend;
+
+		if (self->map) {
+			munmap(self->map, self->map_size);
+		}
+		if (self->fd >= 0) {
+			close(self->fd);
+		}
+
+		free(backend);
+	}
+}
@@ -0,0 +1,56 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KOREA_BATTERY_VAS_FILE_BACKEND_H
+#define KOREA_BATTERY_VAS_FILE_BACKEND_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "kbvas.h"
+
+typedef enum {
+	KBVAS_FILE_SYNC_NONE,	/* left to the kernel; survives a crash of
+				   the process but not of the system */
+	KBVAS_FILE_SYNC_ASYNC,	/* msync(MS_ASYNC) after each change */
+	KBVAS_FILE_SYNC_FULL,	/* msync(MS_SYNC) after each change;
+				   survives power loss */
+} kbvas_file_sync_t;
+
+/**
+ * @brief Creates a record backend persisted in a memory-mapped file.
+ *
+ * The file holds two copies of a small header followed by a data segment of
+ * @p capacity bytes, used as a ring of records appended at the tail and
+ * removed from the head. A push copies the record into the mapping and then
+ * publishes it by writing the head and tail offsets into the older header
+ * copy along with a sequence number and CRC, so a header torn by a crash
+ * leaves the other intact. Iteration walks the mapping in place.
+ *
+ * Opening an existing file of the same capacity takes the queue over from
+ * the newer valid header in constant time, without scanning the records.
+ * A file that is missing, of another capacity or without a valid header is
+ * started over empty.
+ *
+ * Needs POSIX mmap() and msync().
+ *
+ * @param[in] path Path of the file, created if it does not exist.
+ * @param[in] capacity Size of the data segment in bytes.
+ * @param[in] sync When to flush changes to the file.
+ *
+ * @return Backend API pointer, or NULL if @p capacity is too small or too
+ *         large, or the file cannot be opened or mapped.
+ */
+struct kbvas_backend_api *kbvas_file_backend_create(const char *path,
+		size_t capacity, kbvas_file_sync_t sync);
+void kbvas_file_backend_destroy(struct kbvas_backend_api *backend);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* KOREA_BATTERY_VAS_FILE_BACKEND_H */
@@ -0,0 +1,713 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "kbvas_flash_backend.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAGIC				0x4c42564bu /* "KBVL" */
+#define ERASED32			UINT32_MAX
+#define ERASED16			UINT16_MAX
+#define ALIGN				8u
+#define NONE				SIZE_MAX
+
+/* Programmed in two steps: magic and erase count right after the erase, the
+ * sequence number once the sector is opened for writing. */
+struct sector_header {
+	uint32_t magic;
+	uint32_t erase_count;
+	uint32_t seq;       /* ERASED32 until the sector is opened */
+	uint32_t seq_check; /* ~seq, telling a torn seq apart */
+};
+
+struct record {
+	uint32_t seq;
+	uint16_t len;
+	uint16_t flags;    /* unused, left erased */
+	int64_t timestamp;
+	uint32_t crc;      /* CRC-32 of the fields above and the data */
+	uint32_t dropped;  /* ERASED32 while queued */
+	uint8_t data[];
+};
+
+typedef enum {
+	SECTOR_ERASED,	/* formatted, not yet opened */
+	SECTOR_USED,	/* opened, may hold queued records */
+	SECTOR_DIRTY,	/* to be erased */
+} sector_state_t;
+
+struct sector {
+	uint32_t erase_count;
+	uint32_t seq;
+	uint32_t fill;  /* offset past the last record */
+	uint8_t state;  /* sector_state_t */
+	bool sealed;    /* ends in a torn record; no more writes */
+};
+
+struct pos {
+	size_t sector;
+	uint32_t offset;
+};
+
+struct kbvas_backend {
+	struct kbvas_backend_api api;
+	struct kbvas_flash_api *flash;
+
+	struct pos head; /* oldest queued record */
+	struct pos last; /* newest queued record */
+	size_t count;
+	size_t write;    /* sector being written, or NONE */
+	uint32_t seq;        /* of the next record */
+	uint32_t sector_seq; /* of the next sector opened */
+
+	uint8_t *buf;     /* record read last */
+	uint8_t *staging; /* record being pushed */
+	bool reserved;    /* staging handed out by reserve_record() */
+	size_t reserved_size;
+
+	struct sector sectors[];
+};
+
+static uint32_t crc32_update(uint32_t crc, const void *data, size_t datasize)
+{
+	const uint8_t *p = (const uint8_t *)data;
+
+	for (size_t i = 0; i < datasize; i++) {
+		crc ^= p[i];
+		for (int k = 0; k < 8; k++) {
+			crc = crc >> 1 ^ (0xedb88320u & -(crc & 1));
+		}
+	}
+
+	return crc;
+}
+
+static uint32_t record_crc(const struct record *r)
+{
+	uint32_t crc = crc32_update(0xffffffffu, r,
+			offsetof(struct record, crc));
+	return ~crc32_update(crc, r->data, r->len);
+}
+
+static uint32_t record_size(size_t len)
+{
+	const size_t size = sizeof(struct record) + len;
+	return (uint32_t)((size + ALIGN - 1) / ALIGN * ALIGN);
+}
+
+static size_t max_len(const struct kbvas_backend *self)
+{
+	const size_t len = self->flash->sector_size -
+		sizeof(struct sector_header) - sizeof(struct record);
+	return len < ERASED16 ? len : ERASED16 - 1;
+}
+
+static size_t address(const struct kbvas_backend *self, struct pos pos)
+{
+	return pos.sector * self->flash->sector_size + pos.offset;
+}
+
+static kbvas_error_t read_header(struct kbvas_backend *self, struct pos pos,
+		struct record *r)
+{
+	return (*self->flash->read)(self->flash, address(self, pos),
+			r, sizeof(*r));
+}
+
+/* Reads the record at @p pos into the read buffer. */
+static kbvas_error_t read_record(struct kbvas_backend *self, struct pos pos,
+		struct record **r)
+{
+	struct record *p = (struct record *)self->buf;
+	kbvas_error_t err;
+
+	if ((err = read_header(self, pos, p)) != KBVAS_ERROR_NONE) {
+		return err;
+	}
+	/* a length torn by a power cut may run past the sector */
+	if (p->len > max_len(self) || pos.offset + sizeof(*p) + p->len >
+			self->flash->sector_size) {
+		return KBVAS_ERROR_INVALID_FORMAT;
+	}
+	if (p->len && (err = (*self->flash->read)(self->flash,
+			address(self, pos) + sizeof(*p), p->data, p->len))
+			!= KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	*r = p;
+	return KBVAS_ERROR_NONE;
+}
+
+/* Where the record after one of @p len bytes at @p pos is, skipping sectors
+ * left empty by a torn record. */
+static void advance(const struct kbvas_backend *self, struct pos *pos,
+		size_t len)
+{
+	pos->offset += record_size(len);
+
+	for (size_t i = 0; i < self->flash->nr_sectors &&
+			pos->offset >= self->sectors[pos->sector].fill; i++) {
+		pos->sector = (pos->sector + 1) % self->flash->nr_sectors;
+		pos->offset = sizeof(struct sector_header);
+	}
+}
+
+static kbvas_error_t format(struct kbvas_backend *self, size_t sector)
+{
+	struct sector *s = &self->sectors[sector];
+	const struct sector_header header = {
+		.magic = MAGIC,
+		.erase_count = s->erase_count + 1,
+		.seq = ERASED32,
+		.seq_check = ERASED32,
+	};
+	kbvas_error_t err;
+
+	s->state = SECTOR_DIRTY;
+
+	if ((err = (*self->flash->erase)(self->flash, sector))
+			!= KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	s->erase_count++;
+
+	if ((err = (*self->flash->program)(self->flash,
+			sector * self->flash->sector_size,
+			&header, sizeof(header))) != KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	s->state = SECTOR_ERASED;
+	s->fill = sizeof(header);
+	s->sealed = false;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t erase_ahead(struct kbvas_backend *self)
+{
+	for (size_t i = 0; i < self->flash->nr_sectors; i++) {
+		if (self->sectors[i].state == SECTOR_DIRTY) {
+			kbvas_error_t err = format(self, i);
+			if (err != KBVAS_ERROR_NONE) {
+				return err;
+			}
+		}
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+/* The least worn sector not in use, to start the log from. */
+static size_t least_worn(const struct kbvas_backend *self)
+{
+	size_t found = 0;
+
+	for (size_t i = 1; i < self->flash->nr_sectors; i++) {
+		if (self->sectors[i].erase_count <
+				self->sectors[found].erase_count) {
+			found = i;
+		}
+	}
+
+	return found;
+}
+
+static kbvas_error_t open_next(struct kbvas_backend *self)
+{
+	const size_t next = self->write == NONE ? least_worn(self) :
+		(self->write + 1) % self->flash->nr_sectors;
+	struct sector *s = &self->sectors[next];
+	kbvas_error_t err;
+
+	if (s->state == SECTOR_USED) {
+		return KBVAS_ERROR_NOSPC;
+	}
+	if (s->state == SECTOR_DIRTY &&
+			(err = format(self, next)) != KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	const uint32_t seq[2] = { self->sector_seq, ~self->sector_seq };
+	if ((err = (*self->flash->program)(self->flash,
+			next * self->flash->sector_size +
+			offsetof(struct sector_header, seq),
+			seq, sizeof(seq))) != KBVAS_ERROR_NONE) {
+		s->state = SECTOR_DIRTY;
+		return err;
+	}
+
+	/* left without a queued record, as the newest is always in it */
+	if (self->write != NONE && self->count == 0) {
+		self->sectors[self->write].state = SECTOR_DIRTY;
+	}
+
+	self->write = next;
+	s->state = SECTOR_USED;
+	s->seq = self->sector_seq++;
+
+	return KBVAS_ERROR_NONE;
+}
+
+/* Programs the record staged in the staging buffer. */
+static kbvas_error_t append(struct kbvas_backend *self, size_t len,
+		time_t timestamp)
+{
+	struct record *r = (struct record *)self->staging;
+	const uint32_t size = record_size(len);
+	kbvas_error_t err;
+
+	if (self->write == NONE || self->sectors[self->write].sealed ||
+			self->sectors[self->write].fill + size >
+			self->flash->sector_size) {
+		if ((err = open_next(self)) != KBVAS_ERROR_NONE) {
+			return err;
+		}
+	}
+
+	struct sector *s = &self->sectors[self->write];
+	const struct pos pos = { .sector = self->write, .offset = s->fill };
+
+	r->seq = self->seq;
+	r->len = (uint16_t)len;
+	r->flags = ERASED16;
+	r->timestamp = (int64_t)timestamp;
+	r->crc = record_crc(r);
+	r->dropped = ERASED32;
+
+	/* a failed record may have been programmed whole, so its seq is
+	 * spent either way */
+	self->seq++;
+
+	if ((err = (*self->flash->program)(self->flash, address(self, pos),
+			r, sizeof(*r) + len)) != KBVAS_ERROR_NONE) {
+		s->sealed = true;
+		return err;
+	}
+
+	s->fill += size;
+
+	if (self->count++ == 0) {
+		self->head = pos;
+	}
+	self->last = pos;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t drop_records(struct kbvas_backend *self, size_t n)
+{
+	const uint32_t dropped = 0;
+	kbvas_error_t err = KBVAS_ERROR_NONE;
+
+	for (; n && self->count; n--) {
+		struct record r;
+
+		if ((err = read_header(self, self->head, &r))
+				!= KBVAS_ERROR_NONE ||
+				(err = (*self->flash->program)(self->flash,
+					address(self, self->head) +
+					offsetof(struct record, dropped),
+					&dropped, sizeof(dropped)))
+				!= KBVAS_ERROR_NONE) {
+			break;
+		}
+
+		struct pos next = self->head;
+		advance(self, &next, r.len);
+		const size_t stop = --self->count ? next.sector : self->write;
+
+		/* the sectors passed hold no more queued records */
+		for (size_t i = self->head.sector; i != stop && i != self->write;
+				i = (i + 1) % self->flash->nr_sectors) {
+			self->sectors[i].state = SECTOR_DIRTY;
+		}
+
+		self->head = next;
+	}
+
+	kbvas_error_t erase_err = erase_ahead(self);
+
+	return err != KBVAS_ERROR_NONE ? err : erase_err;
+}
+
+static kbvas_error_t find(struct kbvas_backend *self, size_t idx,
+		struct pos *pos)
+{
+	if (idx == self->count - 1) {
+		*pos = self->last;
+		return KBVAS_ERROR_NONE;
+	}
+
+	*pos = self->head;
+
+	for (; idx; idx--) {
+		struct record r;
+		kbvas_error_t err = read_header(self, *pos, &r);
+
+		if (err != KBVAS_ERROR_NONE) {
+			return err;
+		}
+
+		advance(self, pos, r.len);
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+static void to_record(const struct record *r, struct kbvas_record *record)
+{
+	*record = (struct kbvas_record) {
+		.timestamp = (time_t)r->timestamp,
+		.len = r->len,
+		.data = r->data,
+	};
+}
+
+static kbvas_error_t do_push_record(struct kbvas_backend *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	if (record->len > max_len(self)) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	self->reserved = false;
+
+	if (record->len) {
+		memcpy(((struct record *)self->staging)->data, record->data,
+				record->len);
+	}
+
+	return append(self, record->len, record->timestamp);
+}
+
+static kbvas_error_t do_reserve_record(struct kbvas_backend *self,
+		size_t size, uint8_t **buf, void *ctx)
+{
+	if (size > max_len(self)) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	self->reserved = true;
+	self->reserved_size = size;
+	*buf = ((struct record *)self->staging)->data;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_commit_record(struct kbvas_backend *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	if (!self->reserved ||
+			record->data != ((struct record *)self->staging)->data
+			|| record->len > self->reserved_size) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	self->reserved = false;
+
+	return append(self, record->len, record->timestamp);
+}
+
+static kbvas_error_t do_peek_record(struct kbvas_backend *self,
+		int entry_index, struct kbvas_record *record, void *ctx)
+{
+	const size_t count = self->count;
+	struct record *r;
+	struct pos pos;
+	kbvas_error_t err;
+
+	if (count == 0 || entry_index >= (int)count ||
+			entry_index < -(int)count) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	const size_t idx = entry_index >= 0 ?
+		(size_t)entry_index : count - (size_t)(-entry_index - 1) - 1;
+
+	if ((err = find(self, idx, &pos)) != KBVAS_ERROR_NONE ||
+			(err = read_record(self, pos, &r)) != KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	to_record(r, record);
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_drop(struct kbvas_backend *self, size_t n, void *ctx)
+{
+	if (n == 0) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	return drop_records(self, n);
+}
+
+static kbvas_error_t do_clear(struct kbvas_backend *self, void *ctx)
+{
+	if (self && self->count) {
+		return drop_records(self, self->count);
+	}
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_count(struct kbvas_backend *self,
+		size_t *count, void *ctx)
+{
+	(void)ctx;
+
+	if (count == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	*count = self ? self->count : 0;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_iterate_records(struct kbvas_backend *self,
+		kbvas_record_iterator_t iterator,
+		void *iterator_ctx, struct kbvas *kbvas_instance)
+{
+	if (self == NULL || iterator == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	struct pos pos = self->head;
+
+	for (size_t i = 0; i < self->count; i++) {
+		struct record *r;
+		kbvas_error_t err = read_record(self, pos, &r);
+
+		if (err != KBVAS_ERROR_NONE) {
+			return err;
+		}
+
+		advance(self, &pos, r->len);
+
+		struct kbvas_record record;
+		to_record(r, &record);
+		if (!(*iterator)(kbvas_instance, &record, iterator_ctx)) {
+			break;
+		}
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+static bool is_blank(const uint8_t *p, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (p[i] != 0xff) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Sorts out the state of a sector from its header. */
+static kbvas_error_t probe(struct kbvas_backend *self, size_t sector)
+{
+	struct sector *s = &self->sectors[sector];
+	const size_t size = self->flash->sector_size;
+	struct sector_header header;
+	kbvas_error_t err;
+
+	if ((err = (*self->flash->read)(self->flash, sector * size,
+			self->buf, size)) != KBVAS_ERROR_NONE) {
+		return err;
+	}
+
+	memcpy(&header, self->buf, sizeof(header));
+
+	*s = (struct sector) {
+		.state = SECTOR_DIRTY,
+		.fill = sizeof(header),
+	};
+
+	if (header.magic != MAGIC) {
+		return KBVAS_ERROR_NONE;
+	}
+
+	s->erase_count = header.erase_count;
+
+	if (header.seq == ERASED32 && header.seq_check == ERASED32) {
+		if (is_blank(&self->buf[sizeof(header)],
+				size - sizeof(header))) {
+			s->state = SECTOR_ERASED;
+		}
+	} else if (header.seq_check == ~header.seq) {
+		s->state = SECTOR_USED;
+		s->seq = header.seq;
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+/* Walks the records of a used sector, up to the first erased or torn one. */
+static kbvas_error_t scan(struct kbvas_backend *self, size_t sector)
+{
+	struct sector *s = &self->sectors[sector];
+	struct pos pos = { .sector = sector, .offset = s->fill };
+
+	while (pos.offset + sizeof(struct record) <= self->flash->sector_size) {
+		struct record *r;
+		kbvas_error_t err = read_record(self, pos, &r);
+
+		if (err == KBVAS_ERROR_INVALID_FORMAT) {
+			break;
+		} else if (err != KBVAS_ERROR_NONE) {
+			return err;
+		}
+
+		if (r->seq == ERASED32 && r->len == ERASED16) {
+			return KBVAS_ERROR_NONE;
+		}
+		if (r->seq < self->seq || r->crc != record_crc(r)) {
+			break;
+		}
+
+		/* drops mark a prefix of the queue */
+		if (self->count || r->dropped == ERASED32) {
+			if (self->count++ == 0) {
+				self->head = pos;
+			}
+			self->last = pos;
+		}
+
+		self->seq = r->seq + 1;
+		pos.offset += record_size(r->len);
+		s->fill = pos.offset;
+	}
+
+	s->sealed = true;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static bool in_log(const struct kbvas_backend *self, size_t oldest,
+		size_t sector)
+{
+	const size_t n = self->flash->nr_sectors;
+
+	return oldest != NONE && (sector + n - oldest) % n <=
+		(self->write + n - oldest) % n;
+}
+
+/* Used sectors follow one another in the order opened, from the one with
+ * the lowest sequence number. Any other is left over from an interrupted
+ * erase or start and is erased. */
+static kbvas_error_t recover(struct kbvas_backend *self)
+{
+	const size_t n = self->flash->nr_sectors;
+	size_t oldest = NONE;
+	kbvas_error_t err;
+
+	for (size_t i = 0; i < n; i++) {
+		if ((err = probe(self, i)) != KBVAS_ERROR_NONE) {
+			return err;
+		}
+		if (self->sectors[i].state == SECTOR_USED && (oldest == NONE ||
+				self->sectors[i].seq <
+				self->sectors[oldest].seq)) {
+			oldest = i;
+		}
+	}
+
+	for (size_t i = oldest; i != NONE;) {
+		const size_t queued = self->count;
+
+		if ((err = scan(self, i)) != KBVAS_ERROR_NONE) {
+			return err;
+		}
+
+		/* all records before this sector are dropped */
+		if (self->write != NONE && queued == 0) {
+			self->sectors[self->write].state = SECTOR_DIRTY;
+		}
+
+		self->write = i;
+		self->sector_seq = self->sectors[i].seq + 1;
+
+		i = (i + 1) % n;
+		if (i == oldest || self->sectors[i].state != SECTOR_USED ||
+				self->sectors[i].seq != self->sector_seq) {
+			i = NONE;
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if (self->sectors[i].state == SECTOR_USED &&
+				!in_log(self, oldest, i)) {
+			self->sectors[i].state = SECTOR_DIRTY;
+		}
+	}
+
+	if (self->write != NONE && self->count == 0 &&
+			self->sectors[self->write].sealed) {
+		self->sectors[self->write].state = SECTOR_DIRTY;
+		self->write = NONE;
+	}
+
+	return erase_ahead(self);
+}
+
+struct kbvas_backend_api *kbvas_flash_backend_create(
+		struct kbvas_flash_api *flash)
+{
+	struct kbvas_backend *backend;
+
+	if (flash == NULL || flash->nr_sectors < 2 ||
+			flash->sector_size < sizeof(struct sector_header) +
+			record_size(0) ||
+			flash->sector_size > UINT32_MAX) {
+		return NULL;
+	}
+
+	if (!(backend = (struct kbvas_backend *)calloc(1, sizeof(*backend) +
+			flash->nr_sectors * sizeof(backend->sectors[0])))) {
+		return NULL;
+	}
+
+	*backend = (struct kbvas_backend) {
+		.api = {
+			.drop = do_drop,
+			.clear = do_clear,
+			.count = do_count,
+			.push_record = do_push_record,
+			.peek_record = do_peek_record,
+			.iterate_records = do_iterate_records,
+			.reserve_record = do_reserve_record,
+			.commit_record = do_commit_record,
+			.caps = KBVAS_BACKEND_CAP_CONST_COUNT,
+		},
+		.flash = flash,
+		.write = NONE,
+		.buf = (uint8_t *)malloc(flash->sector_size),
+		.staging = (uint8_t *)malloc(flash->sector_size),
+	};
+
+	if (!backend->buf || !backend->staging ||
+			recover(backend) != KBVAS_ERROR_NONE) {
+		kbvas_flash_backend_destroy(&backend->api);
+		return NULL;
+	}
+
+	return &backend->api;
+}
+
+void kbvas_flash_backend_destroy(struct kbvas_backend_api *backend)
+{
+	if (backend) {
+		struct kbvas_backend *self = (struct kbvas_backend *)backend;
+		free(self->buf);
+		free(self->staging);
+		free(backend);
+	}
+}
@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KOREA_BATTERY_VAS_FLASH_BACKEND_H
+#define KOREA_BATTERY_VAS_FLASH_BACKEND_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "kbvas.h"
+
+/**
+ * @brief NOR flash the backend is stored in.
+ *
+ * Offsets are in bytes from the start of the area given to the backend,
+ * which spans @ref nr_sectors sectors of @ref sector_size bytes. Programming
+ * may only clear bits; erasing a sector sets all of its bytes to 0xff.
+ */
+struct kbvas_flash_api {
+	kbvas_error_t (*read)(struct kbvas_flash_api *self, size_t offset,
+			void *buf, size_t len);
+	kbvas_error_t (*program)(struct kbvas_flash_api *self, size_t offset,
+			const void *data, size_t len);
+	kbvas_error_t (*erase)(struct kbvas_flash_api *self, size_t sector);
+
+	size_t sector_size;
+	size_t nr_sectors;
+};
+
+/**
+ * @brief Creates a log-structured record backend on NOR flash.
+ *
+ * Records are appended to one sector after another in turn, each with a
+ * sequence number and a CRC-32, so every sector is erased once per round
+ * and wear spreads evenly. A dropped record is marked so by clearing a word
+ * in its header; no sector is erased until all of its records are dropped.
+ * It is erased then, on the side that drops records, so that the sector
+ * after the one being written is normally erased before a push needs it
+ * and a push does not wait for an erase. A push erases at most one sector,
+ * and only one that was freed with no drop since.
+ *
+ * On creation, the flash is scanned to take the queue over: records that
+ * were torn by a power loss fail their CRC and end their sector, and the
+ * first record not marked dropped is the head. Sectors not formatted by
+ * this backend are erased.
+ *
+ * Records are read into a buffer of a sector's size, to which peeked views
+ * point, and a record cannot be larger than a sector less its header.
+ *
+ * @param[in] flash Flash to use, at least two sectors. Must outlive the
+ *            backend.
+ *
+ * @return Backend API pointer, or NULL if @p flash has too few or too small
+ *         sectors, or the allocation or a flash operation fails.
+ */
+struct kbvas_backend_api *kbvas_flash_backend_create(
+		struct kbvas_flash_api *flash);
+void kbvas_flash_backend_destroy(struct kbvas_backend_api *backend);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* KOREA_BATTERY_VAS_FLASH_BACKEND_H */
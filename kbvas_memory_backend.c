@@ -13,11 +13,16 @@ struct kbvas_backend {
 	struct kbvas_backend_api api;
 	struct list entries;
 	size_t count;
+
+	struct entry *reserved; /* handed out by reserve_record() */
+	size_t reserved_size;
 };
 
 struct entry {
-	struct kbvas_entry entry;
 	struct list link;
+	time_t timestamp;
+	uint16_t len;
+	uint8_t data[];
 };
 
 static void clear_all(struct kbvas_backend *self)
@@ -30,6 +35,8 @@ static void clear_all(struct kbvas_backend *self)
 		list_del(&entry->link, &self->entries);
 		free(entry);
 	}
+
+	self->count = 0;
 }
 
 static void clear_entries(struct kbvas_backend *self, size_t n)
@@ -49,48 +56,81 @@ static void clear_entries(struct kbvas_backend *self, size_t n)
 		struct entry *entry = list_entry(p, struct entry, link);
 		list_del(&entry->link, &self->entries);
 		free(entry);
+		self->count--;
 	}
 }
 
 static size_t count_entries(const struct kbvas_backend *self)
 {
-	return (size_t)list_count(&self->entries);
+	return self->count;
 }
 
-static kbvas_error_t do_push(struct kbvas_backend *self,
-		const struct kbvas_entry *entry, void *ctx)
+static kbvas_error_t do_push_record(struct kbvas_backend *self,
+		const struct kbvas_record *record, void *ctx)
 {
-	struct entry *p = (struct entry *)calloc(1, sizeof(*p));
+	if (record->len > UINT16_MAX) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	struct entry *p = (struct entry *)malloc(sizeof(*p) + record->len);
 	if (!p) {
 		return KBVAS_ERROR_NOSPC;
 	}
-	memcpy(&p->entry, entry, sizeof(*entry));
+
+	p->timestamp = record->timestamp;
+	p->len = (uint16_t)record->len;
+	if (record->len) {
+		memcpy(p->data, record->data, record->len);
+	}
+
 	list_add_tail(&p->link, &self->entries);
+	self->count++;
+
 	return KBVAS_ERROR_NONE;
 }
 
-static kbvas_error_t do_pop(struct kbvas_backend *self,
-		struct kbvas_entry *entry, void *ctx)
+static kbvas_error_t do_reserve_record(struct kbvas_backend *self,
+		size_t size, uint8_t **buf, void *ctx)
 {
-	if (list_empty(&self->entries)) {
-		return KBVAS_ERROR_NOENT;
+	if (size > UINT16_MAX) {
+		return KBVAS_ERROR_NOSPC;
 	}
 
-	struct entry *p = list_entry(list_first(&self->entries),
-			struct entry, link);
+	free(self->reserved);
+	self->reserved = (struct entry *)malloc(sizeof(*self->reserved) + size);
 
-	if (entry) {
-		memcpy(entry, &p->entry, sizeof(*entry));
+	if (!self->reserved) {
+		return KBVAS_ERROR_NOSPC;
 	}
 
-	list_del(&p->link, &self->entries);
-	free(p);
+	self->reserved_size = size;
+	*buf = self->reserved->data;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_commit_record(struct kbvas_backend *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	struct entry *p = self->reserved;
+
+	if (!p || record->data != p->data ||
+			record->len > self->reserved_size) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	p->timestamp = record->timestamp;
+	p->len = (uint16_t)record->len;
+
+	list_add_tail(&p->link, &self->entries);
+	self->count++;
+	self->reserved = NULL;
 
 	return KBVAS_ERROR_NONE;
 }
 
-static kbvas_error_t do_peek(struct kbvas_backend *self, int entry_index,
-		struct kbvas_entry *entry, void *ctx)
+static kbvas_error_t do_peek_record(struct kbvas_backend *self,
+		int entry_index, struct kbvas_record *record, void *ctx)
 {
 	const size_t count = count_entries(self);
 
@@ -107,7 +147,11 @@ static kbvas_error_t do_peek(struct kbvas_backend *self, int entry_index,
 	list_for_each(p, &self->entries) {
 		if (i++ == idx) {
 			struct entry *e = list_entry(p, struct entry, link);
-			memcpy(entry, &e->entry, sizeof(*entry));
+			*record = (struct kbvas_record) {
+				.timestamp = e->timestamp,
+				.len = e->len,
+				.data = e->data,
+			};
 			return KBVAS_ERROR_NONE;
 		}
 	}
@@ -152,8 +196,8 @@ static kbvas_error_t do_count(struct kbvas_backend *self,
 	return KBVAS_ERROR_NONE;
 }
 
-static kbvas_error_t do_iterate(struct kbvas_backend *self,
-		kbvas_iterator_t iterator,
+static kbvas_error_t do_iterate_records(struct kbvas_backend *self,
+		kbvas_record_iterator_t iterator,
 		void *iterator_ctx, struct kbvas *kbvas_instance)
 {
 	if (self == NULL || iterator == NULL) {
@@ -163,7 +207,12 @@ static kbvas_error_t do_iterate(struct kbvas_backend *self,
 	struct list *p;
 	list_for_each(p, &self->entries) {
 		struct entry *e = list_entry(p, struct entry, link);
-		if (!(*iterator)(kbvas_instance, &e->entry, iterator_ctx)) {
+		const struct kbvas_record record = {
+			.timestamp = e->timestamp,
+			.len = e->len,
+			.data = e->data,
+		};
+		if (!(*iterator)(kbvas_instance, &record, iterator_ctx)) {
 			break;
 		}
 	}
@@ -181,13 +230,15 @@ struct kbvas_backend_api *kbvas_memory_backend_create(void)
 
 	*backend = (struct kbvas_backend) {
 		.api = {
-			.push = do_push,
-			.pop = do_pop,
-			.peek = do_peek,
 			.drop = do_drop,
 			.clear = do_clear,
 			.count = do_count,
-			.iterate = do_iterate,
+			.push_record = do_push_record,
+			.peek_record = do_peek_record,
+			.iterate_records = do_iterate_records,
+			.reserve_record = do_reserve_record,
+			.commit_record = do_commit_record,
+			.caps = KBVAS_BACKEND_CAP_CONST_COUNT,
 		},
 	};
 
@@ -201,6 +252,7 @@ void kbvas_memory_backend_destroy(struct kbvas_backend_api *backend)
 	if (backend) {
 		struct kbvas_backend *self = (struct kbvas_backend *)backend;
 		backend->clear(self, NULL);
+		free(self->reserved);
 		free(backend);
 	}
 }
@@ -0,0 +1,461 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "kbvas_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NIL				UINT32_MAX
+
+/* Arena blocks are laid out back to back; a free one is merged with the free
+ * blocks after it when an allocation comes across them. */
+struct block {
+	uint32_t size; /* including this header, a multiple of ALIGN */
+	uint32_t next; /* offset of the next record in the queue, or NIL */
+	time_t timestamp;
+	uint16_t len;
+	bool used;
+	uint8_t data[];
+};
+
+#define ALIGN				8u
+#define MIN_BLOCK_SIZE			(sizeof(struct block) + ALIGN)
+
+struct kbvas_backend {
+	struct kbvas_backend_api api;
+	struct kbvas_pool *pool;
+
+	uint32_t head;
+	uint32_t tail;
+	size_t count;
+
+	uint32_t reserved; /* handed out by reserve_record() */
+	size_t reserved_size;
+};
+
+struct connector {
+	struct kbvas_backend queue;
+	struct kbvas *kbvas;
+};
+
+struct kbvas_pool {
+	uint8_t *arena;
+	size_t arena_size;
+	size_t used;
+	uint32_t rover; /* where the next allocation starts looking */
+
+	size_t next; /* connector the next drain starts at */
+	size_t nr_connectors;
+	struct connector connectors[];
+};
+
+static struct block *block_at(const struct kbvas_pool *pool, uint32_t offset)
+{
+	return (struct block *)&pool->arena[offset];
+}
+
+static uint32_t block_size(size_t len)
+{
+	const size_t size = sizeof(struct block) + len;
+	return (uint32_t)((size + ALIGN - 1) / ALIGN * ALIGN);
+}
+
+/* Cuts the free remainder off a block that is larger than @p size. */
+static void split(struct kbvas_pool *pool, uint32_t offset, uint32_t size)
+{
+	struct block *b = block_at(pool, offset);
+
+	if (b->size - size < MIN_BLOCK_SIZE) {
+		return;
+	}
+
+	struct block *rest = block_at(pool, offset + size);
+	rest->size = b->size - size;
+	rest->used = false;
+	b->size = size;
+}
+
+static void merge_free(struct kbvas_pool *pool, uint32_t offset)
+{
+	struct block *b = block_at(pool, offset);
+
+	while (offset + b->size < pool->arena_size) {
+		const struct block *next = block_at(pool, offset + b->size);
+		if (next->used) {
+			break;
+		}
+		b->size += next->size;
+	}
+}
+
+/* Next fit: the search goes on from the last allocation, which suits queues
+ * that free their oldest records first. */
+static uint32_t alloc_block(struct kbvas_pool *pool, size_t len)
+{
+	if (len > UINT16_MAX) {
+		return NIL;
+	}
+
+	const uint32_t size = block_size(len);
+	uint32_t offset = pool->rover;
+
+	for (size_t scanned = 0; scanned < pool->arena_size;) {
+		struct block *b = block_at(pool, offset);
+
+		if (!b->used) {
+			merge_free(pool, offset);
+		}
+
+		if (!b->used && b->size >= size) {
+			split(pool, offset, size);
+			b->used = true;
+			b->next = NIL;
+			pool->used += b->size;
+			pool->rover = offset + b->size;
+			if (pool->rover == pool->arena_size) {
+				pool->rover = 0;
+			}
+			return offset;
+		}
+
+		scanned += b->size;
+		offset += b->size;
+		if (offset == pool->arena_size) {
+			offset = 0;
+		}
+	}
+
+	/* a merge may have swallowed the block the rover pointed at */
+	pool->rover = 0;
+	return NIL;
+}
+
+static void free_block(struct kbvas_pool *pool, uint32_t offset)
+{
+	struct block *b = block_at(pool, offset);
+
+	b->used = false;
+	pool->used -= b->size;
+}
+
+static void shrink_block(struct kbvas_pool *pool, uint32_t offset, size_t len)
+{
+	const struct block *b = block_at(pool, offset);
+	const uint32_t size = b->size;
+
+	split(pool, offset, block_size(len));
+	pool->used -= size - b->size;
+}
+
+static void link_block(struct kbvas_backend *self, uint32_t offset)
+{
+	if (self->tail == NIL) {
+		self->head = offset;
+	} else {
+		block_at(self->pool, self->tail)->next = offset;
+	}
+
+	self->tail = offset;
+	self->count++;
+}
+
+static void drop_blocks(struct kbvas_backend *self, size_t n)
+{
+	for (; n && self->head != NIL; n--) {
+		const uint32_t offset = self->head;
+		self->head = block_at(self->pool, offset)->next;
+		free_block(self->pool, offset);
+		self->count--;
+	}
+
+	if (self->head == NIL) {
+		self->tail = NIL;
+	}
+}
+
+static void release_reserved(struct kbvas_backend *self)
+{
+	if (self->reserved != NIL) {
+		free_block(self->pool, self->reserved);
+		self->reserved = NIL;
+	}
+}
+
+static void to_record(const struct block *b, struct kbvas_record *record)
+{
+	*record = (struct kbvas_record) {
+		.timestamp = b->timestamp,
+		.len = b->len,
+		.data = b->data,
+	};
+}
+
+static kbvas_error_t do_push_record(struct kbvas_backend *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	const uint32_t offset = alloc_block(self->pool, record->len);
+
+	if (offset == NIL) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	struct block *b = block_at(self->pool, offset);
+	b->timestamp = record->timestamp;
+	b->len = (uint16_t)record->len;
+	if (record->len) {
+		memcpy(b->data, record->data, record->len);
+	}
+
+	link_block(self, offset);
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_reserve_record(struct kbvas_backend *self,
+		size_t size, uint8_t **buf, void *ctx)
+{
+	release_reserved(self);
+
+	if ((self->reserved = alloc_block(self->pool, size)) == NIL) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	self->reserved_size = size;
+	*buf = block_at(self->pool, self->reserved)->data;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_commit_record(struct kbvas_backend *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	const uint32_t offset = self->reserved;
+
+	if (offset == NIL || record->data != block_at(self->pool, offset)->data
+			|| record->len > self->reserved_size) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	struct block *b = block_at(self->pool, offset);
+	b->timestamp = record->timestamp;
+	b->len = (uint16_t)record->len;
+	shrink_block(self->pool, offset, record->len);
+
+	self->reserved = NIL;
+	link_block(self, offset);
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_peek_record(struct kbvas_backend *self,
+		int entry_index, struct kbvas_record *record, void *ctx)
+{
+	const size_t count = self->count;
+
+	if (count == 0 || entry_index >= (int)count ||
+			entry_index < -(int)count) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	size_t idx = entry_index >= 0 ?
+		(size_t)entry_index : count - (size_t)(-entry_index - 1) - 1;
+	uint32_t offset = self->tail;
+
+	if (idx != count - 1) {
+		for (offset = self->head; idx; idx--) {
+			offset = block_at(self->pool, offset)->next;
+		}
+	}
+
+	to_record(block_at(self->pool, offset), record);
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_drop(struct kbvas_backend *self, size_t n, void *ctx)
+{
+	if (n == 0) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	drop_blocks(self, n);
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_clear(struct kbvas_backend *self, void *ctx)
+{
+	if (self) {
+		drop_blocks(self, self->count);
+	}
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_count(struct kbvas_backend *self,
+		size_t *count, void *ctx)
+{
+	(void)ctx;
+
+	if (count == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	*count = self ? self->count : 0;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_iterate_records(struct kbvas_backend *self,
+		kbvas_record_iterator_t iterator,
+		void *iterator_ctx, struct kbvas *kbvas_instance)
+{
+	if (self == NULL || iterator == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	for (uint32_t offset = self->head; offset != NIL;) {
+		const struct block *b = block_at(self->pool, offset);
+		struct kbvas_record record;
+
+		to_record(b, &record);
+
+		offset = b->next;
+
+		if (!(*iterator)(kbvas_instance, &record, iterator_ctx)) {
+			break;
+		}
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+static void init_queue(struct kbvas_backend *self, struct kbvas_pool *pool)
+{
+	*self = (struct kbvas_backend) {
+		.api = {
+			.drop = do_drop,
+			.clear = do_clear,
+			.count = do_count,
+			.push_record = do_push_record,
+			.peek_record = do_peek_record,
+			.iterate_records = do_iterate_records,
+			.reserve_record = do_reserve_record,
+			.commit_record = do_commit_record,
+			.caps = KBVAS_BACKEND_CAP_CONST_COUNT,
+		},
+		.pool = pool,
+		.head = NIL,
+		.tail = NIL,
+		.reserved = NIL,
+	};
+}
+
+struct kbvas *kbvas_pool_get(struct kbvas_pool *pool, size_t connector)
+{
+	if (pool == NULL || connector >= pool->nr_connectors) {
+		return NULL;
+	}
+
+	return pool->connectors[connector].kbvas;
+}
+
+size_t kbvas_pool_count(const struct kbvas_pool *pool)
+{
+	return pool ? pool->nr_connectors : 0;
+}
+
+size_t kbvas_pool_used(const struct kbvas_pool *pool)
+{
+	return pool ? pool->used : 0;
+}
+
+size_t kbvas_pool_drain(struct kbvas_pool *pool, size_t max_batches,
+		kbvas_pool_drain_t cb, void *ctx)
+{
+	size_t sent = 0;
+
+	if (pool == NULL || cb == NULL) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < pool->nr_connectors; i++) {
+		if (max_batches && sent >= max_batches) {
+			break;
+		}
+
+		const size_t connector = pool->next;
+		struct kbvas *kbvas = pool->connectors[connector].kbvas;
+
+		if (kbvas_is_batch_ready(kbvas)) {
+			if (!(*cb)(pool, connector, kbvas, ctx)) {
+				break;
+			}
+
+			kbvas_clear_batch(kbvas);
+			sent++;
+		}
+
+		pool->next = (connector + 1) % pool->nr_connectors;
+	}
+
+	return sent;
+}
+
+struct kbvas_pool *kbvas_pool_create(size_t nr_connectors, size_t arena_size)
+{
+	struct kbvas_pool *pool;
+
+	/* offsets are 32-bit with NIL reserved */
+	if (nr_connectors == 0 || arena_size < MIN_BLOCK_SIZE ||
+			arena_size >= NIL) {
+		return NULL;
+	}
+
+	arena_size -= arena_size % ALIGN;
+
+	if (!(pool = (struct kbvas_pool *)calloc(1, sizeof(*pool) +
+			nr_connectors * sizeof(pool->connectors[0])))) {
+		return NULL;
+	}
+
+	if (!(pool->arena = (uint8_t *)malloc(arena_size))) {
+		free(pool);
+		return NULL;
+	}
+
+	pool->arena_size = arena_size;
+	pool->nr_connectors = nr_connectors;
+	*block_at(pool, 0) = (struct block) {
+		.size = (uint32_t)arena_size,
+		.used = false,
+	};
+
+	for (size_t i = 0; i < nr_connectors; i++) {
+		struct connector *c = &pool->connectors[i];
+
+		init_queue(&c->queue, pool);
+
+		if (!(c->kbvas = kbvas_create(&c->queue.api, NULL))) {
+			kbvas_pool_destroy(pool);
+			return NULL;
+		}
+	}
+
+	return pool;
+}
+
+void kbvas_pool_destroy(struct kbvas_pool *pool)
+{
+	if (pool == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < pool->nr_connectors; i++) {
+		kbvas_destroy(pool->connectors[i].kbvas);
+	}
+
+	free(pool->arena);
+	free(pool);
+}
@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KOREA_BATTERY_VAS_POOL_H
+#define KOREA_BATTERY_VAS_POOL_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "kbvas.h"
+
+struct kbvas_pool;
+
+/**
+ * @brief Callback invoked by kbvas_pool_drain() for a connector whose batch
+ *        is ready.
+ *
+ * Send the batch of @p kbvas, e.g. with kbvas_dt_begin(), and return whether
+ * it went out. The pool then removes it by kbvas_clear_batch().
+ *
+ * @param[in] pool Pool being drained.
+ * @param[in] connector Index of the connector.
+ * @param[in] kbvas Queue of the connector.
+ * @param[in] ctx User-defined context passed to kbvas_pool_drain().
+ *
+ * @return true if the batch was sent. false leaves it queued and ends the
+ *         drain; the next drain starts over at this connector.
+ */
+typedef bool (*kbvas_pool_drain_t)(struct kbvas_pool *pool, size_t connector,
+		struct kbvas *kbvas, void *ctx);
+
+/**
+ * @brief Creates a pool of connector queues sharing one storage arena.
+ *
+ * Each connector gets its own kbvas instance, backed by a record queue
+ * whose records are allocated from an arena of @p arena_size bytes
+ * preallocated here. Queues take space from the arena as they grow and give
+ * it back as they are cleared, so a busy connector may use what idle ones
+ * do not need instead of each being provisioned for the worst case. When
+ * the arena is full, kbvas_enqueue() on any connector fails with
+ * KBVAS_ERROR_NOSPC.
+ *
+ * Records are stored as encoded, as with kbvas_memory_backend_create(), plus
+ * a 24-byte header on 64-bit targets.
+ *
+ * @param[in] nr_connectors Number of connectors.
+ * @param[in] arena_size Size of the shared arena in bytes.
+ *
+ * @return A pointer to the new pool, or NULL if @p nr_connectors is zero,
+ *         @p arena_size is out of range or the allocation fails.
+ */
+struct kbvas_pool *kbvas_pool_create(size_t nr_connectors, size_t arena_size);
+void kbvas_pool_destroy(struct kbvas_pool *pool);
+
+/**
+ * @brief Gets the kbvas instance of a connector.
+ *
+ * The instance is owned by the pool. Configure and use it as any other,
+ * but do not destroy it.
+ *
+ * @param[in] pool Pool to look up.
+ * @param[in] connector Index of the connector, from 0.
+ *
+ * @return The instance, or NULL if @p connector is out of range.
+ */
+struct kbvas *kbvas_pool_get(struct kbvas_pool *pool, size_t connector);
+
+/**
+ * @brief Gets the number of connectors in the pool.
+ */
+size_t kbvas_pool_count(const struct kbvas_pool *pool);
+
+/**
+ * @brief Gets the number of arena bytes taken by queued records.
+ */
+size_t kbvas_pool_used(const struct kbvas_pool *pool);
+
+/**
+ * @brief Sends the ready batches of all connectors in turn.
+ *
+ * Visits each connector at most once, starting after the one served last,
+ * and calls @p cb for those for which kbvas_is_batch_ready() holds. This
+ * way every connector gets its turn no matter how busy the others are.
+ *
+ * @param[in] pool Pool to drain.
+ * @param[in] max_batches Maximum number of batches to send, or 0 for no
+ *            limit other than one per connector.
+ * @param[in] cb Callback sending a batch.
+ * @param[in] ctx User-defined context passed to @p cb.
+ *
+ * @return The number of batches sent.
+ */
+size_t kbvas_pool_drain(struct kbvas_pool *pool, size_t max_batches,
+		kbvas_pool_drain_t cb, void *ctx);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* KOREA_BATTERY_VAS_POOL_H */
@@ -0,0 +1,342 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "kbvas_ring_backend.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(MIN)
+#define MIN(a, b)			(((a) > (b))? (b) : (a))
+#endif
+
+#if defined(KBVAS_NO_ATOMICS)
+typedef size_t ring_index_t;
+#else
+#include <stdatomic.h>
+typedef atomic_size_t ring_index_t;
+#endif
+
+struct kbvas_backend {
+	struct kbvas_backend_api api;
+	kbvas_ring_overflow_t overflow;
+	size_t capacity;
+	/* Each index is stored by one side only: head by the consumer as it
+	 * removes entries, tail by the producer as it commits them. Stores
+	 * release the slots they hand over and loads acquire them. */
+	ring_index_t head; /* slot index of the oldest entry */
+	ring_index_t tail; /* slot index past the newest entry */
+	/* capacity + 1 slots: the one past the newest entry is never live and
+	 * serves as the reservation slot, so a reservation that fails to be
+	 * committed leaves the queued entries intact. */
+	struct kbvas_entry slots[];
+};
+
+static size_t load_index(ring_index_t *index)
+{
+#if defined(KBVAS_NO_ATOMICS)
+	return *index;
+#else
+	return atomic_load_explicit(index, memory_order_acquire);
+#endif
+}
+
+static void store_index(ring_index_t *index, size_t value)
+{
+#if defined(KBVAS_NO_ATOMICS)
+	*index = value;
+#else
+	atomic_store_explicit(index, value, memory_order_release);
+#endif
+}
+
+static size_t wrap(const struct kbvas_backend *self, size_t pos)
+{
+	return pos > self->capacity ? pos - (self->capacity + 1) : pos;
+}
+
+static size_t count_between(const struct kbvas_backend *self,
+		size_t head, size_t tail)
+{
+	return tail >= head ? tail - head : tail + self->capacity + 1 - head;
+}
+
+static struct kbvas_entry *slot_at(struct kbvas_backend *self,
+		size_t head, size_t index)
+{
+	return &self->slots[wrap(self, head + index)];
+}
+
+static kbvas_error_t do_reserve(struct kbvas_backend *self,
+		struct kbvas_entry **entry, void *ctx)
+{
+	const size_t tail = load_index(&self->tail);
+	const size_t head = load_index(&self->head);
+
+	if (count_between(self, head, tail) == self->capacity &&
+			self->overflow != KBVAS_RING_OVERFLOW_OVERWRITE) {
+		return KBVAS_ERROR_NOSPC;
+	}
+
+	*entry = &self->slots[tail];
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_commit(struct kbvas_backend *self,
+		struct kbvas_entry *entry, void *ctx)
+{
+	const size_t tail = load_index(&self->tail);
+	const size_t head = load_index(&self->head);
+
+	if (entry != &self->slots[tail]) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	if (count_between(self, head, tail) == self->capacity) {
+		if (self->overflow != KBVAS_RING_OVERFLOW_OVERWRITE) {
+			return KBVAS_ERROR_NOSPC;
+		}
+		store_index(&self->head, wrap(self, head + 1));
+	}
+
+	store_index(&self->tail, wrap(self, tail + 1));
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_push(struct kbvas_backend *self,
+		const struct kbvas_entry *entry, void *ctx)
+{
+	struct kbvas_entry *slot;
+	kbvas_error_t err = do_reserve(self, &slot, ctx);
+
+	if (err == KBVAS_ERROR_NONE) {
+		memcpy(slot, entry, sizeof(*entry));
+		err = do_commit(self, slot, ctx);
+	}
+
+	return err;
+}
+
+static kbvas_error_t do_pop(struct kbvas_backend *self,
+		struct kbvas_entry *entry, void *ctx)
+{
+	const size_t head = load_index(&self->head);
+	const size_t tail = load_index(&self->tail);
+
+	if (head == tail) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	if (entry) {
+		memcpy(entry, &self->slots[head], sizeof(*entry));
+	}
+
+	store_index(&self->head, wrap(self, head + 1));
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_peek(struct kbvas_backend *self, int entry_index,
+		struct kbvas_entry *entry, void *ctx)
+{
+	const size_t head = load_index(&self->head);
+	const size_t count = count_between(self, head, load_index(&self->tail));
+
+	if (count == 0 || entry_index >= (int)count ||
+			entry_index < -(int)count) {
+		return KBVAS_ERROR_NOENT;
+	}
+
+	const size_t idx = entry_index >= 0 ?
+		(size_t)entry_index : count - (size_t)(-entry_index - 1) - 1;
+
+	memcpy(entry, slot_at(self, head, idx), sizeof(*entry));
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_drop(struct kbvas_backend *self, size_t n, void *ctx)
+{
+	if (n == 0) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	const size_t head = load_index(&self->head);
+	const size_t count = count_between(self, head, load_index(&self->tail));
+
+	store_index(&self->head, wrap(self, head + (n > count ? count : n)));
+
+	return KBVAS_ERROR_NONE;
+}
+
+/* Copies @p n entries from @p pos, in at most two spans as they wrap */
+static void copy_out(struct kbvas_backend *self, size_t pos,
+		struct kbvas_entry *entries, size_t n)
+{
+	const size_t first = MIN(n, self->capacity + 1 - pos);
+
+	memcpy(entries, &self->slots[pos], first * sizeof(*entries));
+	memcpy(&entries[first], self->slots, (n - first) * sizeof(*entries));
+}
+
+static void copy_in(struct kbvas_backend *self, size_t pos,
+		const struct kbvas_entry *entries, size_t n)
+{
+	const size_t first = MIN(n, self->capacity + 1 - pos);
+
+	memcpy(&self->slots[pos], entries, first * sizeof(*entries));
+	memcpy(self->slots, &entries[first], (n - first) * sizeof(*entries));
+}
+
+static kbvas_error_t do_push_many(struct kbvas_backend *self,
+		const struct kbvas_entry *entries, size_t n,
+		size_t *pushed, void *ctx)
+{
+	if (self->overflow == KBVAS_RING_OVERFLOW_OVERWRITE) {
+		kbvas_error_t err = KBVAS_ERROR_NONE;
+
+		for (*pushed = 0; *pushed < n && err == KBVAS_ERROR_NONE;) {
+			if ((err = do_push(self, &entries[*pushed], ctx))
+					== KBVAS_ERROR_NONE) {
+				(*pushed)++;
+			}
+		}
+
+		return err;
+	}
+
+	const size_t tail = load_index(&self->tail);
+	const size_t room = self->capacity -
+		count_between(self, load_index(&self->head), tail);
+
+	*pushed = MIN(n, room);
+	copy_in(self, tail, entries, *pushed);
+	store_index(&self->tail, wrap(self, tail + *pushed));
+
+	return *pushed < n ? KBVAS_ERROR_NOSPC : KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_pop_many(struct kbvas_backend *self,
+		struct kbvas_entry *entries, size_t n,
+		size_t *popped, void *ctx)
+{
+	const size_t head = load_index(&self->head);
+	const size_t count = count_between(self, head, load_index(&self->tail));
+
+	*popped = MIN(n, count);
+
+	if (entries) {
+		copy_out(self, head, entries, *popped);
+	}
+
+	store_index(&self->head, wrap(self, head + *popped));
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_peek_range(struct kbvas_backend *self, size_t start,
+		struct kbvas_entry *entries, size_t n,
+		size_t *peeked, void *ctx)
+{
+	const size_t head = load_index(&self->head);
+	const size_t count = count_between(self, head, load_index(&self->tail));
+
+	*peeked = start < count ? MIN(n, count - start) : 0;
+	copy_out(self, wrap(self, head + MIN(start, count)), entries, *peeked);
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_clear(struct kbvas_backend *self, void *ctx)
+{
+	if (self) {
+		store_index(&self->head, load_index(&self->tail));
+	}
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_count(struct kbvas_backend *self,
+		size_t *count, void *ctx)
+{
+	(void)ctx;
+
+	if (count == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	*count = self ? count_between(self, load_index(&self->head),
+			load_index(&self->tail)) : 0;
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_iterate(struct kbvas_backend *self,
+		kbvas_iterator_t iterator,
+		void *iterator_ctx, struct kbvas *kbvas_instance)
+{
+	if (self == NULL || iterator == NULL) {
+		return KBVAS_ERROR_MISSING_PARAM;
+	}
+
+	const size_t head = load_index(&self->head);
+	const size_t count = count_between(self, head, load_index(&self->tail));
+
+	for (size_t i = 0; i < count; i++) {
+		if (!(*iterator)(kbvas_instance, slot_at(self, head, i),
+				iterator_ctx)) {
+			break;
+		}
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+struct kbvas_backend_api *kbvas_ring_backend_create(size_t capacity,
+		kbvas_ring_overflow_t overflow)
+{
+	struct kbvas_backend *backend;
+
+	if (capacity == 0 || capacity >= (SIZE_MAX - sizeof(*backend)) /
+			sizeof(struct kbvas_entry)) {
+		return NULL;
+	}
+
+	if (!(backend = (struct kbvas_backend *)calloc(1, sizeof(*backend) +
+			(capacity + 1) * sizeof(struct kbvas_entry)))) {
+		return NULL;
+	}
+
+	backend->api = (struct kbvas_backend_api) {
+		.push = do_push,
+		.pop = do_pop,
+		.peek = do_peek,
+		.drop = do_drop,
+		.clear = do_clear,
+		.count = do_count,
+		.iterate = do_iterate,
+		.reserve = do_reserve,
+		.commit = do_commit,
+		.push_many = do_push_many,
+		.pop_many = do_pop_many,
+		.peek_range = do_peek_range,
+		.caps = KBVAS_BACKEND_CAP_CONST_COUNT |
+			KBVAS_BACKEND_CAP_RANDOM_PEEK |
+			(overflow == KBVAS_RING_OVERFLOW_REJECT ?
+			 KBVAS_BACKEND_CAP_SPSC : 0),
+	};
+	backend->overflow = overflow;
+	backend->capacity = capacity;
+	store_index(&backend->head, 0);
+	store_index(&backend->tail, 0);
+
+	return &backend->api;
+}
+
+void kbvas_ring_backend_destroy(struct kbvas_backend_api *backend)
+{
+	free(backend);
+}
@@ -0,0 +1,59 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef KOREA_BATTERY_VAS_RING_BACKEND_H
+#define KOREA_BATTERY_VAS_RING_BACKEND_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "kbvas.h"
+
+typedef enum {
+	KBVAS_RING_OVERFLOW_REJECT,	/* fail with KBVAS_ERROR_NOSPC */
+	KBVAS_RING_OVERFLOW_OVERWRITE,	/* discard the oldest entry */
+} kbvas_ring_overflow_t;
+
+/**
+ * @brief Creates a fixed-capacity in-memory backend.
+ *
+ * All entry slots are allocated once at creation time as a single contiguous
+ * ring, so push, pop, peek, drop and count run in constant time and never
+ * touch the heap afterwards. The backend implements reserve() and commit(),
+ * letting kbvas_enqueue() parse frames in place without any allocation, and
+ * the batched push_many(), pop_many() and peek_range(), which copy a range
+ * of entries in at most two spans and move an index once.
+ *
+ * With KBVAS_RING_OVERFLOW_REJECT, the ring is a lock-free single-producer,
+ * single-consumer queue: one thread may enqueue, by kbvas_enqueue(),
+ * kbvas_enqueue_entries() or a stream, while another reads and removes
+ * entries, by kbvas_peek(), kbvas_peek_range(), kbvas_iterate(),
+ * kbvas_dequeue(), kbvas_dequeue_many(), kbvas_clear_batch(), kbvas_clear()
+ * and kbvas_count(), without any lock. The batch callback then runs on the
+ * producer. Configure the kbvas instance before both start, and leave out
+ * the batch byte budget, age limit and checkouts, whose state is kept in
+ * the kbvas instance rather than the ring. Overwriting removes entries from
+ * the producer side, so KBVAS_RING_OVERFLOW_OVERWRITE needs a single thread.
+ *
+ * The indices are C11 atomics unless KBVAS_NO_ATOMICS is defined, for
+ * toolchains without them; the ring is single-threaded then.
+ *
+ * @param[in] capacity Maximum number of entries the ring can hold.
+ * @param[in] overflow Policy applied when pushing into a full ring.
+ *
+ * @return Backend API pointer, or NULL if @p capacity is zero or the
+ *         allocation fails.
+ */
+struct kbvas_backend_api *kbvas_ring_backend_create(size_t capacity,
+		kbvas_ring_overflow_t overflow);
+void kbvas_ring_backend_destroy(struct kbvas_backend_api *backend);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* KOREA_BATTERY_VAS_RING_BACKEND_H */
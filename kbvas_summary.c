@@ -0,0 +1,272 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "kbvas.h"
+#include <string.h>
+
+#if defined(KBVAS_NO_SIMD)
+#define USE_SWAR
+#elif defined(__SSE2__)
+#define USE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define USE_NEON
+#include <arm_neon.h>
+#else
+#define USE_SWAR
+#endif
+
+struct minmax_sum {
+	uint8_t min;
+	uint8_t max;
+	uint32_t sum;
+};
+
+/* Each kernel handles a multiple of its block size and returns how many
+ * bytes it consumed; the tail is left to the scalar loop. */
+#if defined(USE_SSE2)
+#define BLOCK_SIZE			16
+
+static size_t kernel(const uint8_t *p, size_t n, struct minmax_sum *acc)
+{
+	const size_t len = n - n % BLOCK_SIZE;
+	__m128i vmin = _mm_set1_epi8((char)acc->min);
+	__m128i vmax = _mm_set1_epi8((char)acc->max);
+	__m128i vsum = _mm_setzero_si128();
+
+	for (size_t i = 0; i < len; i += BLOCK_SIZE) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)&p[i]);
+		vmin = _mm_min_epu8(vmin, v);
+		vmax = _mm_max_epu8(vmax, v);
+		/* two 64-bit lanes of byte sums; cannot overflow here */
+		vsum = _mm_add_epi64(vsum,
+				_mm_sad_epu8(v, _mm_setzero_si128()));
+	}
+
+	uint8_t lanes[BLOCK_SIZE];
+	_mm_storeu_si128((__m128i *)lanes, vmin);
+	for (size_t i = 0; i < BLOCK_SIZE; i++) {
+		acc->min = lanes[i] < acc->min ? lanes[i] : acc->min;
+	}
+	_mm_storeu_si128((__m128i *)lanes, vmax);
+	for (size_t i = 0; i < BLOCK_SIZE; i++) {
+		acc->max = lanes[i] > acc->max ? lanes[i] : acc->max;
+	}
+	acc->sum += (uint32_t)_mm_cvtsi128_si32(vsum) +
+		(uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(vsum, 8));
+
+	return len;
+}
+
+static size_t delta_kernel(const uint8_t *a, const uint8_t *b, size_t n,
+		uint8_t *max)
+{
+	const size_t len = n - n % BLOCK_SIZE;
+	__m128i vmax = _mm_setzero_si128();
+
+	for (size_t i = 0; i < len; i += BLOCK_SIZE) {
+		const __m128i va = _mm_loadu_si128((const __m128i *)&a[i]);
+		const __m128i vb = _mm_loadu_si128((const __m128i *)&b[i]);
+		/* one of the two saturates to zero */
+		vmax = _mm_max_epu8(vmax, _mm_or_si128(_mm_subs_epu8(va, vb),
+					_mm_subs_epu8(vb, va)));
+	}
+
+	uint8_t lanes[BLOCK_SIZE];
+	_mm_storeu_si128((__m128i *)lanes, vmax);
+	for (size_t i = 0; i < BLOCK_SIZE; i++) {
+		*max = lanes[i] > *max ? lanes[i] : *max;
+	}
+
+	return len;
+}
+#elif defined(USE_NEON)
+#define BLOCK_SIZE			16
+#define FLUSH_BLOCKS			128 /* 16-bit lanes gain up to 510 */
+
+static size_t kernel(const uint8_t *p, size_t n, struct minmax_sum *acc)
+{
+	const size_t len = n - n % BLOCK_SIZE;
+	uint8x16_t vmin = vdupq_n_u8(acc->min);
+	uint8x16_t vmax = vdupq_n_u8(acc->max);
+	uint32x4_t vsum = vdupq_n_u32(0);
+
+	for (size_t i = 0; i < len;) {
+		uint16x8_t partial = vdupq_n_u16(0);
+
+		for (size_t k = 0; k < FLUSH_BLOCKS && i < len;
+				k++, i += BLOCK_SIZE) {
+			const uint8x16_t v = vld1q_u8(&p[i]);
+			vmin = vminq_u8(vmin, v);
+			vmax = vmaxq_u8(vmax, v);
+			partial = vpadalq_u8(partial, v);
+		}
+
+		vsum = vpadalq_u16(vsum, partial);
+	}
+
+	acc->min = vminvq_u8(vmin);
+	acc->max = vmaxvq_u8(vmax);
+	acc->sum += vaddvq_u32(vsum);
+
+	return len;
+}
+
+static size_t delta_kernel(const uint8_t *a, const uint8_t *b, size_t n,
+		uint8_t *max)
+{
+	const size_t len = n - n % BLOCK_SIZE;
+	uint8x16_t vmax = vdupq_n_u8(0);
+
+	for (size_t i = 0; i < len; i += BLOCK_SIZE) {
+		vmax = vmaxq_u8(vmax,
+				vabdq_u8(vld1q_u8(&a[i]), vld1q_u8(&b[i])));
+	}
+
+	*max = vmaxvq_u8(vmax);
+
+	return len;
+}
+#elif defined(USE_SWAR) /* eight bytes per 64-bit word */
+#define BLOCK_SIZE			8
+#define FLUSH_BLOCKS			128 /* 16-bit lanes gain up to 510 */
+#define HIGH_BITS			0x8080808080808080ull
+#define LOW_BYTES			0x00ff00ff00ff00ffull
+
+/* 0xff in each byte where x >= y, treating bytes as unsigned */
+static uint64_t ge_mask(uint64_t x, uint64_t y)
+{
+	const uint64_t low_ge = (x | HIGH_BITS) - (y & ~HIGH_BITS);
+	const uint64_t diff = x ^ y;
+	const uint64_t ge = ((diff & x) | (~diff & low_ge)) & HIGH_BITS;
+
+	return (ge >> 7) * 0xff;
+}
+
+static uint64_t sum_lanes(uint64_t lanes)
+{
+	return (lanes & 0xffff) + (lanes >> 16 & 0xffff) +
+		(lanes >> 32 & 0xffff) + (lanes >> 48);
+}
+
+static size_t kernel(const uint8_t *p, size_t n, struct minmax_sum *acc)
+{
+	const size_t len = n - n % BLOCK_SIZE;
+	uint64_t vmin = acc->min * 0x0101010101010101ull;
+	uint64_t vmax = acc->max * 0x0101010101010101ull;
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < len;) {
+		uint64_t partial = 0;
+
+		for (size_t k = 0; k < FLUSH_BLOCKS && i < len;
+				k++, i += BLOCK_SIZE) {
+			uint64_t v;
+			memcpy(&v, &p[i], sizeof(v));
+
+			const uint64_t ge_max = ge_mask(v, vmax);
+			const uint64_t ge_min = ge_mask(v, vmin);
+			vmax = (v & ge_max) | (vmax & ~ge_max);
+			vmin = (vmin & ge_min) | (v & ~ge_min);
+			partial += (v & LOW_BYTES) + (v >> 8 & LOW_BYTES);
+		}
+
+		sum += sum_lanes(partial);
+	}
+
+	for (size_t i = 0; i < BLOCK_SIZE; i++) {
+		const uint8_t lo = (uint8_t)(vmin >> (i * 8));
+		const uint8_t hi = (uint8_t)(vmax >> (i * 8));
+		acc->min = lo < acc->min ? lo : acc->min;
+		acc->max = hi > acc->max ? hi : acc->max;
+	}
+	acc->sum += (uint32_t)sum;
+
+	return len;
+}
+
+static size_t delta_kernel(const uint8_t *a, const uint8_t *b, size_t n,
+		uint8_t *max)
+{
+	const size_t len = n - n % BLOCK_SIZE;
+	uint64_t vmax = 0;
+
+	for (size_t i = 0; i < len; i += BLOCK_SIZE) {
+		uint64_t va;
+		uint64_t vb;
+		memcpy(&va, &a[i], sizeof(va));
+		memcpy(&vb, &b[i], sizeof(vb));
+
+		/* no byte of hi is below that of lo, so nothing borrows */
+		const uint64_t ge = ge_mask(va, vb);
+		const uint64_t hi = (va & ge) | (vb & ~ge);
+		const uint64_t lo = (vb & ge) | (va & ~ge);
+		const uint64_t delta = hi - lo;
+		const uint64_t ge_max = ge_mask(delta, vmax);
+		vmax = (delta & ge_max) | (vmax & ~ge_max);
+	}
+
+	for (size_t i = 0; i < BLOCK_SIZE; i++) {
+		const uint8_t lane = (uint8_t)(vmax >> (i * 8));
+		*max = lane > *max ? lane : *max;
+	}
+
+	return len;
+}
+#endif
+
+void kbvas_summarize(const uint8_t *values, size_t n,
+		struct kbvas_summary *summary)
+{
+	if (summary == NULL) {
+		return;
+	}
+
+	memset(summary, 0, sizeof(*summary));
+
+	if (values == NULL || n == 0 || n > UINT16_MAX) {
+		return;
+	}
+
+	struct minmax_sum acc = { .min = UINT8_MAX, .max = 0, .sum = 0 };
+	size_t i = kernel(values, n, &acc);
+
+	for (; i < n; i++) {
+		acc.min = values[i] < acc.min ? values[i] : acc.min;
+		acc.max = values[i] > acc.max ? values[i] : acc.max;
+		acc.sum += values[i];
+	}
+
+	/* memchr() is vectorized by most C libraries and stops early */
+	const uint8_t *min_at = (const uint8_t *)memchr(values, acc.min, n);
+	const uint8_t *max_at = (const uint8_t *)memchr(values, acc.max, n);
+
+	summary->min = acc.min;
+	summary->max = acc.max;
+	summary->spread = (uint8_t)(acc.max - acc.min);
+	summary->argmin = (uint16_t)(min_at - values);
+	summary->argmax = (uint16_t)(max_at - values);
+	summary->mean_q8 = (uint16_t)((((uint64_t)acc.sum << 8) + n / 2) / n);
+	summary->count = (uint16_t)n;
+}
+
+uint8_t kbvas_max_delta(const uint8_t *a, const uint8_t *b, size_t n)
+{
+	if (a == NULL || b == NULL) {
+		return 0;
+	}
+
+	uint8_t max = 0;
+	size_t i = delta_kernel(a, b, n, &max);
+
+	for (; i < n; i++) {
+		const uint8_t delta = (uint8_t)(a[i] > b[i] ?
+				a[i] - b[i] : b[i] - a[i]);
+		max = delta > max ? delta : max;
+	}
+
+	return max;
+}
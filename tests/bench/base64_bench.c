@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "kbvas.h"
+#include "libmcu/base64.h"
+
+#define INPUT_SIZE			1024 /* about the largest frame */
+#define ITERATIONS			200000
+#define ROUNDS				7 /* best round is reported */
+
+typedef size_t (*encoder_t)(void *buf, size_t bufsize,
+		const void *data, size_t datasize);
+
+static size_t fast_encode(void *buf, size_t bufsize,
+		const void *data, size_t datasize)
+{
+	return kbvas_base64_encode((char *)buf, bufsize, data, datasize);
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double measure(encoder_t encode, char *out, size_t outsize,
+		const uint8_t *in, size_t n)
+{
+	double best = 0;
+
+	for (int round = 0; round < ROUNDS; round++) {
+		const double start = now_sec();
+		for (int i = 0; i < ITERATIONS; i++) {
+			(*encode)(out, outsize, in, n);
+			/* keep the compiler from hoisting the call */
+			__asm__ volatile("" : : "r"(out) : "memory");
+		}
+		const double rate = (double)n * ITERATIONS /
+			(now_sec() - start) / 1e6;
+		best = rate > best ? rate : best;
+	}
+
+	return best;
+}
+
+int main(void)
+{
+	static uint8_t in[INPUT_SIZE];
+	static char expected[INPUT_SIZE / 3 * 4 + 4];
+	static char out[sizeof(expected)];
+
+	for (size_t i = 0; i < sizeof(in); i++) {
+		in[i] = (uint8_t)rand();
+	}
+
+	const size_t len = lm_base64_encode(expected, sizeof(expected),
+			in, sizeof(in));
+	if (fast_encode(out, sizeof(out), in, sizeof(in)) != len ||
+			memcmp(expected, out, len) != 0) {
+		fprintf(stderr, "output mismatch\n");
+		return 1;
+	}
+
+	printf("base64/libmcu %d bytes: %.0f MB/sec\n", INPUT_SIZE,
+			measure(lm_base64_encode, out, sizeof(out),
+					in, sizeof(in)));
+	printf("base64/kbvas %d bytes: %.0f MB/sec\n", INPUT_SIZE,
+			measure(fast_encode, out, sizeof(out),
+					in, sizeof(in)));
+
+	return 0;
+}
@@ -0,0 +1,269 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "kbvas.h"
+#include "kbvas_ring_backend.h"
+#include "kbvas_memory_backend.h"
+#include "kbvas_file_backend.h"
+#include "kbvas_pool.h"
+
+#define FRAME_MODULES			16
+#define QUEUE_DEPTH			256 /* frames queued per round */
+#define RECORD_OVERHEAD			64  /* headers and alignment, at most */
+#define ROUNDS				50  /* best round is reported */
+
+#if defined(KBVAS_USE_BASE64) && defined(KBVAS_USE_FAST_BASE64)
+#define ENCODING			"base64+fast"
+#elif defined(KBVAS_USE_BASE64)
+#define ENCODING			"base64"
+#elif defined(KBVAS_USE_SUMMARY)
+#define ENCODING			"raw+summary"
+#else
+#define ENCODING			"raw"
+#endif
+
+#define MIN(a, b)			(((a) > (b))? (b) : (a))
+
+struct bench {
+	struct kbvas *kbvas;
+	struct kbvas_backend_api *backend;
+	struct kbvas_pool *pool;
+	char path[32];
+};
+
+struct backend {
+	const char *name;
+	int (*open)(struct bench *bench, size_t capacity);
+	void (*close)(struct bench *bench);
+};
+
+struct result {
+	double enqueue_ns;     /* per frame */
+	double iterate_ns;     /* per entry visited */
+	double clear_batch_ns; /* per entry removed */
+	long peak_heap;        /* bytes, or -1 where it cannot be told */
+};
+
+static const uint16_t cell_counts[] = {
+	16, 96, KBVAS_CELL_VOLTAGE_MAX_COUNT,
+};
+
+static size_t make_frame(uint8_t *buf, uint16_t cells, uint8_t modules)
+{
+	size_t n = 0;
+
+	buf[n++] = KBVAS_TLV_TIMESTAMP; buf[n++] = 4;
+	buf[n++] = 0x66; buf[n++] = 0xbc; buf[n++] = 0x6d; buf[n++] = 0x23;
+	buf[n++] = KBVAS_TLV_VIN; buf[n++] = 17;
+	memcpy(&buf[n], "5YJZEC8E02A135025", 17); n += 17;
+	buf[n++] = KBVAS_TLV_SOC; buf[n++] = 1; buf[n++] = 0xc6;
+	buf[n++] = KBVAS_TLV_SOH; buf[n++] = 1; buf[n++] = 0x64;
+	buf[n++] = KBVAS_TLV_BPA; buf[n++] = 2; buf[n++] = 0x10; buf[n++] = 0xa1;
+	buf[n++] = KBVAS_TLV_BPV; buf[n++] = 2; buf[n++] = 0x20; buf[n++] = 0x41;
+	buf[n++] = KBVAS_TLV_BSV;
+	buf[n++] = (uint8_t)(cells >> 8); buf[n++] = (uint8_t)cells;
+	for (uint16_t i = 0; i < cells; i++) {
+		buf[n++] = (uint8_t)(0x96 + i % 3);
+	}
+	buf[n++] = KBVAS_TLV_BMT; buf[n++] = modules;
+	for (uint8_t i = 0; i < modules; i++) {
+		buf[n++] = (uint8_t)(25 + i % 4);
+	}
+
+	return n;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static long heap_in_use(void)
+{
+#if defined(__GLIBC__) && \
+		(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	return (long)mallinfo2().uordblks;
+#else
+	return -1;
+#endif
+}
+
+static int open_ring(struct bench *bench, size_t capacity)
+{
+	bench->backend = kbvas_ring_backend_create(QUEUE_DEPTH,
+			KBVAS_RING_OVERFLOW_REJECT);
+	bench->kbvas = kbvas_create(bench->backend, NULL);
+	return bench->kbvas ? 0 : -1;
+}
+
+static void close_ring(struct bench *bench)
+{
+	kbvas_destroy(bench->kbvas);
+	kbvas_ring_backend_destroy(bench->backend);
+}
+
+static int open_memory(struct bench *bench, size_t capacity)
+{
+	bench->backend = kbvas_memory_backend_create();
+	bench->kbvas = kbvas_create(bench->backend, NULL);
+	return bench->kbvas ? 0 : -1;
+}
+
+static void close_memory(struct bench *bench)
+{
+	kbvas_destroy(bench->kbvas);
+	kbvas_memory_backend_destroy(bench->backend);
+}
+
+static int open_pool(struct bench *bench, size_t capacity)
+{
+	bench->pool = kbvas_pool_create(1, capacity);
+	bench->kbvas = kbvas_pool_get(bench->pool, 0);
+	return bench->kbvas ? 0 : -1;
+}
+
+static void close_pool(struct bench *bench)
+{
+	kbvas_pool_destroy(bench->pool);
+}
+
+static int open_file(struct bench *bench, size_t capacity)
+{
+	strcpy(bench->path, "/tmp/kbvas_bench_XXXXXX");
+	const int fd = mkstemp(bench->path);
+	if (fd < 0) {
+		return -1;
+	}
+	close(fd);
+
+	bench->backend = kbvas_file_backend_create(bench->path, capacity,
+			KBVAS_FILE_SYNC_NONE);
+	bench->kbvas = kbvas_create(bench->backend, NULL);
+	return bench->kbvas ? 0 : -1;
+}
+
+static void close_file(struct bench *bench)
+{
+	kbvas_destroy(bench->kbvas);
+	kbvas_file_backend_destroy(bench->backend);
+	unlink(bench->path);
+}
+
+static const struct backend backends[] = {
+	{ "ring", open_ring, close_ring },
+	{ "memory", open_memory, close_memory },
+	{ "pool", open_pool, close_pool },
+	{ "file", open_file, close_file },
+};
+
+static bool visit(struct kbvas *self, const struct kbvas_entry *entry,
+		void *ctx)
+{
+	*(time_t *)ctx += entry->timestamp;
+	return true;
+}
+
+static int run(const struct backend *backend, const uint8_t *frame,
+		size_t framesize, struct result *result)
+{
+	struct bench bench = { 0 };
+	const long heap_base = heap_in_use();
+	time_t sum = 0;
+
+	if ((*backend->open)(&bench, QUEUE_DEPTH *
+			(framesize * 4 / 3 + RECORD_OVERHEAD)) != 0) {
+		return -1;
+	}
+
+	kbvas_set_batch_count(bench.kbvas, KBVAS_MAX_BATCH_COUNT);
+	*result = (struct result) {
+		.enqueue_ns = 1e30,
+		.iterate_ns = 1e30,
+		.clear_batch_ns = 1e30,
+		.peak_heap = heap_base < 0 ? -1 : 0,
+	};
+
+	for (int round = 0; round < ROUNDS; round++) {
+		double start = now_ns();
+		for (int i = 0; i < QUEUE_DEPTH; i++) {
+			if (kbvas_enqueue(bench.kbvas, frame, framesize)
+					!= KBVAS_ERROR_NONE) {
+				(*backend->close)(&bench);
+				return -1;
+			}
+		}
+		result->enqueue_ns = MIN(result->enqueue_ns,
+				(now_ns() - start) / QUEUE_DEPTH);
+
+		const long heap = heap_in_use() - heap_base;
+		if (heap_base >= 0 && heap > result->peak_heap) {
+			result->peak_heap = heap;
+		}
+
+		start = now_ns();
+		kbvas_iterate(bench.kbvas, visit, &sum);
+		result->iterate_ns = MIN(result->iterate_ns,
+				(now_ns() - start) / QUEUE_DEPTH);
+
+		start = now_ns();
+		while (kbvas_count(bench.kbvas)) {
+			kbvas_clear_batch(bench.kbvas);
+		}
+		result->clear_batch_ns = MIN(result->clear_batch_ns,
+				(now_ns() - start) / QUEUE_DEPTH);
+	}
+
+	(*backend->close)(&bench);
+
+	return sum ? 0 : -1;
+}
+
+/* One JSON object per line, one line per backend and cell count */
+int main(void)
+{
+	static uint8_t frame[4096];
+	int rc = 0;
+
+	for (size_t i = 0; i < sizeof(cell_counts) / sizeof(*cell_counts);
+			i++) {
+		const size_t framesize =
+			make_frame(frame, cell_counts[i], FRAME_MODULES);
+
+		for (size_t j = 0; j < sizeof(backends) / sizeof(*backends);
+				j++) {
+			struct result r;
+
+			if (run(&backends[j], frame, framesize, &r) != 0) {
+				fprintf(stderr, "%s/%s cells=%u failed\n",
+						ENCODING, backends[j].name,
+						cell_counts[i]);
+				rc = 1;
+				continue;
+			}
+
+			printf("{\"encoding\":\"%s\",\"backend\":\"%s\","
+				"\"cells\":%u,\"frame_bytes\":%zu,"
+				"\"enqueue_ns\":%.1f,\"iterate_ns\":%.1f,"
+				"\"clear_batch_ns\":%.1f,\"peak_heap\":%ld}\n",
+				ENCODING, backends[j].name, cell_counts[i],
+				framesize, r.enqueue_ns, r.iterate_ns,
+				r.clear_batch_ns, r.peak_heap);
+		}
+	}
+
+	return rc;
+}
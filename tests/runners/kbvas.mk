@@ -4,10 +4,22 @@ COMPONENT_NAME = KBVAS
 
 SRC_FILES = \
 	../kbvas.c \
+	../kbvas_base64.c \
+	../kbvas_datatransfer.c \
 	../kbvas_memory_backend.c \
+	../kbvas_ring_backend.c \
+	../kbvas_file_backend.c \
+	../kbvas_flash_backend.c \
+	../kbvas_pool.c \
 
 TEST_SRC_FILES = \
 	src/kbvas_test.cpp \
+	src/kbvas_ring_backend_test.cpp \
+	src/kbvas_datatransfer_test.cpp \
+	src/kbvas_file_backend_test.cpp \
+	src/kbvas_flash_backend_test.cpp \
+	src/fake_nor_flash.c \
+	src/kbvas_pool_test.cpp \
 	src/test_all.cpp \
 	../external/libmcu/modules/common/src/base64.c \
 	../external/libmcu/tests/stubs/logging.cpp \
@@ -0,0 +1,31 @@
+# SPDX-License-Identifier: MIT
+
+COMPONENT_NAME = KBVAS_BASE64
+
+SRC_FILES = \
+	../kbvas.c \
+	../kbvas_base64.c \
+	../kbvas_memory_backend.c \
+
+TEST_SRC_FILES = \
+	src/kbvas_base64_test.cpp \
+	src/kbvas_test.cpp \
+	src/test_all.cpp \
+	../external/libmcu/modules/common/src/base64.c \
+	../external/libmcu/tests/stubs/logging.cpp \
+
+INCLUDE_DIRS = \
+	$(CPPUTEST_HOME)/include \
+	../ \
+	../external/libmcu/modules/common/include \
+	../external/libmcu/modules/logging/include \
+
+MOCKS_SRC_DIRS =
+CPPUTEST_CPPFLAGS = -include ../external/libmcu/modules/logging/include/libmcu/logging.h \
+		    -DKBVAS_DEBUG=debug \
+		    -DKBVAS_INFO=info \
+		    -DKBVAS_ERROR=error \
+		    -DKBVAS_CELL_VOLTAGE_MAX_COUNT=960 \
+		    -DKBVAS_USE_FAST_BASE64 \
+
+include runners/MakefileRunner
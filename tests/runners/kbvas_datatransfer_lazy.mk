@@ -0,0 +1,31 @@
+# SPDX-License-Identifier: MIT
+
+COMPONENT_NAME = KBVAS_DATATRANSFER_LAZY
+
+SRC_FILES = \
+	../kbvas.c \
+	../kbvas_base64.c \
+	../kbvas_datatransfer.c \
+	../kbvas_memory_backend.c \
+	../kbvas_ring_backend.c \
+
+TEST_SRC_FILES = \
+	src/kbvas_datatransfer_test.cpp \
+	src/test_all.cpp \
+	../external/libmcu/modules/common/src/base64.c \
+	../external/libmcu/tests/stubs/logging.cpp \
+
+INCLUDE_DIRS = \
+	$(CPPUTEST_HOME)/include \
+	../ \
+	../external/libmcu/modules/common/include \
+	../external/libmcu/modules/logging/include \
+
+MOCKS_SRC_DIRS =
+CPPUTEST_CPPFLAGS = -include ../external/libmcu/modules/logging/include/libmcu/logging.h \
+		    -DKBVAS_DEBUG=debug \
+		    -DKBVAS_INFO=info \
+		    -DKBVAS_ERROR=error \
+		    -DKBVAS_USE_LAZY_BASE64 \
+
+include runners/MakefileRunner
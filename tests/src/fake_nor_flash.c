@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "fake_nor_flash.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+struct fake_nor_flash {
+	struct kbvas_flash_api api;
+	int fd;
+	size_t power; /* bytes left to program before the cut */
+	unsigned int erase_counts[];
+};
+
+static bool in_range(const struct kbvas_flash_api *self,
+		size_t offset, size_t len)
+{
+	const size_t size = self->sector_size * self->nr_sectors;
+	return offset <= size && len <= size - offset;
+}
+
+static kbvas_error_t do_read(struct kbvas_flash_api *self, size_t offset,
+		void *buf, size_t len)
+{
+	struct fake_nor_flash *flash = (struct fake_nor_flash *)self;
+
+	if (!in_range(self, offset, len) ||
+			pread(flash->fd, buf, len, (off_t)offset) != (ssize_t)len) {
+		return KBVAS_ERROR_IO;
+	}
+
+	return KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_program(struct kbvas_flash_api *self, size_t offset,
+		const void *data, size_t len)
+{
+	struct fake_nor_flash *flash = (struct fake_nor_flash *)self;
+	const uint8_t *p = (const uint8_t *)data;
+	const bool cut = len > flash->power;
+	uint8_t buf[256];
+
+	if (!in_range(self, offset, len)) {
+		return KBVAS_ERROR_IO;
+	}
+
+	if (cut) {
+		len = flash->power;
+	}
+	if (flash->power != SIZE_MAX) {
+		flash->power -= len;
+	}
+
+	for (size_t done = 0; done < len;) {
+		const size_t n = len - done < sizeof(buf) ?
+			len - done : sizeof(buf);
+
+		if (pread(flash->fd, buf, n, (off_t)(offset + done))
+				!= (ssize_t)n) {
+			return KBVAS_ERROR_IO;
+		}
+		for (size_t i = 0; i < n; i++) {
+			buf[i] &= p[done + i];
+		}
+		if (pwrite(flash->fd, buf, n, (off_t)(offset + done))
+				!= (ssize_t)n) {
+			return KBVAS_ERROR_IO;
+		}
+
+		done += n;
+	}
+
+	return cut ? KBVAS_ERROR_IO : KBVAS_ERROR_NONE;
+}
+
+static kbvas_error_t do_erase(struct kbvas_flash_api *self, size_t sector)
+{
+	struct fake_nor_flash *flash = (struct fake_nor_flash *)self;
+	uint8_t buf[256];
+
+	if (sector >= self->nr_sectors || flash->power == 0) {
+		return KBVAS_ERROR_IO;
+	}
+
+	memset(buf, 0xff, sizeof(buf));
+
+	for (size_t done = 0; done < self->sector_size;) {
+		const size_t n = self->sector_size - done < sizeof(buf) ?
+			self->sector_size - done : sizeof(buf);
+
+		if (pwrite(flash->fd, buf, n,
+				(off_t)(sector * self->sector_size + done))
+				!= (ssize_t)n) {
+			return KBVAS_ERROR_IO;
+		}
+
+		done += n;
+	}
+
+	flash->erase_counts[sector]++;
+
+	return KBVAS_ERROR_NONE;
+}
+
+struct kbvas_flash_api *fake_nor_flash_create(const char *path,
+		size_t sector_size, size_t nr_sectors)
+{
+	struct fake_nor_flash *flash;
+	struct stat st;
+
+	if (!(flash = (struct fake_nor_flash *)calloc(1, sizeof(*flash) +
+			nr_sectors * sizeof(flash->erase_counts[0])))) {
+		return NULL;
+	}
+
+	flash->api = (struct kbvas_flash_api) {
+		.read = do_read,
+		.program = do_program,
+		.erase = do_erase,
+		.sector_size = sector_size,
+		.nr_sectors = nr_sectors,
+	};
+	flash->power = SIZE_MAX;
+
+	if ((flash->fd = open(path, O_RDWR | O_CREAT, 0644)) < 0 ||
+			fstat(flash->fd, &st) != 0) {
+		fake_nor_flash_destroy(&flash->api);
+		return NULL;
+	}
+
+	if ((size_t)st.st_size != sector_size * nr_sectors) {
+		for (size_t i = 0; i < nr_sectors; i++) {
+			do_erase(&flash->api, i);
+			flash->erase_counts[i] = 0;
+		}
+	}
+
+	return &flash->api;
+}
+
+void fake_nor_flash_destroy(struct kbvas_flash_api *flash)
+{
+	if (flash) {
+		struct fake_nor_flash *self = (struct fake_nor_flash *)flash;
+		if (self->fd >= 0) {
+			close(self->fd);
+		}
+		free(self);
+	}
+}
+
+void fake_nor_flash_cut_power(struct kbvas_flash_api *flash, size_t nbytes)
+{
+	((struct fake_nor_flash *)flash)->power = nbytes;
+}
+
+unsigned int fake_nor_flash_erase_count(const struct kbvas_flash_api *flash,
+		size_t sector)
+{
+	return ((const struct fake_nor_flash *)flash)->erase_counts[sector];
+}
@@ -0,0 +1,42 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef FAKE_NOR_FLASH_H
+#define FAKE_NOR_FLASH_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "kbvas_flash_backend.h"
+
+/**
+ * @brief Creates a NOR flash simulated in a file.
+ *
+ * Programming ANDs the data into what is stored and erasing fills a sector
+ * with 0xff, as on the real part. The file is kept, so a flash created again
+ * from the same path comes back as it was left.
+ */
+struct kbvas_flash_api *fake_nor_flash_create(const char *path,
+		size_t sector_size, size_t nr_sectors);
+void fake_nor_flash_destroy(struct kbvas_flash_api *flash);
+
+/**
+ * @brief Cuts the power after @p nbytes more bytes are programmed.
+ *
+ * The program call reaching the limit stores only the bytes up to it and
+ * fails, as do all calls after it, until power is restored with SIZE_MAX.
+ */
+void fake_nor_flash_cut_power(struct kbvas_flash_api *flash, size_t nbytes);
+
+unsigned int fake_nor_flash_erase_count(const struct kbvas_flash_api *flash,
+		size_t sector);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* FAKE_NOR_FLASH_H */
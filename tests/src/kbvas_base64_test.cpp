@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <stdlib.h>
+
+#include "kbvas.h"
+#include "libmcu/base64.h"
+
+TEST_GROUP(KBVAS_BASE64) {
+	uint8_t input[1100];
+	char expected[1500];
+	char actual[1500];
+
+	void setup(void) {
+		srand(1);
+		for (size_t i = 0; i < sizeof(input); i++) {
+			input[i] = (uint8_t)rand();
+		}
+	}
+	void teardown(void) {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(KBVAS_BASE64, encode_ShouldMatchRfc4648Vectors) {
+	LONGS_EQUAL(0, kbvas_base64_encode(actual, sizeof(actual), "", 0));
+	LONGS_EQUAL(4, kbvas_base64_encode(actual, sizeof(actual), "f", 1));
+	MEMCMP_EQUAL("Zg==", actual, 4);
+	LONGS_EQUAL(4, kbvas_base64_encode(actual, sizeof(actual), "fo", 2));
+	MEMCMP_EQUAL("Zm8=", actual, 4);
+	LONGS_EQUAL(4, kbvas_base64_encode(actual, sizeof(actual), "foo", 3));
+	MEMCMP_EQUAL("Zm9v", actual, 4);
+	LONGS_EQUAL(8, kbvas_base64_encode(actual, sizeof(actual), "foobar", 6));
+	MEMCMP_EQUAL("Zm9vYmFy", actual, 8);
+}
+
+TEST(KBVAS_BASE64, encode_ShouldMatchLibmcu_ForEveryLength) {
+	for (size_t n = 0; n <= sizeof(input); n++) {
+		const size_t len = lm_base64_encode(expected, sizeof(expected),
+				input, n);
+		memset(actual, 0x55, sizeof(actual));
+
+		LONGS_EQUAL(len, kbvas_base64_encode(actual, sizeof(actual),
+				input, n));
+		MEMCMP_EQUAL(expected, actual, len);
+		/* nothing written past the text */
+		LONGS_EQUAL(0x55, actual[len]);
+	}
+}
+
+TEST(KBVAS_BASE64, encode_ShouldCoverWholeAlphabet_AtAnyAlignment) {
+	for (size_t i = 0; i < 256; i++) {
+		input[i] = (uint8_t)i;
+		input[256 + i] = (uint8_t)(255 - i);
+	}
+
+	for (size_t offset = 0; offset < 3; offset++) {
+		const size_t len = lm_base64_encode(expected, sizeof(expected),
+				&input[offset], 510);
+		LONGS_EQUAL(len, kbvas_base64_encode(actual, sizeof(actual),
+				&input[offset], 510));
+		MEMCMP_EQUAL(expected, actual, len);
+	}
+}
+
+TEST(KBVAS_BASE64, encode_ShouldWriteOnlyWholeGroupsThatFit) {
+	memset(actual, 0x55, sizeof(actual));
+
+	LONGS_EQUAL(8, kbvas_base64_encode(actual, 11, "foobar", 6));
+	MEMCMP_EQUAL("Zm9vYmFy", actual, 8);
+	memset(actual, 0x55, sizeof(actual));
+	LONGS_EQUAL(4, kbvas_base64_encode(actual, 7, "foobar", 6));
+	MEMCMP_EQUAL("Zm9v", actual, 4);
+	LONGS_EQUAL(0x55, actual[4]);
+	LONGS_EQUAL(0, kbvas_base64_encode(actual, 3, "foobar", 6));
+	LONGS_EQUAL(0, kbvas_base64_encode(NULL, 8, "foo", 3));
+}
@@ -0,0 +1,223 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <stdio.h>
+#include <string>
+
+#include "kbvas_datatransfer.h"
+#include "kbvas_memory_backend.h"
+#include "kbvas_ring_backend.h"
+#include "test_frames.h"
+#include "libmcu/base64.h"
+
+struct limited_writer {
+	std::string out;
+	size_t limit;
+	size_t calls;
+};
+
+static size_t write_limited(const void *data, size_t datasize, void *ctx) {
+	struct limited_writer *writer = (struct limited_writer *)ctx;
+	/* every third call accepts nothing, as a busy socket would */
+	const size_t n = ++writer->calls % 3 == 0 ? 0 :
+		(datasize < writer->limit ? datasize : writer->limit);
+
+	writer->out.append((const char *)data, n);
+
+	return n;
+}
+
+TEST_GROUP(KBVAS_DATATRANSFER) {
+	struct kbvas_backend_api *backend;
+	struct kbvas *kbvas;
+	std::string expected;
+
+	void setup(void) {
+		backend = kbvas_memory_backend_create();
+		kbvas = kbvas_create(backend, NULL);
+	}
+	void teardown(void) {
+		kbvas_destroy(kbvas);
+		kbvas_memory_backend_destroy(backend);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	void enqueue(struct kbvas *q, uint32_t timestamp, uint16_t ncells) {
+		uint8_t frame[512];
+		char text[700];
+		char item[64];
+		const struct test_frame f = {
+			.timestamp = timestamp,
+			.soc = 0xc6,
+			.ncells = ncells,
+		};
+		const size_t len = make_frame(frame, &f);
+		const size_t text_len = lm_base64_encode(text, sizeof(text),
+				&frame[6], len - 6);
+
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(q, frame, len));
+
+		snprintf(item, sizeof(item), "%s{\\\"timestamp\\\":%u,"
+				"\\\"value\\\":\\\"",
+				expected.empty() ? "" : ",", timestamp);
+		expected += item;
+		expected.append(text, text_len);
+		expected += "\\\"}";
+	}
+
+	std::string message(void) {
+		return "{\"vendorId\":\"kr.or.keco\",\"messageId\":\"BatteryInfo\","
+			"\"data\":\"[" + expected + "]\"}";
+	}
+
+	std::string read_all(struct kbvas_dt_cursor *cursor, size_t chunk) {
+		std::string out;
+		char buf[2048];
+		size_t len;
+
+		while (cursor->written < cursor->size) {
+			LONGS_EQUAL(KBVAS_ERROR_NONE,
+					kbvas_dt_read(cursor, buf, chunk, &len));
+			CHECK(len > 0);
+			out.append(buf, len);
+		}
+
+		return out;
+	}
+};
+
+TEST(KBVAS_DATATRANSFER, begin_ShouldReturnEmpty_WhenNothingQueued) {
+	struct kbvas_dt_cursor cursor;
+
+	LONGS_EQUAL(KBVAS_ERROR_EMPTY, kbvas_dt_begin(&cursor, kbvas, 10));
+}
+
+TEST(KBVAS_DATATRANSFER, read_ShouldProduceWholeMessage_WhenBufferIsLargeEnough) {
+	struct kbvas_dt_cursor cursor;
+
+	enqueue(kbvas, 0x66bc6d23, 96);
+	enqueue(kbvas, 0x66bc6d24, 5);
+	enqueue(kbvas, 0x66bc6d25, 1);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dt_begin(&cursor, kbvas, 10));
+	LONGS_EQUAL(3, cursor.count);
+	LONGS_EQUAL(message().size(), cursor.size);
+	STRCMP_EQUAL(message().c_str(), read_all(&cursor, 2048).c_str());
+}
+
+TEST(KBVAS_DATATRANSFER, read_ShouldResume_WhenBufferFills) {
+	struct kbvas_dt_cursor cursor;
+
+	enqueue(kbvas, 0x66bc6d23, 96);
+	enqueue(kbvas, 0x66bc6d24, 7);
+
+	for (size_t chunk = 1; chunk <= 17; chunk++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dt_begin(&cursor, kbvas, 2));
+		STRCMP_EQUAL(message().c_str(),
+				read_all(&cursor, chunk).c_str());
+	}
+}
+
+TEST(KBVAS_DATATRANSFER, begin_ShouldLimitMessageToBatchCount) {
+	struct kbvas_dt_cursor cursor;
+
+	kbvas_set_batch_count(kbvas, 2);
+	enqueue(kbvas, 0x66bc6d23, 3);
+	enqueue(kbvas, 0x66bc6d24, 4);
+	std::string first_two = message();
+	enqueue(kbvas, 0x66bc6d25, 5);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dt_begin(&cursor, kbvas, 0));
+	LONGS_EQUAL(2, cursor.count);
+	STRCMP_EQUAL(first_two.c_str(), read_all(&cursor, 64).c_str());
+
+	/* entries queued after begin are not included */
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dt_begin(&cursor, kbvas, 1));
+	enqueue(kbvas, 0x66bc6d26, 5);
+	LONGS_EQUAL(1, cursor.count);
+}
+
+TEST(KBVAS_DATATRANSFER, write_ShouldResume_WhenWriterAcceptsLess) {
+	struct kbvas_dt_cursor cursor;
+	struct limited_writer writer = { "", 5, 0 };
+
+	enqueue(kbvas, 0x66bc6d23, 96);
+	enqueue(kbvas, 0x66bc6d24, 2);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dt_begin(&cursor, kbvas, 2));
+	while (cursor.written < cursor.size) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE,
+				kbvas_dt_write(&cursor, write_limited, &writer));
+	}
+
+	STRCMP_EQUAL(message().c_str(), writer.out.c_str());
+}
+
+TEST(KBVAS_DATATRANSFER, read_ShouldReturnNoent_WhenEntriesLeaveMidway) {
+	struct kbvas_dt_cursor cursor;
+	char buf[80]; /* past the header */
+	size_t len;
+
+	enqueue(kbvas, 0x66bc6d23, 3);
+	enqueue(kbvas, 0x66bc6d24, 3);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dt_begin(&cursor, kbvas, 2));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dt_read(&cursor, buf, sizeof(buf), &len));
+	kbvas_clear(kbvas);
+	LONGS_EQUAL(KBVAS_ERROR_NOENT,
+			kbvas_dt_read(&cursor, buf, sizeof(buf), &len));
+}
+
+TEST(KBVAS_DATATRANSFER, read_ShouldSerializeEntryBackends) {
+	struct kbvas_backend_api *ring = kbvas_ring_backend_create(4,
+			KBVAS_RING_OVERFLOW_REJECT);
+	struct kbvas *q = kbvas_create(ring, NULL);
+	struct kbvas_dt_cursor cursor;
+
+	enqueue(q, 0x66bc6d23, 96);
+	enqueue(q, 0x66bc6d24, 1);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dt_begin(&cursor, q, 4));
+	LONGS_EQUAL(message().size(), cursor.size);
+	STRCMP_EQUAL(message().c_str(), read_all(&cursor, 13).c_str());
+
+	kbvas_destroy(q);
+	kbvas_ring_backend_destroy(ring);
+}
+
+TEST(KBVAS_DATATRANSFER, beginBatch_ShouldSerializeCheckedOutBatch) {
+	struct kbvas_dt_cursor cursor;
+	kbvas_batch_id_t first, second;
+	char buf[80];
+	size_t len;
+
+	enqueue(kbvas, 0x66bc6d23, 3);
+	expected.clear();
+	enqueue(kbvas, 0x66bc6d24, 4);
+	enqueue(kbvas, 0x66bc6d25, 5);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_checkout_batch(kbvas, 1, &first));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_checkout_batch(kbvas, 2, &second));
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_dt_begin_batch(&cursor, kbvas, second));
+	LONGS_EQUAL(2, cursor.count);
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_dt_read(&cursor, buf, sizeof(buf), &len));
+
+	/* the batch ahead of it leaves while the message is written */
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_ack_batch(kbvas, first));
+	STRCMP_EQUAL(message().c_str(),
+			(std::string(buf, len) + read_all(&cursor, 64)).c_str());
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_nack_batch(kbvas, second));
+	LONGS_EQUAL(KBVAS_ERROR_NOENT,
+			kbvas_dt_begin_batch(&cursor, kbvas, second));
+}
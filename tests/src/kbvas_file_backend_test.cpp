@@ -0,0 +1,177 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "kbvas.h"
+#include "kbvas_file_backend.h"
+#include "test_frames.h"
+
+#define CAPACITY		240 /* ten records of a SOC frame */
+#define HEADER_SIZE		32
+
+TEST_GROUP(KBVAS_FILE) {
+	char path[32];
+	struct kbvas *kbvas;
+	struct kbvas_backend_api *backend;
+
+	void setup(void) {
+		strcpy(path, "/tmp/kbvas_file_XXXXXX");
+		close(mkstemp(path));
+		open_queue(CAPACITY);
+	}
+	void teardown(void) {
+		close_queue();
+		unlink(path);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	void open_queue(size_t capacity) {
+		backend = kbvas_file_backend_create(path, capacity,
+				KBVAS_FILE_SYNC_NONE);
+		kbvas = kbvas_create(backend, NULL);
+	}
+	void close_queue(void) {
+		kbvas_destroy(kbvas);
+		kbvas_file_backend_destroy(backend);
+	}
+	void reopen(size_t capacity) {
+		close_queue();
+		open_queue(capacity);
+	}
+	void check_timestamps(const time_t *expected, size_t n) {
+		time_t actual[16];
+		time_t *p = actual;
+
+		LONGS_EQUAL(n, kbvas_count(kbvas));
+		kbvas_iterate_records(kbvas, collect_timestamps, &p);
+		LONGS_EQUAL(n, p - actual);
+		for (size_t i = 0; i < n; i++) {
+			LONGS_EQUAL(expected[i], actual[i]);
+		}
+	}
+};
+
+TEST(KBVAS_FILE, create_ShouldReturnNull_WhenCapacityTooSmall) {
+	POINTERS_EQUAL(NULL, kbvas_file_backend_create(path, 8,
+			KBVAS_FILE_SYNC_NONE));
+	POINTERS_EQUAL(NULL, kbvas_file_backend_create(NULL, CAPACITY,
+			KBVAS_FILE_SYNC_NONE));
+}
+
+TEST(KBVAS_FILE, enqueue_ShouldSurviveReopen) {
+	const time_t expected[] = { 1, 2, 3 };
+	struct kbvas_entry entry;
+
+	enqueue_at(kbvas, 1);
+	enqueue_at(kbvas, 2);
+	enqueue_at(kbvas, 3);
+
+	reopen(CAPACITY);
+
+	check_timestamps(expected, 3);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, -1, &entry));
+	LONGS_EQUAL(3, entry.timestamp);
+#if defined(KBVAS_USE_BASE64)
+	STRCMP_EQUAL("owEQ", entry.base64_encoded);
+#endif
+}
+
+TEST(KBVAS_FILE, clearBatch_ShouldSurviveReopen) {
+	const time_t expected[] = { 3 };
+
+	enqueue_at(kbvas, 1);
+	enqueue_at(kbvas, 2);
+	enqueue_at(kbvas, 3);
+	kbvas_set_batch_count(kbvas, 2);
+	kbvas_clear_batch(kbvas);
+
+	reopen(CAPACITY);
+
+	check_timestamps(expected, 1);
+}
+
+TEST(KBVAS_FILE, enqueue_ShouldFail_WhenSegmentFull) {
+	for (uint8_t i = 1; i <= 10; i++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(kbvas, i));
+	}
+
+	LONGS_EQUAL(KBVAS_ERROR_NOSPC, enqueue_at(kbvas, 11));
+	LONGS_EQUAL(10, kbvas_count(kbvas));
+}
+
+TEST(KBVAS_FILE, enqueue_ShouldWrapAround_WhenHeadFreed) {
+	const time_t expected[] = { 7, 8, 9, 10, 11, 12, 13, 14 };
+
+	for (uint8_t i = 1; i <= 9; i++) {
+		enqueue_at(kbvas, i);
+	}
+	kbvas_set_batch_count(kbvas, 6);
+	kbvas_clear_batch(kbvas);
+
+	for (uint8_t i = 10; i <= 14; i++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(kbvas, i));
+	}
+	check_timestamps(expected, 8);
+
+	reopen(CAPACITY);
+	check_timestamps(expected, 8);
+}
+
+TEST(KBVAS_FILE, reopen_ShouldStartEmpty_WhenCapacityDiffers) {
+	enqueue_at(kbvas, 1);
+
+	reopen(CAPACITY * 2);
+
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(kbvas, 2));
+}
+
+TEST(KBVAS_FILE, reopen_ShouldFallBackToOlderHeader_WhenNewestTorn) {
+	const time_t expected[] = { 1 };
+	uint8_t headers[HEADER_SIZE * 2];
+	uint32_t seq[2];
+
+	enqueue_at(kbvas, 1);
+	enqueue_at(kbvas, 2);
+	close_queue();
+
+	FILE *f = fopen(path, "r+b");
+	LONGS_EQUAL(sizeof(headers), fread(headers, 1, sizeof(headers), f));
+	memcpy(&seq[0], &headers[8], sizeof(seq[0]));
+	memcpy(&seq[1], &headers[HEADER_SIZE + 8], sizeof(seq[1]));
+	headers[(seq[1] > seq[0] ? HEADER_SIZE : 0) + 16] ^= 0xff;
+	fseek(f, 0, SEEK_SET);
+	fwrite(headers, 1, sizeof(headers), f);
+	fclose(f);
+
+	open_queue(CAPACITY);
+	check_timestamps(expected, 1);
+}
+
+TEST(KBVAS_FILE, stream_ShouldStoreFrameInPlace) {
+	const time_t expected[] = { 1, 7 };
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+
+	enqueue_at(kbvas, 1);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_stream_begin(stream, SOC_FRAME_SIZE));
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_stream_feed(stream, SOC_FRAME("\x07"), 4));
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_stream_feed(stream, &SOC_FRAME("\x07")[4], 5));
+	kbvas_stream_destroy(stream);
+
+	reopen(CAPACITY);
+	check_timestamps(expected, 2);
+}
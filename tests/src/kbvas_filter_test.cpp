@@ -0,0 +1,192 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <string.h>
+
+#include "kbvas.h"
+#include "kbvas_memory_backend.h"
+#include "kbvas_ring_backend.h"
+#include "test_frames.h"
+
+#define NR_CELLS		40
+#define NR_MODULES		4
+
+TEST_GROUP(KBVAS_FILTER) {
+	struct kbvas *kbvas;
+	struct kbvas_backend_api *backend;
+	struct kbvas_change_filter filter;
+	struct test_frame f;
+	uint8_t cells[NR_CELLS];
+	uint8_t modules[NR_MODULES];
+
+	void setup(void) {
+		backend = kbvas_memory_backend_create();
+		kbvas = kbvas_create(backend, NULL);
+
+		filter = (struct kbvas_change_filter) {
+			.soc = 1,
+			.soh = 0,
+			.bpa = 0,
+			.bpv = 10,
+			.bsv = 2,
+			.bmt = 1,
+			.max_interval = 0,
+		};
+		f = (struct test_frame) {
+			.timestamp = 1,
+			.vin = "5YJZEC8E02A135025",
+			.soc = 100,
+			.bpv = 4000,
+			.cells = cells,
+			.ncells = NR_CELLS,
+			.modules = modules,
+			.nmodules = NR_MODULES,
+		};
+		memset(cells, 0x96, sizeof(cells));
+		memset(modules, 25, sizeof(modules));
+	}
+	void teardown(void) {
+		kbvas_destroy(kbvas);
+		kbvas_memory_backend_destroy(backend);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	kbvas_error_t enqueue_next(void) {
+		uint8_t buf[128];
+		const size_t n = make_frame(buf, &f);
+		f.timestamp++;
+		return kbvas_enqueue(kbvas, buf, n);
+	}
+};
+
+TEST(KBVAS_FILTER, setChangeFilter_ShouldReturnMissingParam_WhenNullGiven) {
+	LONGS_EQUAL(KBVAS_ERROR_MISSING_PARAM,
+			kbvas_set_change_filter(NULL, &filter));
+}
+
+TEST(KBVAS_FILTER, enqueue_ShouldStoreEveryFrame_WhenNoFilterSet) {
+	enqueue_next();
+	enqueue_next();
+
+	LONGS_EQUAL(2, kbvas_count(kbvas));
+	LONGS_EQUAL(0, kbvas_count_filtered(kbvas));
+}
+
+TEST(KBVAS_FILTER, enqueue_ShouldDropFrame_WhenChangesWithinThresholds) {
+	kbvas_set_change_filter(kbvas, &filter);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_next());
+	f.soc += 1;
+	f.bpv += 10;
+	cells[NR_CELLS - 1] += 2;
+	modules[0] += 1;
+	LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_next());
+
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+	LONGS_EQUAL(1, kbvas_count_filtered(kbvas));
+}
+
+TEST(KBVAS_FILTER, enqueue_ShouldStoreFrame_WhenAnyCellMovesBeyondThreshold) {
+	kbvas_set_change_filter(kbvas, &filter);
+
+	enqueue_next();
+	cells[33] -= 3;
+	enqueue_next();
+
+	LONGS_EQUAL(2, kbvas_count(kbvas));
+}
+
+TEST(KBVAS_FILTER, enqueue_ShouldCompareWithLastStored_NotLastGiven) {
+	kbvas_set_change_filter(kbvas, &filter);
+
+	enqueue_next();
+	f.bpv += 6;
+	enqueue_next(); /* dropped */
+	f.bpv += 6;
+	enqueue_next(); /* 12 off the stored one */
+
+	LONGS_EQUAL(2, kbvas_count(kbvas));
+	LONGS_EQUAL(1, kbvas_count_filtered(kbvas));
+}
+
+TEST(KBVAS_FILTER, enqueue_ShouldStoreFrame_WhenMaxIntervalPassed) {
+	filter.max_interval = 3;
+	kbvas_set_change_filter(kbvas, &filter);
+
+	for (int i = 0; i < 7; i++) {
+		enqueue_next();
+	}
+
+	/* timestamps 1, 4 and 7 */
+	LONGS_EQUAL(3, kbvas_count(kbvas));
+	LONGS_EQUAL(4, kbvas_count_filtered(kbvas));
+}
+
+TEST(KBVAS_FILTER, enqueue_ShouldStoreFrame_WhenFilterSetAgain) {
+	kbvas_set_change_filter(kbvas, &filter);
+	enqueue_next();
+	kbvas_set_change_filter(kbvas, &filter);
+	enqueue_next();
+	kbvas_set_change_filter(kbvas, NULL);
+	enqueue_next();
+
+	LONGS_EQUAL(3, kbvas_count(kbvas));
+}
+
+TEST(KBVAS_FILTER, enqueue_ShouldNotKeepFrame_WhenRejected) {
+	uint8_t buf[128];
+	const size_t n = make_frame(buf, &f);
+
+	kbvas_set_change_filter(kbvas, &filter);
+	kbvas_enqueue(kbvas, buf, n - 1); /* truncated */
+	kbvas_enqueue(kbvas, buf, n);
+
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+	LONGS_EQUAL(0, kbvas_count_filtered(kbvas));
+}
+
+TEST(KBVAS_FILTER, stream_ShouldDropFrame_WhenChangesWithinThresholds) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+	uint8_t buf[128];
+
+	kbvas_set_change_filter(kbvas, &filter);
+	enqueue_next();
+
+	const size_t n = make_frame(buf, &f);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_begin(stream, n));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_feed(stream, buf, 10));
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_stream_feed(stream, &buf[10], n - 10));
+	kbvas_stream_destroy(stream);
+
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+	LONGS_EQUAL(1, kbvas_count_filtered(kbvas));
+}
+
+TEST(KBVAS_FILTER, enqueue_ShouldCompareWithLastStored_WhenParsedInPlace) {
+	struct kbvas_backend_api *ring = kbvas_ring_backend_create(4,
+			KBVAS_RING_OVERFLOW_OVERWRITE);
+	struct kbvas *q = kbvas_create(ring, NULL);
+	uint8_t buf[128];
+
+	kbvas_set_change_filter(q, &filter);
+	for (int i = 0; i < 8; i++) {
+		f.bpv += 6; /* stored every other frame */
+		kbvas_enqueue(q, buf, make_frame(buf, &f));
+		f.timestamp++;
+	}
+
+	LONGS_EQUAL(4, kbvas_count(q));
+	LONGS_EQUAL(4, kbvas_count_filtered(q));
+
+	kbvas_destroy(q);
+	kbvas_ring_backend_destroy(ring);
+}
@@ -0,0 +1,242 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "kbvas.h"
+#include "kbvas_flash_backend.h"
+#include "fake_nor_flash.h"
+#include "test_frames.h"
+
+#define SECTOR_SIZE		256 /* seven records of a SOC frame */
+#define NR_SECTORS		4
+#define PER_SECTOR		7
+
+TEST_GROUP(KBVAS_FLASH) {
+	char path[32];
+	struct kbvas_flash_api *flash;
+	struct kbvas *kbvas;
+	struct kbvas_backend_api *backend;
+
+	void setup(void) {
+		strcpy(path, "/tmp/kbvas_nor_XXXXXX");
+		close(mkstemp(path));
+		flash = fake_nor_flash_create(path, SECTOR_SIZE, NR_SECTORS);
+		open_queue();
+	}
+	void teardown(void) {
+		close_queue();
+		fake_nor_flash_destroy(flash);
+		unlink(path);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	void open_queue(void) {
+		backend = kbvas_flash_backend_create(flash);
+		kbvas = kbvas_create(backend, NULL);
+	}
+	void close_queue(void) {
+		kbvas_destroy(kbvas);
+		kbvas_flash_backend_destroy(backend);
+	}
+	void recreate(size_t sector_size, size_t nr_sectors) {
+		close_queue();
+		fake_nor_flash_destroy(flash);
+		flash = fake_nor_flash_create(path, sector_size, nr_sectors);
+		open_queue();
+	}
+	void reboot(void) {
+		close_queue();
+		fake_nor_flash_cut_power(flash, SIZE_MAX);
+		open_queue();
+	}
+	unsigned int total_erases(void) {
+		unsigned int total = 0;
+		for (size_t i = 0; i < NR_SECTORS; i++) {
+			total += fake_nor_flash_erase_count(flash, i);
+		}
+		return total;
+	}
+	void check_timestamps(time_t first, size_t n) {
+		time_t actual[NR_SECTORS * PER_SECTOR];
+		time_t *p = actual;
+
+		LONGS_EQUAL(n, kbvas_count(kbvas));
+		kbvas_iterate_records(kbvas, collect_timestamps, &p);
+		LONGS_EQUAL(n, p - actual);
+		for (size_t i = 0; i < n; i++) {
+			LONGS_EQUAL(first + (time_t)i, actual[i]);
+		}
+	}
+};
+
+TEST(KBVAS_FLASH, create_ShouldReturnNull_WhenTooFewSectors) {
+	struct kbvas_flash_api one = *flash;
+	one.nr_sectors = 1;
+
+	POINTERS_EQUAL(NULL, kbvas_flash_backend_create(&one));
+	POINTERS_EQUAL(NULL, kbvas_flash_backend_create(NULL));
+}
+
+TEST(KBVAS_FLASH, enqueue_ShouldSurviveReboot) {
+	struct kbvas_entry entry;
+
+	for (uint8_t i = 1; i <= 10; i++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(kbvas, i));
+	}
+
+	reboot();
+
+	check_timestamps(1, 10);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, -1, &entry));
+	LONGS_EQUAL(10, entry.timestamp);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(kbvas, 11));
+	check_timestamps(1, 11);
+}
+
+TEST(KBVAS_FLASH, clearBatch_ShouldSurviveReboot) {
+	for (uint8_t i = 1; i <= 10; i++) {
+		enqueue_at(kbvas, i);
+	}
+	kbvas_set_batch_count(kbvas, 8);
+	kbvas_clear_batch(kbvas);
+
+	reboot();
+
+	check_timestamps(9, 2);
+}
+
+TEST(KBVAS_FLASH, enqueue_ShouldFail_WhenAllSectorsHoldQueuedRecords) {
+	for (uint8_t i = 1; i <= NR_SECTORS * PER_SECTOR; i++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(kbvas, i));
+	}
+
+	LONGS_EQUAL(KBVAS_ERROR_NOSPC, enqueue_at(kbvas, 0xff));
+
+	kbvas_set_batch_count(kbvas, PER_SECTOR);
+	kbvas_clear_batch(kbvas);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(kbvas, 0xff));
+}
+
+TEST(KBVAS_FLASH, enqueue_ShouldNotErase_WhenDrainedSectorsErasedAhead) {
+	for (uint8_t i = 1; i <= PER_SECTOR * 3; i++) {
+		enqueue_at(kbvas, i);
+	}
+	kbvas_clear(kbvas);
+
+	const unsigned int erases = total_erases();
+
+	for (uint8_t i = 1; i <= PER_SECTOR * 3; i++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(kbvas, i));
+	}
+
+	LONGS_EQUAL(erases, total_erases());
+}
+
+TEST(KBVAS_FLASH, sectors_ShouldWearEvenly) {
+	kbvas_set_batch_count(kbvas, 5);
+
+	for (int round = 0; round < 200; round++) {
+		for (int i = 0; i < 5; i++) {
+			LONGS_EQUAL(KBVAS_ERROR_NONE,
+					enqueue_at(kbvas, (uint8_t)i));
+		}
+		kbvas_clear_batch(kbvas);
+	}
+
+	unsigned int min = UINT32_MAX;
+	unsigned int max = 0;
+	for (size_t i = 0; i < NR_SECTORS; i++) {
+		const unsigned int n = fake_nor_flash_erase_count(flash, i);
+		min = n < min ? n : min;
+		max = n > max ? n : max;
+	}
+
+	CHECK(min > 30);
+	CHECK(max - min <= 1);
+}
+
+TEST(KBVAS_FLASH, reboot_ShouldDropTornRecord_WhenPowerCutMidPush) {
+	for (uint8_t i = 1; i <= 3; i++) {
+		enqueue_at(kbvas, i);
+	}
+
+	fake_nor_flash_cut_power(flash, 20);
+	LONGS_EQUAL(KBVAS_ERROR_IO, enqueue_at(kbvas, 4));
+
+	reboot();
+
+	check_timestamps(1, 3);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(kbvas, 4));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(kbvas, 5));
+
+	reboot();
+
+	check_timestamps(1, 5);
+}
+
+TEST(KBVAS_FLASH, reboot_ShouldSealSector_WhenTornLengthRunsPastFlash) {
+	/* 129 cells encode to 176 bytes, a record of 200 with its header */
+	const size_t per_sector = (65536 - 16) / 200;
+	const struct test_frame f = { .timestamp = 1, .ncells = 129 };
+	struct kbvas_record record;
+	uint8_t frame[160];
+	const size_t len = make_frame(frame, &f);
+
+	recreate(65536, 2);
+	for (size_t i = 0; i <= per_sector; i++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, frame, len));
+	}
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, 0, &record));
+	LONGS_EQUAL(176, record.len);
+
+	/* the seq and the low byte of the length, leaving 0xffb0 */
+	fake_nor_flash_cut_power(flash, 5);
+	LONGS_EQUAL(KBVAS_ERROR_IO, kbvas_enqueue(kbvas, frame, len));
+
+	reboot();
+
+	CHECK(backend != NULL);
+	LONGS_EQUAL(per_sector + 1, kbvas_count(kbvas));
+}
+
+TEST(KBVAS_FLASH, reboot_ShouldKeepUndroppedRecords_WhenPowerCutMidDrop) {
+	for (uint8_t i = 1; i <= 10; i++) {
+		enqueue_at(kbvas, i);
+	}
+
+	/* each drop programs one word */
+	fake_nor_flash_cut_power(flash, 3 * sizeof(uint32_t));
+	kbvas_set_batch_count(kbvas, 6);
+	kbvas_clear_batch(kbvas);
+
+	reboot();
+
+	check_timestamps(4, 7);
+}
+
+TEST(KBVAS_FLASH, stream_ShouldStoreFrame) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+
+	enqueue_at(kbvas, 1);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_stream_begin(stream, SOC_FRAME_SIZE));
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_stream_feed(stream, SOC_FRAME("\x02"), 4));
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_stream_feed(stream, &SOC_FRAME("\x02")[4], 5));
+	kbvas_stream_destroy(stream);
+
+	reboot();
+
+	check_timestamps(1, 2);
+}
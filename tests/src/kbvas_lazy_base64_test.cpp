@@ -0,0 +1,135 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include "kbvas.h"
+#include "kbvas_memory_backend.h"
+#include "kbvas_ring_backend.h"
+#include "test_frames.h"
+
+TEST_GROUP(KBVAS_LAZY_BASE64) {
+	struct kbvas_backend_api *backend;
+	struct kbvas_backend_api *reference_backend;
+	struct kbvas *kbvas;
+	struct kbvas *reference;
+	uint8_t frame[512];
+	size_t framesize;
+	struct test_frame f;
+
+	void setup(void) {
+		backend = kbvas_memory_backend_create();
+		kbvas = kbvas_create(backend, NULL);
+		/* entry backends have nowhere to keep the frame, so they still
+		 * encode on enqueue */
+		reference_backend = kbvas_ring_backend_create(4,
+				KBVAS_RING_OVERFLOW_REJECT);
+		reference = kbvas_create(reference_backend, NULL);
+
+		f = (struct test_frame) {
+			.timestamp = 0x66bc6d23,
+			.vin = "5YJZEC8E02A135025",
+			.soc = 0xc6,
+			.ncells = 100,
+		};
+		framesize = make_frame(frame, &f);
+	}
+	void teardown(void) {
+		kbvas_destroy(kbvas);
+		kbvas_memory_backend_destroy(backend);
+		kbvas_destroy(reference);
+		kbvas_ring_backend_destroy(reference_backend);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	void check_entry(int index, const uint8_t *data, size_t datasize) {
+		struct kbvas_entry expected;
+		struct kbvas_entry entry;
+
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(reference, data, datasize));
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(reference, &expected));
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, index, &entry));
+		MEMCMP_EQUAL(&expected, &entry, sizeof(entry));
+	}
+};
+
+TEST(KBVAS_LAZY_BASE64, enqueue_ShouldStoreFrameAsReceived) {
+	struct kbvas_record record;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, frame, framesize));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, 0, &record));
+	LONGS_EQUAL(0x66bc6d23, record.timestamp);
+	LONGS_EQUAL(framesize, record.len);
+	MEMCMP_EQUAL(frame, record.data, framesize);
+}
+
+TEST(KBVAS_LAZY_BASE64, peek_ShouldEncodeSameTextAsEagerEncoding) {
+	kbvas_enqueue(kbvas, frame, framesize);
+	check_entry(0, frame, framesize);
+}
+
+TEST(KBVAS_LAZY_BASE64, dequeue_ShouldEncodeOldestEntry) {
+	uint8_t frame2[512];
+	f.timestamp++;
+	f.ncells = 3;
+	const size_t framesize2 = make_frame(frame2, &f);
+	struct kbvas_entry entry;
+
+	kbvas_enqueue(kbvas, frame, framesize);
+	kbvas_enqueue(kbvas, frame2, framesize2);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(kbvas, &entry));
+	LONGS_EQUAL(0x66bc6d23, entry.timestamp);
+	check_entry(0, frame2, framesize2);
+}
+
+TEST(KBVAS_LAZY_BASE64, stream_ShouldStoreSameRecordAsEnqueue) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+	struct kbvas_record record;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_begin(stream, framesize));
+	for (size_t i = 0; i < framesize; i += 7) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_feed(stream, &frame[i],
+				framesize - i < 7 ? framesize - i : 7));
+	}
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, 0, &record));
+	LONGS_EQUAL(framesize, record.len);
+	MEMCMP_EQUAL(frame, record.data, framesize);
+	check_entry(0, frame, framesize);
+
+	kbvas_stream_destroy(stream);
+}
+
+TEST(KBVAS_LAZY_BASE64, encodeRecord_ShouldWriteEntryTextIntoCallerBuffer) {
+	struct kbvas_record record;
+	struct kbvas_entry entry;
+	char buf[sizeof(entry.base64_encoded)];
+	size_t len;
+
+	kbvas_enqueue(kbvas, frame, framesize);
+	kbvas_peek(kbvas, 0, &entry);
+	kbvas_peek_record(kbvas, 0, &record);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_encode_record(&record, buf, sizeof(buf), &len));
+	LONGS_EQUAL(strlen(entry.base64_encoded), len);
+	MEMCMP_EQUAL(entry.base64_encoded, buf, len);
+
+	LONGS_EQUAL(KBVAS_ERROR_NOSPC,
+			kbvas_encode_record(&record, buf, len - 1, &len));
+}
+
+TEST(KBVAS_LAZY_BASE64, enqueue_ShouldStillRejectMalformedFrames) {
+	frame[7] = 0xff; /* VIN length beyond the frame */
+
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT,
+			kbvas_enqueue(kbvas, frame, framesize));
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+}
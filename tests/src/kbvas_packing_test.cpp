@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include "kbvas.h"
+#include "kbvas_memory_backend.h"
+#include "kbvas_ring_backend.h"
+#include "test_frames.h"
+
+TEST_GROUP(KBVAS_PACKING) {
+	struct kbvas_backend_api *backend;
+	struct kbvas_backend_api *reference_backend;
+	struct kbvas *kbvas;
+	struct kbvas *reference;
+	uint8_t cells[KBVAS_CELL_VOLTAGE_MAX_COUNT];
+	uint8_t modules[KBVAS_MODULE_TEMPERATURE_MAX_COUNT];
+	uint8_t frame[512];
+	struct test_frame f;
+
+	void setup(void) {
+		backend = kbvas_memory_backend_create();
+		kbvas = kbvas_create(backend, NULL);
+		reference_backend = kbvas_ring_backend_create(4,
+				KBVAS_RING_OVERFLOW_REJECT);
+		reference = kbvas_create(reference_backend, NULL);
+
+		for (size_t i = 0; i < sizeof(cells); i++) {
+			cells[i] = (uint8_t)(0xc0 + (i * 7) % 5);
+		}
+		for (size_t i = 0; i < sizeof(modules); i++) {
+			modules[i] = (uint8_t)(25 + i % 3);
+		}
+		f = (struct test_frame) {
+			.timestamp = 0x66bc6d23,
+			.soc = 0xc6,
+			.cells = cells,
+			.ncells = 96,
+			.modules = modules,
+			.nmodules = 16,
+		};
+	}
+	void teardown(void) {
+		kbvas_destroy(kbvas);
+		kbvas_memory_backend_destroy(backend);
+		kbvas_destroy(reference);
+		kbvas_ring_backend_destroy(reference_backend);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	void check_round_trip(size_t framesize) {
+		struct kbvas_entry expected;
+		struct kbvas_entry entry;
+
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(reference, frame, framesize));
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(reference, &expected));
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, -1, &entry));
+		MEMCMP_EQUAL(&expected, &entry, sizeof(entry));
+	}
+};
+
+TEST(KBVAS_PACKING, enqueue_ShouldStoreUniformCellsInFewBytes) {
+	struct kbvas_record record;
+
+	memset(cells, 0x96, sizeof(cells));
+	memset(modules, 25, sizeof(modules));
+	const size_t len = make_frame(frame, &f);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, frame, len));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, 0, &record));
+	/* timestamp, SoC and two bare packed headers */
+	LONGS_EQUAL(6 + 3 + 7 + 7, record.len);
+	check_round_trip(len);
+}
+
+TEST(KBVAS_PACKING, enqueue_ShouldPackDeltasAndRestoreThemOnPeek) {
+	struct kbvas_record record;
+	const size_t len = make_frame(frame, &f);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, frame, len));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, 0, &record));
+	/* 3 bits per cell, 2 bits per module */
+	LONGS_EQUAL(6 + 3 + (7 + 36) + (7 + 4), record.len);
+	check_round_trip(len);
+}
+
+TEST(KBVAS_PACKING, enqueue_ShouldKeepFrameAsIs_WhenPackingDoesNotPay) {
+	struct kbvas_record record;
+
+	for (size_t i = 0; i < sizeof(cells); i++) {
+		cells[i] = (uint8_t)(i * 37);
+	}
+	modules[0] = 0;
+	modules[1] = 0xff;
+	f.nmodules = 2;
+	const size_t len = make_frame(frame, &f);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, frame, len));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, 0, &record));
+	LONGS_EQUAL(len, record.len);
+	MEMCMP_EQUAL(frame, record.data, len);
+	check_round_trip(len);
+}
+
+TEST(KBVAS_PACKING, stream_ShouldStoreSameRecordAsEnqueue) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+	struct kbvas_record expected;
+	struct kbvas_record record;
+	const size_t len = make_frame(frame, &f);
+
+	kbvas_enqueue(kbvas, frame, len);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_begin(stream, len));
+	for (size_t i = 0; i < len; i += 5) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_feed(stream, &frame[i],
+				len - i < 5 ? len - i : 5));
+	}
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, 0, &expected));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, 1, &record));
+	LONGS_EQUAL(expected.len, record.len);
+	MEMCMP_EQUAL(expected.data, record.data, record.len);
+	check_round_trip(len);
+
+	kbvas_stream_destroy(stream);
+}
+
+TEST(KBVAS_PACKING, tlvNext_ShouldSeePackedTagsInRecord) {
+	struct kbvas_tlv_cursor cursor;
+	struct kbvas_record record;
+	struct kbvas_tlv tlv;
+	const size_t len = make_frame(frame, &f);
+
+	kbvas_enqueue(kbvas, frame, len);
+	kbvas_peek_record(kbvas, 0, &record);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_find(record.data, record.len,
+			KBVAS_TLV_PACKED_BSV, &tlv));
+	LONGS_EQUAL(96, (tlv.value[0] << 8) | tlv.value[1]);
+	LONGS_EQUAL(0xc0, tlv.value[2]);
+	LONGS_EQUAL(3, tlv.value[3]);
+
+	kbvas_tlv_cursor_init(&cursor, record.data, record.len);
+	while (kbvas_tlv_next(&cursor, &tlv) == KBVAS_ERROR_NONE) {
+		CHECK(tlv.type != KBVAS_TLV_BSV && tlv.type != KBVAS_TLV_BMT);
+	}
+	LONGS_EQUAL(record.len, cursor.offset);
+}
+
+TEST(KBVAS_PACKING, enqueue_ShouldRejectPackedTagsInIncomingFrames) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+	const uint8_t packed[] = {
+		0xA1, 0x04, 0x00, 0x00, 0x00, 0x01,
+		0xE7, 0x00, 0x04, 0x00, 0x02, 0x96, 0x00,
+	};
+
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, kbvas_enqueue(kbvas, packed, sizeof(packed)));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_begin(stream, sizeof(packed)));
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, kbvas_stream_feed(stream, packed, sizeof(packed)));
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+
+	kbvas_stream_destroy(stream);
+}
+
+TEST(KBVAS_PACKING, decodeRecord_ShouldRejectMalformedPackedTags) {
+	uint8_t data[] = {
+		0xA1, 0x04, 0x00, 0x00, 0x00, 0x01,
+		0xE7, 0x00, 0x05, 0x00, 0x02, 0x96, 0x09, 0x00,
+	};
+	const struct kbvas_record record = { 1, sizeof(data), data };
+	struct kbvas_entry entry;
+
+	/* width beyond 7 bits */
+	CHECK(KBVAS_ERROR_NONE != kbvas_decode_record(&record, &entry));
+	/* length not matching count and width */
+	data[10] = 20;
+	data[12] = 1;
+	CHECK(KBVAS_ERROR_NONE != kbvas_decode_record(&record, &entry));
+	/* two cells of one bit fit in the single data byte */
+	data[10] = 2;
+	data[13] = 0x02;
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_decode_record(&record, &entry));
+	LONGS_EQUAL(2, entry.data.bsv_count);
+	LONGS_EQUAL(0x96, entry.data.bsv[0]);
+	LONGS_EQUAL(0x97, entry.data.bsv[1]);
+}
@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <stdlib.h>
+#include "kbvas.h"
+#include "kbvas_pool.h"
+#include "test_frames.h"
+
+static bool on_drain(struct kbvas_pool *pool, size_t connector,
+		struct kbvas *kbvas, void *ctx)
+{
+	return mock().actualCall(__func__)
+		.withUnsignedIntParameter("connector", (unsigned int)connector)
+		.returnBoolValueOrDefault(true);
+}
+
+static bool check_order(struct kbvas *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	time_t *last = (time_t *)ctx;
+	CHECK(record->timestamp > *last);
+	*last = record->timestamp;
+	return true;
+}
+
+TEST_GROUP(KBVAS_POOL) {
+	struct kbvas_pool *pool;
+
+	void setup(void) {
+		pool = kbvas_pool_create(3, 1024);
+	}
+	void teardown(void) {
+		kbvas_pool_destroy(pool);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	void expect_drain(size_t connector) {
+		mock().expectOneCall("on_drain")
+			.withUnsignedIntParameter("connector",
+					(unsigned int)connector);
+	}
+};
+
+TEST(KBVAS_POOL, create_ShouldReturnNull_WhenNoConnectorOrArena) {
+	POINTERS_EQUAL(NULL, kbvas_pool_create(0, 1024));
+	POINTERS_EQUAL(NULL, kbvas_pool_create(1, 0));
+}
+
+TEST(KBVAS_POOL, get_ShouldReturnInstancePerConnector) {
+	LONGS_EQUAL(3, kbvas_pool_count(pool));
+	CHECK(kbvas_pool_get(pool, 0) != NULL);
+	CHECK(kbvas_pool_get(pool, 0) != kbvas_pool_get(pool, 1));
+	CHECK(kbvas_pool_get(pool, 1) != kbvas_pool_get(pool, 2));
+	POINTERS_EQUAL(NULL, kbvas_pool_get(pool, 3));
+}
+
+TEST(KBVAS_POOL, enqueue_ShouldQueuePerConnector) {
+	struct kbvas_record record;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_enqueue(kbvas_pool_get(pool, 1),
+					SOC_FRAME("\x01"), SOC_FRAME_SIZE));
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_enqueue(kbvas_pool_get(pool, 1),
+					SOC_FRAME("\x02"), SOC_FRAME_SIZE));
+
+	LONGS_EQUAL(0, kbvas_count(kbvas_pool_get(pool, 0)));
+	LONGS_EQUAL(2, kbvas_count(kbvas_pool_get(pool, 1)));
+	LONGS_EQUAL(0, kbvas_count(kbvas_pool_get(pool, 2)));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_peek_record(kbvas_pool_get(pool, 1), 0, &record));
+	LONGS_EQUAL(1, record.timestamp);
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_peek_record(kbvas_pool_get(pool, 1), -1, &record));
+	LONGS_EQUAL(2, record.timestamp);
+}
+
+TEST(KBVAS_POOL, enqueue_ShouldUseSpaceFreedByOtherConnectors) {
+	struct kbvas *busy = kbvas_pool_get(pool, 0);
+	struct kbvas *idle = kbvas_pool_get(pool, 1);
+	size_t n = 0;
+
+	while (enqueue_at(busy, (uint8_t)(n + 1)) == KBVAS_ERROR_NONE) {
+		n++;
+	}
+	CHECK(n > 1);
+	LONGS_EQUAL(KBVAS_ERROR_NOSPC, enqueue_at(idle, 1));
+
+	kbvas_set_batch_count(busy, 1);
+	kbvas_clear_batch(busy);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, enqueue_at(idle, 1));
+	LONGS_EQUAL(n - 1, kbvas_count(busy));
+	LONGS_EQUAL(1, kbvas_count(idle));
+}
+
+TEST(KBVAS_POOL, used_ShouldDropToZero_WhenAllCleared) {
+	LONGS_EQUAL(0, kbvas_pool_used(pool));
+
+	enqueue_at(kbvas_pool_get(pool, 0), 1);
+	enqueue_at(kbvas_pool_get(pool, 2), 1);
+	CHECK(kbvas_pool_used(pool) > 0);
+
+	kbvas_clear(kbvas_pool_get(pool, 0));
+	kbvas_clear(kbvas_pool_get(pool, 2));
+	LONGS_EQUAL(0, kbvas_pool_used(pool));
+}
+
+TEST(KBVAS_POOL, stream_ShouldStoreFrameInArena) {
+	struct kbvas *kbvas = kbvas_pool_get(pool, 2);
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_stream_begin(stream, SOC_FRAME_SIZE));
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_stream_feed(stream, SOC_FRAME("\x07"), 4));
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_stream_feed(stream, &SOC_FRAME("\x07")[4], 5));
+	kbvas_stream_destroy(stream);
+
+	struct kbvas_entry entry;
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(kbvas, &entry));
+	LONGS_EQUAL(7, entry.timestamp);
+	LONGS_EQUAL(0, kbvas_pool_used(pool));
+}
+
+TEST(KBVAS_POOL, drain_ShouldServeReadyConnectorsInTurn) {
+	enqueue_at(kbvas_pool_get(pool, 0), 1);
+	enqueue_at(kbvas_pool_get(pool, 2), 1);
+
+	expect_drain(0);
+	expect_drain(2);
+	LONGS_EQUAL(2, kbvas_pool_drain(pool, 0, on_drain, NULL));
+	LONGS_EQUAL(0, kbvas_count(kbvas_pool_get(pool, 0)));
+	LONGS_EQUAL(0, kbvas_count(kbvas_pool_get(pool, 2)));
+
+	LONGS_EQUAL(0, kbvas_pool_drain(pool, 0, on_drain, NULL));
+}
+
+TEST(KBVAS_POOL, drain_ShouldResumeAfterLastServed_WhenLimited) {
+	for (size_t i = 0; i < 3; i++) {
+		enqueue_at(kbvas_pool_get(pool, i), 1);
+		enqueue_at(kbvas_pool_get(pool, i), 2);
+	}
+
+	expect_drain(0);
+	LONGS_EQUAL(1, kbvas_pool_drain(pool, 1, on_drain, NULL));
+	expect_drain(1);
+	expect_drain(2);
+	LONGS_EQUAL(2, kbvas_pool_drain(pool, 2, on_drain, NULL));
+	expect_drain(0);
+	LONGS_EQUAL(1, kbvas_pool_drain(pool, 1, on_drain, NULL));
+}
+
+TEST(KBVAS_POOL, drain_ShouldStopAndKeepBatch_WhenNotSent) {
+	enqueue_at(kbvas_pool_get(pool, 1), 1);
+	enqueue_at(kbvas_pool_get(pool, 2), 1);
+
+	mock().expectOneCall("on_drain")
+		.withUnsignedIntParameter("connector", 1)
+		.andReturnValue(false);
+	LONGS_EQUAL(0, kbvas_pool_drain(pool, 0, on_drain, NULL));
+	LONGS_EQUAL(1, kbvas_count(kbvas_pool_get(pool, 1)));
+
+	expect_drain(1);
+	expect_drain(2);
+	LONGS_EQUAL(2, kbvas_pool_drain(pool, 0, on_drain, NULL));
+}
+
+TEST(KBVAS_POOL, arena_ShouldKeepQueuesIntact_WhenChurned) {
+	time_t last[3] = { 0, };
+	uint8_t ts[3] = { 0, };
+
+	srand(1);
+
+	for (int i = 0; i < 5000; i++) {
+		const size_t c = (size_t)rand() % 3;
+		struct kbvas *kbvas = kbvas_pool_get(pool, c);
+
+		if (rand() % 3) {
+			if (enqueue_at(kbvas, (uint8_t)(ts[c] + 1)) ==
+					KBVAS_ERROR_NONE) {
+				ts[c]++;
+			}
+		} else if (kbvas_count(kbvas)) {
+			kbvas_set_batch_count(kbvas,
+					(kbvas_batch_count_t)(rand() % 4 + 1));
+			kbvas_clear_batch(kbvas);
+		}
+
+		if (ts[c] == UINT8_MAX) {
+			kbvas_clear(kbvas);
+			ts[c] = 0;
+		}
+	}
+
+	for (size_t c = 0; c < 3; c++) {
+		struct kbvas_record record;
+		struct kbvas *kbvas = kbvas_pool_get(pool, c);
+
+		if (kbvas_peek_record(kbvas, 0, &record) ==
+				KBVAS_ERROR_NONE) {
+			last[c] = record.timestamp - 1;
+		}
+		kbvas_iterate_records(kbvas, check_order, &last[c]);
+		kbvas_clear(kbvas);
+	}
+
+	LONGS_EQUAL(0, kbvas_pool_used(pool));
+}
@@ -0,0 +1,327 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include "kbvas.h"
+#include "kbvas_ring_backend.h"
+
+static const uint8_t dummy_sample1[] = {0xA1, 0x04, 0x00, 0x00, 0x00, 0x01};  // timestamp=1
+static const uint8_t dummy_sample2[] = {0xA1, 0x04, 0x00, 0x00, 0x00, 0x02};  // timestamp=2
+static const uint8_t dummy_sample3[] = {0xA1, 0x04, 0x00, 0x00, 0x00, 0x03};  // timestamp=3
+static const uint8_t dummy_sample4[] = {0xA1, 0x04, 0x00, 0x00, 0x00, 0x04};  // timestamp=4
+
+static bool count_iterator(struct kbvas *self,
+		const struct kbvas_entry *entry, void *ctx) {
+	int *counter = (int *)ctx;
+	(*counter)++;
+	return true;
+}
+
+static bool collect_timestamps(struct kbvas *self,
+		const struct kbvas_entry *entry, void *ctx) {
+	time_t **p = (time_t **)ctx;
+	*(*p)++ = entry->timestamp;
+	return true;
+}
+
+TEST_GROUP(KBVAS_RING) {
+	struct kbvas *kbvas;
+	struct kbvas_backend_api *backend;
+
+	void setup(void) {
+		backend = kbvas_ring_backend_create(3, KBVAS_RING_OVERFLOW_REJECT);
+		kbvas = kbvas_create(backend, NULL);
+	}
+	void teardown(void) {
+		kbvas_destroy(kbvas);
+		kbvas_ring_backend_destroy(backend);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	void recreate(size_t capacity, kbvas_ring_overflow_t overflow) {
+		teardown();
+		backend = kbvas_ring_backend_create(capacity, overflow);
+		kbvas = kbvas_create(backend, NULL);
+	}
+};
+
+TEST(KBVAS_RING, create_ShouldReturnNull_WhenCapacityIsZero) {
+	POINTERS_EQUAL(NULL, kbvas_ring_backend_create(0,
+			KBVAS_RING_OVERFLOW_REJECT));
+}
+
+TEST(KBVAS_RING, dequeue_ShouldFail_WhenEmpty) {
+	struct kbvas_entry entry;
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_dequeue(kbvas, &entry));
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_peek(kbvas, 0, &entry));
+}
+
+TEST(KBVAS_RING, dequeue_ShouldReturnEntriesInOrder) {
+	struct kbvas_entry entry;
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(kbvas, &entry));
+	LONGS_EQUAL(1, entry.timestamp);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(kbvas, &entry));
+	LONGS_EQUAL(2, entry.timestamp);
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+}
+
+TEST(KBVAS_RING, enqueue_ShouldReturnNoSpace_WhenFullAndRejectPolicy) {
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+
+	LONGS_EQUAL(KBVAS_ERROR_NOSPC,
+			kbvas_enqueue(kbvas, dummy_sample4, sizeof(dummy_sample4)));
+	LONGS_EQUAL(3, kbvas_count(kbvas));
+
+	struct kbvas_entry entry;
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, -1, &entry));
+	LONGS_EQUAL(3, entry.timestamp);
+}
+
+TEST(KBVAS_RING, enqueue_ShouldDiscardOldest_WhenFullAndOverwritePolicy) {
+	recreate(3, KBVAS_RING_OVERFLOW_OVERWRITE);
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_enqueue(kbvas, dummy_sample4, sizeof(dummy_sample4)));
+	LONGS_EQUAL(3, kbvas_count(kbvas));
+
+	struct kbvas_entry entry;
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, 0, &entry));
+	LONGS_EQUAL(2, entry.timestamp);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, -1, &entry));
+	LONGS_EQUAL(4, entry.timestamp);
+}
+
+TEST(KBVAS_RING, peek_ShouldMatchBetween_PositiveAndNegativeIndex_WhenWrapped) {
+	struct kbvas_entry entry_pos, entry_neg;
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_dequeue(kbvas, NULL);
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+	kbvas_enqueue(kbvas, dummy_sample4, sizeof(dummy_sample4));
+
+	for (int i = 0; i < 3; i++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, i, &entry_pos));
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, i - 3, &entry_neg));
+		LONGS_EQUAL(i + 2, entry_pos.timestamp);
+		LONGS_EQUAL(0, memcmp(&entry_pos, &entry_neg, sizeof(entry_pos)));
+	}
+
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_peek(kbvas, 3, &entry_pos));
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_peek(kbvas, -4, &entry_pos));
+}
+
+TEST(KBVAS_RING, iterate_ShouldVisitInFifoOrder_WhenWrapped) {
+	time_t timestamps[3];
+	time_t *p = timestamps;
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_dequeue(kbvas, NULL);
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+	kbvas_enqueue(kbvas, dummy_sample4, sizeof(dummy_sample4));
+
+	kbvas_iterate(kbvas, collect_timestamps, &p);
+
+	LONGS_EQUAL(3, p - timestamps);
+	LONGS_EQUAL(2, timestamps[0]);
+	LONGS_EQUAL(3, timestamps[1]);
+	LONGS_EQUAL(4, timestamps[2]);
+}
+
+TEST(KBVAS_RING, clearBatch_ShouldDropFromHead) {
+	kbvas_set_batch_count(kbvas, 2);
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+
+	kbvas_clear_batch(kbvas);
+
+	struct kbvas_entry entry;
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, 0, &entry));
+	LONGS_EQUAL(3, entry.timestamp);
+
+	kbvas_clear_batch(kbvas);
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+}
+
+TEST(KBVAS_RING, clear_ShouldRemoveAllEntries) {
+	int visited = 0;
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_clear(kbvas);
+
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+	kbvas_iterate(kbvas, count_iterator, &visited);
+	LONGS_EQUAL(0, visited);
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3)));
+}
+
+TEST(KBVAS_RING, peekRecord_ShouldReturnUnsupported) {
+	struct kbvas_record record;
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	LONGS_EQUAL(KBVAS_ERROR_UNSUPPORTED, kbvas_peek_record(kbvas, 0, &record));
+}
+
+TEST(KBVAS_RING, enqueue_ShouldKeepOldest_WhenFullAndFrameIsInvalid) {
+	const uint8_t truncated_bsv[] = {0xA7, 0x00, 0xFF, 0x01, 0x02, 0x03};
+	struct kbvas_entry entry;
+
+	recreate(3, KBVAS_RING_OVERFLOW_OVERWRITE);
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT,
+			kbvas_enqueue(kbvas, truncated_bsv, sizeof(truncated_bsv)));
+
+	LONGS_EQUAL(3, kbvas_count(kbvas));
+	for (int i = 0; i < 3; i++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, i, &entry));
+		LONGS_EQUAL(i + 1, entry.timestamp);
+	}
+}
+
+TEST(KBVAS_RING, commit_ShouldFail_WhenEntryWasNotReserved) {
+	struct kbvas_entry *slot;
+	struct kbvas_entry entry;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, backend->reserve(
+			(struct kbvas_backend *)backend, &slot, NULL));
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, backend->commit(
+			(struct kbvas_backend *)backend, &entry, NULL));
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+}
+
+TEST(KBVAS_RING, dequeueMany_ShouldReturnEntriesInOrder_WhenWrapped) {
+	struct kbvas_entry entries[4];
+	size_t n;
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_dequeue(kbvas, NULL);
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+	kbvas_enqueue(kbvas, dummy_sample4, sizeof(dummy_sample4));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue_many(kbvas, entries, 2, &n));
+	LONGS_EQUAL(2, n);
+	LONGS_EQUAL(2, entries[0].timestamp);
+	LONGS_EQUAL(3, entries[1].timestamp);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue_many(kbvas, entries, 4, &n));
+	LONGS_EQUAL(1, n);
+	LONGS_EQUAL(4, entries[0].timestamp);
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+}
+
+TEST(KBVAS_RING, peekRange_ShouldStopAtNewest) {
+	struct kbvas_entry entries[4];
+	size_t n;
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_dequeue(kbvas, NULL);
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+	kbvas_enqueue(kbvas, dummy_sample4, sizeof(dummy_sample4));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_range(kbvas, 1, entries, 4, &n));
+	LONGS_EQUAL(2, n);
+	LONGS_EQUAL(3, entries[0].timestamp);
+	LONGS_EQUAL(4, entries[1].timestamp);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_range(kbvas, 3, entries, 4, &n));
+	LONGS_EQUAL(0, n);
+	LONGS_EQUAL(3, kbvas_count(kbvas));
+}
+
+TEST(KBVAS_RING, enqueueEntries_ShouldStopAtCapacity_WhenRejectPolicy) {
+	struct kbvas_entry entries[4];
+	size_t n;
+
+	for (int i = 0; i < 4; i++) {
+		memset(&entries[i], 0, sizeof(entries[i]));
+		entries[i].timestamp = i + 1;
+	}
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_dequeue(kbvas, NULL);
+
+	LONGS_EQUAL(KBVAS_ERROR_NOSPC,
+			kbvas_enqueue_entries(kbvas, entries, 4, &n));
+	LONGS_EQUAL(3, n);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_range(kbvas, 0, entries, 4, &n));
+	LONGS_EQUAL(3, n);
+	for (int i = 0; i < 3; i++) {
+		LONGS_EQUAL(i + 1, entries[i].timestamp);
+	}
+}
+
+TEST(KBVAS_RING, clearBatch_ShouldKeepTotals_WhenEntriesReplayed) {
+	struct kbvas_entry entries[3];
+	size_t n;
+
+	kbvas_set_batch_bytes(kbvas, 1);
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_dequeue_many(kbvas, entries, 2, &n);
+	LONGS_EQUAL(0, kbvas_count_batch(kbvas));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_enqueue_entries(kbvas, entries, n, NULL));
+	LONGS_EQUAL(1, kbvas_count_batch(kbvas));
+	kbvas_clear_batch(kbvas);
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+	LONGS_EQUAL(1, kbvas_count_batch(kbvas));
+}
+
+TEST(KBVAS_RING, iterate_ShouldPeekInChunks_WhenBackendHasNoIterate) {
+	const uint8_t *samples[] = { dummy_sample1, dummy_sample2,
+		dummy_sample3, dummy_sample4, dummy_sample1 };
+	time_t timestamps[5];
+	time_t *p = timestamps;
+
+	teardown();
+	backend = kbvas_ring_backend_create(5, KBVAS_RING_OVERFLOW_REJECT);
+	backend->iterate = NULL; /* before create, which sizes the buffer */
+	kbvas = kbvas_create(backend, NULL);
+
+	for (int i = 0; i < 5; i++) {
+		kbvas_enqueue(kbvas, samples[i], sizeof(dummy_sample1));
+	}
+
+	kbvas_iterate(kbvas, collect_timestamps, &p);
+
+	LONGS_EQUAL(5, p - timestamps);
+	LONGS_EQUAL(1, timestamps[0]);
+	LONGS_EQUAL(4, timestamps[3]);
+	LONGS_EQUAL(1, timestamps[4]);
+}
+
+TEST(KBVAS_RING, caps_ShouldAdvertiseSpsc_OnlyWhenRejecting) {
+	CHECK(backend->caps & KBVAS_BACKEND_CAP_CONST_COUNT);
+	CHECK(backend->caps & KBVAS_BACKEND_CAP_RANDOM_PEEK);
+	CHECK(backend->caps & KBVAS_BACKEND_CAP_SPSC);
+
+	recreate(3, KBVAS_RING_OVERFLOW_OVERWRITE);
+
+	CHECK_FALSE(backend->caps & KBVAS_BACKEND_CAP_SPSC);
+}
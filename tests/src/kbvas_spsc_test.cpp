@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "kbvas.h"
+#include "kbvas_ring_backend.h"
+
+#define NR_FRAMES		200000
+#define RING_CAPACITY		16
+#define BATCH_COUNT		8 /* NR_FRAMES is a multiple of it */
+
+/* Nothing here may call into CppUTest off the main thread; outcomes are
+ * collected and checked once both threads are joined. */
+struct spsc {
+	struct kbvas *kbvas;
+	kbvas_error_t producer_err;
+	size_t received;
+	size_t out_of_order;
+};
+
+static void make_frame(uint8_t *frame, uint32_t timestamp) {
+	frame[0] = KBVAS_TLV_TIMESTAMP;
+	frame[1] = 4;
+	frame[2] = (uint8_t)(timestamp >> 24);
+	frame[3] = (uint8_t)(timestamp >> 16);
+	frame[4] = (uint8_t)(timestamp >> 8);
+	frame[5] = (uint8_t)timestamp;
+	frame[6] = KBVAS_TLV_SOC;
+	frame[7] = 1;
+	frame[8] = (uint8_t)timestamp;
+}
+
+static void *produce(void *arg) {
+	struct spsc *spsc = (struct spsc *)arg;
+	uint8_t frame[9];
+
+	for (uint32_t i = 1; i <= NR_FRAMES; i++) {
+		kbvas_error_t err;
+
+		make_frame(frame, i);
+		while ((err = kbvas_enqueue(spsc->kbvas, frame, sizeof(frame)))
+				== KBVAS_ERROR_NOSPC) {
+			sched_yield();
+		}
+
+		if (err != KBVAS_ERROR_NONE) {
+			spsc->producer_err = err;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+struct pass {
+	struct spsc *spsc;
+	size_t seen;
+};
+
+static bool check_entry(struct kbvas *self,
+		const struct kbvas_entry *entry, void *ctx) {
+	struct pass *pass = (struct pass *)ctx;
+	const size_t expected = pass->spsc->received + pass->seen + 1;
+
+	if (entry->timestamp != (time_t)expected) {
+		pass->spsc->out_of_order++;
+	}
+
+	return ++pass->seen < BATCH_COUNT;
+}
+
+static void *consume_by_batch(void *arg) {
+	struct spsc *spsc = (struct spsc *)arg;
+
+	while (spsc->received < NR_FRAMES && !spsc->out_of_order) {
+		struct pass pass = { .spsc = spsc };
+
+		kbvas_iterate(spsc->kbvas, check_entry, &pass);
+
+		/* a partial batch is seen again on the next pass */
+		if (pass.seen == BATCH_COUNT) {
+			kbvas_clear_batch(spsc->kbvas);
+			spsc->received += pass.seen;
+		} else {
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+static void *consume_by_dequeue(void *arg) {
+	struct spsc *spsc = (struct spsc *)arg;
+	struct kbvas_entry peeked;
+	struct kbvas_entry entry;
+
+	while (spsc->received < NR_FRAMES && !spsc->out_of_order) {
+		if (kbvas_peek(spsc->kbvas, 0, &peeked) != KBVAS_ERROR_NONE) {
+			sched_yield();
+			continue;
+		}
+		if (kbvas_dequeue(spsc->kbvas, &entry) != KBVAS_ERROR_NONE ||
+				entry.timestamp != peeked.timestamp ||
+				entry.timestamp != (time_t)++spsc->received) {
+			spsc->out_of_order++;
+		}
+	}
+
+	return NULL;
+}
+
+TEST_GROUP(KBVAS_SPSC) {
+	struct kbvas_backend_api *backend;
+	struct spsc spsc;
+
+	void setup(void) {
+		backend = kbvas_ring_backend_create(RING_CAPACITY,
+				KBVAS_RING_OVERFLOW_REJECT);
+		spsc = (struct spsc) { .kbvas = kbvas_create(backend, NULL) };
+		kbvas_set_batch_count(spsc.kbvas, BATCH_COUNT);
+	}
+	void teardown(void) {
+		kbvas_destroy(spsc.kbvas);
+		kbvas_ring_backend_destroy(backend);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	void run(void *(*consumer)(void *)) {
+		pthread_t producer_thread, consumer_thread;
+
+		LONGS_EQUAL(0, pthread_create(&producer_thread, NULL,
+				produce, &spsc));
+		LONGS_EQUAL(0, pthread_create(&consumer_thread, NULL,
+				consumer, &spsc));
+		pthread_join(producer_thread, NULL);
+		pthread_join(consumer_thread, NULL);
+
+		LONGS_EQUAL(KBVAS_ERROR_NONE, spsc.producer_err);
+		LONGS_EQUAL(0, spsc.out_of_order);
+		LONGS_EQUAL(NR_FRAMES, spsc.received);
+		LONGS_EQUAL(0, kbvas_count(spsc.kbvas));
+	}
+};
+
+TEST(KBVAS_SPSC, iterateAndDrop_ShouldSeeEveryEntryInOrder) {
+	run(consume_by_batch);
+}
+
+TEST(KBVAS_SPSC, peekAndDequeue_ShouldSeeEveryEntryInOrder) {
+	run(consume_by_dequeue);
+}
@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include "kbvas.h"
+#include "kbvas_ring_backend.h"
+#include "test_frames.h"
+
+#define RING_CAPACITY		4
+
+static uint32_t sum(const uint32_t *buckets) {
+	uint32_t total = 0;
+	for (int i = 0; i < KBVAS_STATS_LATENCY_BUCKETS; i++) {
+		total += buckets[i];
+	}
+	return total;
+}
+
+static bool peek_twice(struct kbvas *self, const struct kbvas_entry *entry,
+		void *ctx) {
+	struct kbvas_entry peeked;
+
+	kbvas_peek(self, 0, &peeked);
+	kbvas_peek(self, 0, &peeked);
+	return true;
+}
+
+TEST_GROUP(KBVAS_STATS) {
+	struct kbvas *kbvas;
+	struct kbvas_backend_api *backend;
+	struct kbvas_stats stats;
+
+	void setup(void) {
+		fake_ticks = 0;
+		fake_step = 0;
+		backend = kbvas_ring_backend_create(RING_CAPACITY,
+				KBVAS_RING_OVERFLOW_REJECT);
+		kbvas = kbvas_create(backend, NULL);
+	}
+	void teardown(void) {
+		kbvas_destroy(kbvas);
+		kbvas_ring_backend_destroy(backend);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	void snapshot(void) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_get_stats(kbvas, &stats));
+	}
+};
+
+TEST(KBVAS_STATS, getStats_ShouldReturnMissingParam_WhenNullGiven) {
+	LONGS_EQUAL(KBVAS_ERROR_MISSING_PARAM, kbvas_get_stats(NULL, &stats));
+	LONGS_EQUAL(KBVAS_ERROR_MISSING_PARAM, kbvas_get_stats(kbvas, NULL));
+}
+
+TEST(KBVAS_STATS, enqueue_ShouldCountAcceptedFramesAndBytes) {
+	enqueue_at(kbvas, 1);
+	enqueue_at(kbvas, 1);
+
+	snapshot();
+	LONGS_EQUAL(2, stats.accepted);
+	LONGS_EQUAL(2 * SOC_FRAME_SIZE, stats.bytes_parsed);
+	CHECK(stats.bytes_encoded > 0);
+	LONGS_EQUAL(2, stats.high_water);
+	CHECK(stats.backend_calls > 0);
+	LONGS_EQUAL(0, stats.backend_errors);
+}
+
+TEST(KBVAS_STATS, enqueue_ShouldCountRejectedFramesByError) {
+	const uint8_t bad[] = { 0xA1, 0x09, 0x00 };
+
+	for (int i = 0; i < RING_CAPACITY + 1; i++) {
+		enqueue_at(kbvas, 1);
+	}
+	kbvas_enqueue(kbvas, bad, sizeof(bad));
+
+	snapshot();
+	LONGS_EQUAL(RING_CAPACITY, stats.accepted);
+	LONGS_EQUAL(1, stats.rejected[KBVAS_ERROR_NOSPC]);
+	LONGS_EQUAL(1, stats.rejected[KBVAS_ERROR_INVALID_FORMAT]);
+	LONGS_EQUAL((RING_CAPACITY + 1) * SOC_FRAME_SIZE + sizeof(bad),
+			stats.bytes_parsed);
+	LONGS_EQUAL(RING_CAPACITY, stats.high_water);
+	LONGS_EQUAL(1, stats.backend_errors);
+}
+
+TEST(KBVAS_STATS, highWater_ShouldHoldPeak_WhenQueueDrained) {
+	for (int i = 0; i < 3; i++) {
+		enqueue_at(kbvas, 1);
+	}
+	kbvas_clear(kbvas);
+	enqueue_at(kbvas, 1);
+
+	snapshot();
+	LONGS_EQUAL(3, stats.high_water);
+}
+
+TEST(KBVAS_STATS, latency_ShouldNotBeCounted_WhenNoClockSet) {
+	enqueue_at(kbvas, 1);
+
+	snapshot();
+	LONGS_EQUAL(0, sum(stats.enqueue_latency));
+	LONGS_EQUAL(0, sum(stats.backend_latency));
+}
+
+TEST(KBVAS_STATS, latency_ShouldBeBucketedByLog2OfTicks) {
+	kbvas_set_clock(kbvas, fake_clock);
+	fake_step = 1;
+	enqueue_at(kbvas, 1);
+
+	snapshot();
+	LONGS_EQUAL(1, sum(stats.enqueue_latency));
+	LONGS_EQUAL(stats.backend_calls, sum(stats.backend_latency));
+	/* nothing is read between the two reads of a backend call */
+	LONGS_EQUAL(stats.backend_calls, stats.backend_latency[0]);
+
+	kbvas_reset_stats(kbvas);
+	fake_step = 1000;
+	enqueue_at(kbvas, 1);
+
+	snapshot();
+	LONGS_EQUAL(stats.backend_calls, stats.backend_latency[9]);
+}
+
+TEST(KBVAS_STATS, latency_ShouldSpanWholeCall_WhenBackendCallsNest) {
+	enqueue_at(kbvas, 1);
+	kbvas_reset_stats(kbvas);
+	kbvas_set_clock(kbvas, fake_clock);
+	fake_step = 1;
+
+	kbvas_iterate(kbvas, peek_twice, NULL);
+
+	snapshot();
+	LONGS_EQUAL(3, stats.backend_calls);
+	/* each peek reads the clock twice in a row */
+	LONGS_EQUAL(2, stats.backend_latency[0]);
+	/* while the iterate around them takes five ticks */
+	LONGS_EQUAL(1, stats.backend_latency[2]);
+}
+
+TEST(KBVAS_STATS, latency_ShouldBeCappedAtLastBucket) {
+	kbvas_set_clock(kbvas, fake_clock);
+	fake_step = UINT64_MAX / 2;
+	enqueue_at(kbvas, 1);
+
+	snapshot();
+	LONGS_EQUAL(1, stats.enqueue_latency[KBVAS_STATS_LATENCY_BUCKETS - 1]);
+}
+
+TEST(KBVAS_STATS, stream_ShouldBeCountedAsFrame) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+
+	kbvas_stream_begin(stream, SOC_FRAME_SIZE);
+	kbvas_stream_feed(stream, SOC_FRAME("\x01"), 4);
+	kbvas_stream_feed(stream, SOC_FRAME("\x01") + 4, SOC_FRAME_SIZE - 4);
+	kbvas_stream_destroy(stream);
+
+	snapshot();
+	LONGS_EQUAL(1, stats.accepted);
+	LONGS_EQUAL(SOC_FRAME_SIZE, stats.bytes_parsed);
+	LONGS_EQUAL(1, stats.high_water);
+}
+
+TEST(KBVAS_STATS, resetStats_ShouldZeroCounters) {
+	enqueue_at(kbvas, 1);
+	kbvas_reset_stats(kbvas);
+
+	snapshot();
+	LONGS_EQUAL(0, stats.accepted);
+	LONGS_EQUAL(0, stats.bytes_parsed);
+	LONGS_EQUAL(0, stats.backend_calls);
+	LONGS_EQUAL(0, stats.high_water);
+}
+
+TEST(KBVAS_STATS, enqueue_ShouldCountDuplicateAsDropped) {
+	kbvas_set_dedup_window(kbvas, 4);
+
+	enqueue_at(kbvas, 1);
+	snapshot();
+	const uint64_t encoded = stats.bytes_encoded;
+	enqueue_at(kbvas, 1);
+
+	snapshot();
+	LONGS_EQUAL(1, stats.accepted);
+	LONGS_EQUAL(1, stats.dropped);
+	LONGS_EQUAL(2 * SOC_FRAME_SIZE, stats.bytes_parsed);
+	LONGS_EQUAL(encoded, stats.bytes_encoded);
+	LONGS_EQUAL(1, stats.high_water);
+}
+
+#if defined(KBVAS_USE_CHANGE_FILTER)
+TEST(KBVAS_STATS, enqueueAndStream_ShouldCountFilteredAsDropped) {
+	const struct kbvas_change_filter filter = { .soc = 1 };
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+
+	kbvas_set_change_filter(kbvas, &filter);
+	enqueue_at(kbvas, 1);
+	snapshot();
+	const uint64_t encoded = stats.bytes_encoded;
+	enqueue_at(kbvas, 2);
+	kbvas_stream_begin(stream, SOC_FRAME_SIZE);
+	kbvas_stream_feed(stream, SOC_FRAME("\x03"), SOC_FRAME_SIZE);
+	kbvas_stream_destroy(stream);
+
+	snapshot();
+	LONGS_EQUAL(2, kbvas_count_filtered(kbvas));
+	LONGS_EQUAL(1, stats.accepted);
+	LONGS_EQUAL(2, stats.dropped);
+	LONGS_EQUAL(3 * SOC_FRAME_SIZE, stats.bytes_parsed);
+	LONGS_EQUAL(encoded, stats.bytes_encoded);
+	LONGS_EQUAL(1, stats.high_water);
+}
+#endif
@@ -0,0 +1,206 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include <stdlib.h>
+
+#include "kbvas.h"
+#include "kbvas_memory_backend.h"
+#include "kbvas_ring_backend.h"
+#include "test_frames.h"
+
+static void summarize_reference(const uint8_t *values, size_t n,
+		struct kbvas_summary *summary) {
+	uint32_t sum = 0;
+
+	memset(summary, 0, sizeof(*summary));
+	if (n == 0) {
+		return;
+	}
+
+	summary->min = summary->max = values[0];
+	for (size_t i = 0; i < n; i++) {
+		if (values[i] < summary->min) {
+			summary->min = values[i];
+			summary->argmin = (uint16_t)i;
+		}
+		if (values[i] > summary->max) {
+			summary->max = values[i];
+			summary->argmax = (uint16_t)i;
+		}
+		sum += values[i];
+	}
+	summary->spread = (uint8_t)(summary->max - summary->min);
+	summary->mean_q8 = (uint16_t)((((uint64_t)sum << 8) + n / 2) / n);
+	summary->count = (uint16_t)n;
+}
+
+static void check_summary(const struct kbvas_summary *expected,
+		const struct kbvas_summary *actual) {
+	LONGS_EQUAL(expected->min, actual->min);
+	LONGS_EQUAL(expected->max, actual->max);
+	LONGS_EQUAL(expected->spread, actual->spread);
+	LONGS_EQUAL(expected->argmin, actual->argmin);
+	LONGS_EQUAL(expected->argmax, actual->argmax);
+	LONGS_EQUAL(expected->mean_q8, actual->mean_q8);
+	LONGS_EQUAL(expected->count, actual->count);
+}
+
+TEST_GROUP(KBVAS_SUMMARY) {
+	uint8_t values[1024];
+	struct test_frame f;
+
+	void setup(void) {
+		srand(1);
+		for (size_t i = 0; i < sizeof(values); i++) {
+			values[i] = (uint8_t)(0x80 + rand() % 32);
+		}
+		f = (struct test_frame) {
+			.timestamp = 1,
+			.cells = values,
+			.ncells = 96,
+			.modules = &values[96],
+			.nmodules = 16,
+		};
+	}
+	void teardown(void) {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(KBVAS_SUMMARY, summarize_ShouldBeZero_WhenEmpty) {
+	struct kbvas_summary summary;
+	struct kbvas_summary expected;
+
+	memset(&expected, 0, sizeof(expected));
+	memset(&summary, 0xff, sizeof(summary));
+	kbvas_summarize(values, 0, &summary);
+	check_summary(&expected, &summary);
+
+	memset(&summary, 0xff, sizeof(summary));
+	kbvas_summarize(NULL, 10, &summary);
+	check_summary(&expected, &summary);
+}
+
+TEST(KBVAS_SUMMARY, summarize_ShouldMatchReference_ForAnyLengthAndAlignment) {
+	struct kbvas_summary summary;
+	struct kbvas_summary expected;
+
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t n = 1; n <= 80; n++) {
+			summarize_reference(&values[offset], n, &expected);
+			kbvas_summarize(&values[offset], n, &summary);
+			check_summary(&expected, &summary);
+		}
+	}
+
+	summarize_reference(values, sizeof(values), &expected);
+	kbvas_summarize(values, sizeof(values), &summary);
+	check_summary(&expected, &summary);
+}
+
+TEST(KBVAS_SUMMARY, summarize_ShouldHandleFullByteRange) {
+	struct kbvas_summary summary;
+
+	for (size_t i = 0; i < sizeof(values); i++) {
+		values[i] = (uint8_t)(i * 7);
+	}
+	values[700] = 0xff;
+	values[300] = 0;
+
+	kbvas_summarize(values, sizeof(values), &summary);
+	LONGS_EQUAL(0, summary.min);
+	LONGS_EQUAL(0xff, summary.max);
+	LONGS_EQUAL(0xff, summary.spread);
+	LONGS_EQUAL(0, summary.argmin);
+	LONGS_EQUAL(73, summary.argmax); /* 73 * 7 = 511 = 0x1ff */
+}
+
+TEST(KBVAS_SUMMARY, summarize_ShouldNotOverflow_WhenAllValuesAreMax) {
+	static uint8_t large[UINT16_MAX];
+	struct kbvas_summary summary;
+
+	memset(large, 0xff, sizeof(large));
+	kbvas_summarize(large, sizeof(large), &summary);
+	LONGS_EQUAL(0xff << 8, summary.mean_q8);
+	LONGS_EQUAL(UINT16_MAX, summary.count);
+}
+
+TEST(KBVAS_SUMMARY, maxDelta_ShouldMatchReference_ForAnyLengthAndAlignment) {
+	uint8_t other[sizeof(values)];
+
+	for (size_t i = 0; i < sizeof(other); i++) {
+		other[i] = (uint8_t)(rand() % 256);
+	}
+
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t n = 0; n <= 80; n++) {
+			uint8_t expected = 0;
+			for (size_t i = 0; i < n; i++) {
+				const int d = abs(values[offset + i] - other[i]);
+				expected = d > expected ? (uint8_t)d : expected;
+			}
+			LONGS_EQUAL(expected,
+				kbvas_max_delta(&values[offset], other, n));
+		}
+	}
+}
+
+TEST(KBVAS_SUMMARY, maxDelta_ShouldFindSingleChange_WhenOthersAreEqual) {
+	uint8_t other[sizeof(values)];
+
+	memcpy(other, values, sizeof(other));
+	LONGS_EQUAL(0, kbvas_max_delta(values, other, sizeof(values)));
+
+	values[517] = 0;
+	other[517] = 0xff;
+	LONGS_EQUAL(0xff, kbvas_max_delta(values, other, sizeof(values)));
+	LONGS_EQUAL(0xff, kbvas_max_delta(other, values, sizeof(values)));
+}
+
+TEST(KBVAS_SUMMARY, enqueue_ShouldStoreSummaries_WhenEntryBackend) {
+	struct kbvas_backend_api *backend =
+		kbvas_ring_backend_create(2, KBVAS_RING_OVERFLOW_REJECT);
+	struct kbvas *kbvas = kbvas_create(backend, NULL);
+	struct kbvas_summary expected;
+	struct kbvas_entry entry;
+	uint8_t frame[256];
+
+	const size_t len = make_frame(frame, &f);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, frame, len));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(kbvas, &entry));
+
+	summarize_reference(values, 96, &expected);
+	check_summary(&expected, &entry.bsv_summary);
+	summarize_reference(&values[96], 16, &expected);
+	check_summary(&expected, &entry.bmt_summary);
+
+	kbvas_destroy(kbvas);
+	kbvas_ring_backend_destroy(backend);
+}
+
+TEST(KBVAS_SUMMARY, peek_ShouldComputeSummaries_WhenRecordBackend) {
+	struct kbvas_backend_api *backend = kbvas_memory_backend_create();
+	struct kbvas *kbvas = kbvas_create(backend, NULL);
+	struct kbvas_summary expected;
+	struct kbvas_entry entry;
+	uint8_t frame[256];
+
+	const size_t len = make_frame(frame, &f);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, frame, len));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, 0, &entry));
+
+	summarize_reference(values, 96, &expected);
+	check_summary(&expected, &entry.bsv_summary);
+	summarize_reference(&values[96], 16, &expected);
+	check_summary(&expected, &entry.bmt_summary);
+
+	kbvas_destroy(kbvas);
+	kbvas_memory_backend_destroy(backend);
+}
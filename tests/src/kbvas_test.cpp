@@ -9,6 +9,7 @@
 
 #include "kbvas.h"
 #include "kbvas_memory_backend.h"
+#include "test_frames.h"
 
 #if KBVAS_CELL_VOLTAGE_MAX_COUNT == 960
 static const uint8_t sample1[] = {
@@ -659,6 +660,40 @@ TEST(KBVAS, enqueue_ShouldRejectTLVAtExactBoundary) {
 	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, err);
 }
 
+static const uint8_t extended_sample[] = {
+	0xA1, 0x04, 0x66, 0xbc, 0x6d, 0x23,
+	0xA3, 0x01, 0xc6,
+	0xB1, 0x02, 0x0e, 0x10,                   // session duration
+	0xB2, 0x04, 'B', 'A', 'T', '1',           // battery ID
+	0xB7, 0x02, 0x96, 0x98,                   // cell voltage min/max
+	0xB8, 0x02, 0x19, 0x1c,                   // module temperature min/max
+	0xC1, 0x04, 0x00, 0x00, 0x01, 0x00,       // counter
+	0xC2, 0x03, 0xde, 0xad, 0xbe,             // encrypted VIN
+};
+
+TEST(KBVAS, enqueue_ShouldAcceptExtendedTags) {
+	struct kbvas_entry entry;
+	struct kbvas_record record;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, extended_sample, sizeof(extended_sample)));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, 0, &record));
+	LONGS_EQUAL((sizeof(extended_sample) - 6 + 2) / 3 * 4, record.len);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(kbvas, &entry));
+	LONGS_EQUAL(0x66bc6d23, entry.timestamp);
+	LONGS_EQUAL(record.len, strlen(entry.base64_encoded));
+}
+
+TEST(KBVAS, enqueue_ShouldRejectTruncatedExtendedTag) {
+	const uint8_t truncated[] = {
+		0xA1, 0x04, 0x00, 0x00, 0x00, 0x01,
+		0xC2, 0x08, 0xde, 0xad,
+	};
+
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, kbvas_enqueue(kbvas, truncated, sizeof(truncated)));
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+}
+
 TEST(KBVAS, count_ShouldReturnZero_WhenNullPointer) {
 	LONGS_EQUAL(0, kbvas_count(NULL));
 }
@@ -790,6 +825,297 @@ TEST(KBVAS, batchCallback_ShouldBeCalledMultipleTimes_WhenBatchesAreSeparatedByD
 	LONGS_EQUAL(2, call_count);
 }
 
+// SOC_FRAME: three bytes stored, or four base64 characters
+TEST(KBVAS, batchCallback_ShouldBeCalled_WhenByteBudgetReached) {
+	int call_count = 0;
+
+	kbvas_register_batch_callback(kbvas, on_batch_callback, &call_count);
+	kbvas_set_batch_count(kbvas, KBVAS_MAX_BATCH_COUNT);
+	kbvas_set_batch_bytes(kbvas, 8);
+
+	mock().expectOneCall("on_batch_callback")
+		.withPointerParameter("self", kbvas)
+		.withPointerParameter("ctx", &call_count);
+	kbvas_enqueue(kbvas, SOC_FRAME("\x01"), SOC_FRAME_SIZE);
+	LONGS_EQUAL(0, call_count);
+	kbvas_enqueue(kbvas, SOC_FRAME("\x02"), SOC_FRAME_SIZE);
+	LONGS_EQUAL(1, call_count);
+}
+
+TEST(KBVAS, countBatch_ShouldStopAtByteBudget) {
+	kbvas_set_batch_count(kbvas, KBVAS_MAX_BATCH_COUNT);
+	kbvas_set_batch_bytes(kbvas, 10);
+
+	kbvas_enqueue(kbvas, SOC_FRAME("\x01"), SOC_FRAME_SIZE);
+	kbvas_enqueue(kbvas, SOC_FRAME("\x02"), SOC_FRAME_SIZE);
+	kbvas_enqueue(kbvas, SOC_FRAME("\x03"), SOC_FRAME_SIZE);
+
+	LONGS_EQUAL(2, kbvas_count_batch(kbvas));
+	CHECK_TRUE(kbvas_is_batch_ready(kbvas));
+
+	kbvas_clear_batch(kbvas);
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+	CHECK_FALSE(kbvas_is_batch_ready(kbvas));
+}
+
+TEST(KBVAS, countBatch_ShouldCountFirstEntry_WhenOverBudgetAlone) {
+	kbvas_set_batch_count(kbvas, KBVAS_MAX_BATCH_COUNT);
+	kbvas_set_batch_bytes(kbvas, 2);
+
+	kbvas_enqueue(kbvas, SOC_FRAME("\x01"), SOC_FRAME_SIZE);
+	kbvas_enqueue(kbvas, SOC_FRAME("\x02"), SOC_FRAME_SIZE);
+
+	LONGS_EQUAL(1, kbvas_count_batch(kbvas));
+}
+
+TEST(KBVAS, batchCallback_ShouldBeCalled_WhenOldestEntryExceedsAge) {
+	int call_count = 0;
+
+	kbvas_register_batch_callback(kbvas, on_batch_callback, &call_count);
+	kbvas_set_batch_count(kbvas, KBVAS_MAX_BATCH_COUNT);
+	kbvas_set_batch_age(kbvas, 60);
+
+	mock().expectOneCall("on_batch_callback")
+		.withPointerParameter("self", kbvas)
+		.withPointerParameter("ctx", &call_count);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x64", 6); // 100
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x9f", 6); // 159
+	LONGS_EQUAL(0, call_count);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\xa0", 6); // 160
+	LONGS_EQUAL(1, call_count);
+}
+
+TEST(KBVAS, pollBatch_ShouldInvokeCallback_WhenAgeExceededWithoutNewFrames) {
+	int call_count = 0;
+
+	kbvas_register_batch_callback(kbvas, on_batch_callback, &call_count);
+	kbvas_set_batch_count(kbvas, KBVAS_MAX_BATCH_COUNT);
+	kbvas_set_batch_age(kbvas, 60);
+
+	mock().expectOneCall("on_batch_callback")
+		.withPointerParameter("self", kbvas)
+		.withPointerParameter("ctx", &call_count);
+	kbvas_poll_batch(kbvas, 1000); // nothing queued
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x64", 6); // 100
+	kbvas_poll_batch(kbvas, 159);
+	LONGS_EQUAL(0, call_count);
+	kbvas_poll_batch(kbvas, 160);
+	LONGS_EQUAL(1, call_count);
+}
+
+TEST(KBVAS, batchAge_ShouldFollowOldestEntry_WhenEntriesRemoved) {
+	kbvas_set_batch_count(kbvas, KBVAS_MAX_BATCH_COUNT);
+	kbvas_set_batch_age(kbvas, 60);
+
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x64", 6); // 100
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x82", 6); // 130
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\xa0", 6); // 160
+	CHECK_TRUE(kbvas_is_batch_ready(kbvas));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(kbvas, NULL));
+	CHECK_FALSE(kbvas_is_batch_ready(kbvas));
+
+	kbvas_clear(kbvas);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x01\x00", 6); // 256
+	CHECK_FALSE(kbvas_is_batch_ready(kbvas));
+}
+
+TEST(KBVAS, setBatchBytes_ShouldTakeInEntriesAlreadyQueued) {
+	kbvas_set_batch_count(kbvas, KBVAS_MAX_BATCH_COUNT);
+
+	kbvas_enqueue(kbvas, SOC_FRAME("\x01"), SOC_FRAME_SIZE);
+	kbvas_enqueue(kbvas, SOC_FRAME("\x02"), SOC_FRAME_SIZE);
+	CHECK_FALSE(kbvas_is_batch_ready(kbvas));
+
+	kbvas_set_batch_bytes(kbvas, 8);
+	LONGS_EQUAL(8, kbvas_get_batch_bytes(kbvas));
+	CHECK_TRUE(kbvas_is_batch_ready(kbvas));
+
+	kbvas_set_batch_bytes(kbvas, 0);
+	CHECK_FALSE(kbvas_is_batch_ready(kbvas));
+}
+
+TEST(KBVAS, setBatchAge_ShouldRejectNegative) {
+	kbvas_set_batch_age(kbvas, 60);
+	kbvas_set_batch_age(kbvas, -1);
+	LONGS_EQUAL(60, kbvas_get_batch_age(kbvas));
+}
+
+static time_t peek_timestamp(struct kbvas *kbvas, size_t index) {
+	struct kbvas_entry entry;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, (int)index, &entry));
+	return entry.timestamp;
+}
+
+TEST(KBVAS, checkout_ShouldTakeOldestEntries_AndLeaveThemQueued) {
+	kbvas_batch_id_t first, second, third;
+	size_t index, count;
+
+	kbvas_set_batch_count(kbvas, 2);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x01", 6);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x02", 6);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x03", 6);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_checkout_batch(kbvas, 0, &first));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_checkout_batch(kbvas, 0, &second));
+	LONGS_EQUAL(KBVAS_ERROR_EMPTY, kbvas_checkout_batch(kbvas, 0, &third));
+	CHECK(first != second);
+	LONGS_EQUAL(3, kbvas_count(kbvas));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_locate_batch(kbvas, first, &index, &count));
+	LONGS_EQUAL(0, index);
+	LONGS_EQUAL(2, count);
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_locate_batch(kbvas, second, &index, &count));
+	LONGS_EQUAL(2, index);
+	LONGS_EQUAL(1, count);
+}
+
+TEST(KBVAS, ack_ShouldRemoveEntries_InQueueOrder) {
+	kbvas_batch_id_t first, second;
+	size_t index, count;
+
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x01", 6);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x02", 6);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x03", 6);
+
+	kbvas_checkout_batch(kbvas, 1, &first);
+	kbvas_checkout_batch(kbvas, 1, &second);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_ack_batch(kbvas, second));
+	LONGS_EQUAL(3, kbvas_count(kbvas));
+	LONGS_EQUAL(KBVAS_ERROR_NOENT,
+			kbvas_locate_batch(kbvas, second, &index, &count));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_ack_batch(kbvas, first));
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+	LONGS_EQUAL(3, peek_timestamp(kbvas, 0));
+}
+
+TEST(KBVAS, ack_ShouldFail_WhenNotCheckedOut) {
+	kbvas_batch_id_t id;
+
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_ack_batch(kbvas, 1));
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_nack_batch(kbvas, 1));
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_ack_batch(kbvas, 0));
+
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x01", 6);
+	kbvas_checkout_batch(kbvas, 1, &id);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_ack_batch(kbvas, id));
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_ack_batch(kbvas, id));
+}
+
+TEST(KBVAS, nack_ShouldReturnEntries_ToBeCheckedOutFirst) {
+	kbvas_batch_id_t first, second, retry;
+	size_t index, count;
+
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x01", 6);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x02", 6);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x03", 6);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x04", 6);
+
+	kbvas_checkout_batch(kbvas, 2, &first);
+	kbvas_checkout_batch(kbvas, 1, &second);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_nack_batch(kbvas, first));
+
+	/* a part of the returned entries, then the rest of them */
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_checkout_batch(kbvas, 1, &retry));
+	kbvas_locate_batch(kbvas, retry, &index, &count);
+	LONGS_EQUAL(0, index);
+	LONGS_EQUAL(1, count);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_checkout_batch(kbvas, 5, &retry));
+	kbvas_locate_batch(kbvas, retry, &index, &count);
+	LONGS_EQUAL(1, index);
+	LONGS_EQUAL(1, count);
+
+	/* then what follows the other checkouts */
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_checkout_batch(kbvas, 5, &retry));
+	kbvas_locate_batch(kbvas, retry, &index, &count);
+	LONGS_EQUAL(3, index);
+	LONGS_EQUAL(1, count);
+}
+
+TEST(KBVAS, nack_ShouldRejoinQueue_WhenLastCheckedOut) {
+	kbvas_batch_id_t first, second;
+	size_t index, count;
+
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x01", 6);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x02", 6);
+	kbvas_checkout_batch(kbvas, 1, &first);
+	kbvas_checkout_batch(kbvas, 1, &second);
+	kbvas_nack_batch(kbvas, second);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x03", 6);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_checkout_batch(kbvas, 5, &second));
+	kbvas_locate_batch(kbvas, second, &index, &count);
+	LONGS_EQUAL(1, index);
+	LONGS_EQUAL(2, count);
+}
+
+TEST(KBVAS, checkout_ShouldFail_WhenTooManyCheckedOut) {
+	kbvas_batch_id_t id;
+
+	for (int i = 0; i <= KBVAS_MAX_CHECKOUTS; i++) {
+		kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x01", 6);
+	}
+	for (int i = 0; i < KBVAS_MAX_CHECKOUTS; i++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE,
+				kbvas_checkout_batch(kbvas, 1, &id));
+	}
+
+	LONGS_EQUAL(KBVAS_ERROR_NOSPC, kbvas_checkout_batch(kbvas, 1, &id));
+}
+
+TEST(KBVAS, batchReady_ShouldNotCountCheckedOutEntries) {
+	kbvas_batch_id_t id;
+
+	kbvas_set_batch_count(kbvas, 2);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x01", 6);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x02", 6);
+	CHECK_TRUE(kbvas_is_batch_ready(kbvas));
+
+	kbvas_checkout_batch(kbvas, 0, &id);
+	CHECK_FALSE(kbvas_is_batch_ready(kbvas));
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x03", 6);
+	kbvas_enqueue(kbvas, "\xA1\x04\x00\x00\x00\x04", 6);
+	CHECK_TRUE(kbvas_is_batch_ready(kbvas));
+}
+
+TEST(KBVAS, checkout_ShouldKeepToByteBudgetAndAge) {
+	kbvas_batch_id_t first, second;
+	size_t index, count;
+
+	kbvas_set_batch_count(kbvas, KBVAS_MAX_BATCH_COUNT);
+	kbvas_set_batch_bytes(kbvas, 8);
+	kbvas_set_batch_age(kbvas, 60);
+	kbvas_enqueue(kbvas, SOC_FRAME("\x64"), SOC_FRAME_SIZE); // 100
+	kbvas_enqueue(kbvas, SOC_FRAME("\x65"), SOC_FRAME_SIZE);
+	kbvas_enqueue(kbvas, SOC_FRAME("\x66"), SOC_FRAME_SIZE);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_checkout_batch(kbvas, 0, &first));
+	kbvas_locate_batch(kbvas, first, &index, &count);
+	LONGS_EQUAL(2, count);
+	CHECK_FALSE(kbvas_is_batch_ready(kbvas));
+
+	/* the oldest entry not checked out is from 102 */
+	kbvas_set_batch_bytes(kbvas, 0);
+	kbvas_enqueue(kbvas, SOC_FRAME("\xa1"), SOC_FRAME_SIZE); // 161
+	CHECK_FALSE(kbvas_is_batch_ready(kbvas));
+	kbvas_enqueue(kbvas, SOC_FRAME("\xa2"), SOC_FRAME_SIZE); // 162
+	CHECK_TRUE(kbvas_is_batch_ready(kbvas));
+
+	/* the returned ones are older again */
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_checkout_batch(kbvas, 0, &second));
+	CHECK_FALSE(kbvas_is_batch_ready(kbvas));
+	kbvas_nack_batch(kbvas, first);
+	CHECK_TRUE(kbvas_is_batch_ready(kbvas));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_ack_batch(kbvas, second));
+	LONGS_EQUAL(5, kbvas_count(kbvas));
+}
+
 TEST(KBVAS, peek_ShouldReturnCorrectEntry_WithPositiveIndex) {
 	// Enqueue sample data entries
 	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, sample1, sizeof(sample1)));
@@ -937,3 +1263,382 @@ TEST(KBVAS, peek_ShouldNotModifyQueue_WhenAccessingDifferentIndices) {
 
 	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_dequeue(kbvas, &entry));
 }
+
+static bool count_record_iterator(struct kbvas *self,
+		const struct kbvas_record *record, void *ctx) {
+	size_t *total_len = (size_t *)ctx;
+	*total_len += record->len;
+	return true;
+}
+
+TEST(KBVAS, peekRecord_ShouldReturnOnlyEncodedBytes) {
+	struct kbvas_entry entry;
+	struct kbvas_record record;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, sample1, sizeof(sample1)));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek(kbvas, 0, &entry));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, 0, &record));
+
+	LONGS_EQUAL(entry.timestamp, record.timestamp);
+	LONGS_EQUAL(strlen(entry.base64_encoded), record.len);
+	CHECK(record.len < sizeof(entry));
+	MEMCMP_EQUAL(entry.base64_encoded, record.data, record.len);
+}
+
+TEST(KBVAS, peekRecord_ShouldFail_WhenEmpty) {
+	struct kbvas_record record;
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_peek_record(kbvas, 0, &record));
+	LONGS_EQUAL(KBVAS_ERROR_MISSING_PARAM, kbvas_peek_record(kbvas, 0, NULL));
+}
+
+TEST(KBVAS, decodeRecord_ShouldExpandToEntry) {
+	struct kbvas_entry entry;
+	struct kbvas_record record;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, sample2, sizeof(sample2)));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_record(kbvas, -1, &record));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_decode_record(&record, &entry));
+
+	LONGS_EQUAL(sizeof(expected2), sizeof(entry));
+	LONGS_EQUAL(0, memcmp(expected2, &entry, sizeof(expected2)));
+}
+
+TEST(KBVAS, iterateRecords_ShouldVisitAll) {
+	struct kbvas_record record1, record2;
+	size_t total_len = 0;
+
+	kbvas_enqueue(kbvas, sample1, sizeof(sample1));
+	kbvas_enqueue(kbvas, sample2, sizeof(sample2));
+	kbvas_peek_record(kbvas, 0, &record1);
+	kbvas_peek_record(kbvas, 1, &record2);
+
+	kbvas_iterate_records(kbvas, count_record_iterator, &total_len);
+	LONGS_EQUAL(record1.len + record2.len, total_len);
+}
+
+static kbvas_error_t feed_in_chunks(struct kbvas_stream *stream,
+		const uint8_t *data, size_t datasize, size_t chunk_size) {
+	kbvas_error_t err = kbvas_stream_begin(stream, datasize);
+
+	for (size_t i = 0; err == KBVAS_ERROR_NONE && i < datasize; i += chunk_size) {
+		size_t n = datasize - i < chunk_size ? datasize - i : chunk_size;
+		err = kbvas_stream_feed(stream, &data[i], n);
+	}
+
+	return err;
+}
+
+TEST(KBVAS, stream_ShouldEnqueueSameEntryAsEnqueue_WhenFedInChunks) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+	struct kbvas_entry entry;
+
+	for (size_t chunk_size = 1; chunk_size <= 8; chunk_size++) {
+		LONGS_EQUAL(KBVAS_ERROR_NONE,
+				feed_in_chunks(stream, sample1, sizeof(sample1), chunk_size));
+		LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(kbvas, &entry));
+		LONGS_EQUAL(0, memcmp(expected1, &entry, sizeof(expected1)));
+	}
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			feed_in_chunks(stream, sample2, sizeof(sample2), 100));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(kbvas, &entry));
+	LONGS_EQUAL(0, memcmp(expected2, &entry, sizeof(expected2)));
+
+	kbvas_stream_destroy(stream);
+}
+
+TEST(KBVAS, stream_ShouldAcceptExtendedTags) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+	struct kbvas_entry expected;
+	struct kbvas_entry entry;
+
+	kbvas_enqueue(kbvas, extended_sample, sizeof(extended_sample));
+	kbvas_dequeue(kbvas, &expected);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			feed_in_chunks(stream, extended_sample, sizeof(extended_sample), 3));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue(kbvas, &entry));
+	LONGS_EQUAL(0, memcmp(&expected, &entry, sizeof(entry)));
+
+	kbvas_stream_destroy(stream);
+}
+
+TEST(KBVAS, stream_ShouldNotEnqueue_UntilFrameCompletes) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_begin(stream, sizeof(dummy_sample1)));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_feed(stream, dummy_sample1, 5));
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_feed(stream, &dummy_sample1[5], 1));
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_stream_feed(stream, dummy_sample2, 1));
+
+	kbvas_stream_destroy(stream);
+}
+
+TEST(KBVAS, stream_ShouldRejectTruncatedTLV) {
+	const uint8_t multi_tlv[] = {
+		0xA1, 0x04, 0x00, 0x00, 0x00, 0x01,
+		0xA7, 0x00, 0xFF
+	};
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT,
+			feed_in_chunks(stream, multi_tlv, sizeof(multi_tlv), 4));
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+
+	kbvas_stream_destroy(stream);
+}
+
+TEST(KBVAS, stream_ShouldKeepReturningError_UntilFrameEnds) {
+	const uint8_t unknown_type[] = {0xFF, 0x02, 0x00, 0x01, 0x00, 0x00};
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_begin(stream, sizeof(unknown_type)));
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, kbvas_stream_feed(stream, unknown_type, 3));
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, kbvas_stream_feed(stream, &unknown_type[3], 3));
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_stream_feed(stream, unknown_type, 1));
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+
+	kbvas_stream_destroy(stream);
+}
+
+TEST(KBVAS, stream_ShouldRejectChunkBeyondFrameSize) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, kbvas_stream_begin(stream, 2));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_stream_begin(stream, 6));
+	LONGS_EQUAL(KBVAS_ERROR_OUT_OF_RANGE_VALUE,
+			kbvas_stream_feed(stream, sample1, sizeof(sample1)));
+
+	kbvas_stream_destroy(stream);
+}
+
+TEST(KBVAS, stream_ShouldInvokeBatchCallback_WhenBatchReady) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+	int call_count = 0;
+
+	kbvas_register_batch_callback(kbvas, on_batch_callback, &call_count);
+	kbvas_set_batch_count(kbvas, 2);
+
+	mock().expectOneCall("on_batch_callback")
+		.withPointerParameter("self", kbvas)
+		.withPointerParameter("ctx", &call_count);
+	feed_in_chunks(stream, dummy_sample1, sizeof(dummy_sample1), 2);
+	feed_in_chunks(stream, dummy_sample2, sizeof(dummy_sample2), 2);
+	LONGS_EQUAL(1, call_count);
+
+	kbvas_stream_destroy(stream);
+}
+
+TEST(KBVAS, tlvNext_ShouldWalkAllTLVsWithoutCopying) {
+	const uint8_t expected_types[] = {
+		KBVAS_TLV_TIMESTAMP, KBVAS_TLV_VIN, KBVAS_TLV_SOC, KBVAS_TLV_SOH,
+		KBVAS_TLV_BPA, KBVAS_TLV_BPV, KBVAS_TLV_BSV, KBVAS_TLV_BMT,
+	};
+	struct kbvas_tlv_cursor cursor;
+	struct kbvas_tlv tlv;
+	size_t i = 0;
+
+	kbvas_tlv_cursor_init(&cursor, sample1, sizeof(sample1));
+
+	while (kbvas_tlv_next(&cursor, &tlv) == KBVAS_ERROR_NONE) {
+		LONGS_EQUAL(expected_types[i++], tlv.type);
+		CHECK(tlv.value > sample1 && tlv.value < sample1 + sizeof(sample1));
+	}
+
+	LONGS_EQUAL(sizeof(expected_types), i);
+	LONGS_EQUAL(sizeof(sample1), cursor.offset);
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_tlv_next(&cursor, &tlv));
+}
+
+TEST(KBVAS, tlvFind_ShouldReturnTypedFields) {
+	struct kbvas_tlv tlv;
+	uint8_t soc;
+	uint16_t bpv;
+	uint32_t timestamp;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_find(sample1, sizeof(sample1),
+			KBVAS_TLV_SOC, &tlv));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_get_u8(&tlv, &soc));
+	LONGS_EQUAL(0xc6, soc);
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, kbvas_tlv_get_u16(&tlv, &bpv));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_find(sample1, sizeof(sample1),
+			KBVAS_TLV_BPV, &tlv));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_get_u16(&tlv, &bpv));
+	LONGS_EQUAL(0x2041, bpv);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_find(sample1, sizeof(sample1),
+			KBVAS_TLV_TIMESTAMP, &tlv));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_get_u32(&tlv, &timestamp));
+	LONGS_EQUAL(0x66bc6d23, timestamp);
+
+	LONGS_EQUAL(KBVAS_ERROR_NOENT, kbvas_tlv_find(sample1, sizeof(sample1),
+			KBVAS_TLV_COUNTER, &tlv));
+}
+
+TEST(KBVAS, tlvFind_ShouldReturnExtendedTags) {
+	struct kbvas_tlv tlv;
+	uint32_t counter;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_find(extended_sample,
+			sizeof(extended_sample), KBVAS_TLV_COUNTER, &tlv));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_get_u32(&tlv, &counter));
+	LONGS_EQUAL(0x100, counter);
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_find(extended_sample,
+			sizeof(extended_sample), KBVAS_TLV_BATTERY_ID, &tlv));
+	LONGS_EQUAL(4, tlv.length);
+	MEMCMP_EQUAL("BAT1", tlv.value, 4);
+}
+
+TEST(KBVAS, tlvNext_ShouldFailWithoutAdvancing_WhenTruncated) {
+	const uint8_t multi_tlv[] = {
+		0xA1, 0x04, 0x00, 0x00, 0x00, 0x01,
+		0xA7, 0x00, 0xFF
+	};
+	struct kbvas_tlv_cursor cursor;
+	struct kbvas_tlv tlv;
+
+	kbvas_tlv_cursor_init(&cursor, multi_tlv, sizeof(multi_tlv));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_tlv_next(&cursor, &tlv));
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, kbvas_tlv_next(&cursor, &tlv));
+	LONGS_EQUAL(6, cursor.offset);
+}
+
+TEST(KBVAS, dequeueMany_ShouldPeekAndDropAtOnce_WhenBackendStoresRecords) {
+	struct kbvas_entry entries[3];
+	size_t n;
+
+	kbvas_enqueue(kbvas, sample1, sizeof(sample1));
+	kbvas_enqueue(kbvas, sample2, sizeof(sample2));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_dequeue_many(kbvas, entries, 3, &n));
+	LONGS_EQUAL(2, n);
+	LONGS_EQUAL(0x66bc6d23, entries[0].timestamp);
+	LONGS_EQUAL(0x66bc6d24, entries[1].timestamp);
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE,
+			kbvas_enqueue_entries(kbvas, entries, n, &n));
+	LONGS_EQUAL(2, n);
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_range(kbvas, 0, entries, 3, &n));
+	LONGS_EQUAL(2, n);
+	LONGS_EQUAL(0x66bc6d24, entries[1].timestamp);
+}
+
+static kbvas_error_t (*backend_count)(struct kbvas_backend *self,
+		size_t *count, void *ctx);
+
+static kbvas_error_t count_linearly(struct kbvas_backend *self,
+		size_t *count, void *ctx) {
+	mock().actualCall("count");
+	return (*backend_count)(self, count, ctx);
+}
+
+TEST(KBVAS, count_ShouldBeKeptByKbvas_WhenBackendCountIsNotConstant) {
+	backend_count = backend->count;
+	backend->count = count_linearly;
+	backend->caps = KBVAS_BACKEND_CAP_KBVAS_ONLY;
+	mock().expectOneCall("count");
+
+	kbvas_set_batch_count(kbvas, 2);
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+	CHECK(kbvas_is_batch_ready(kbvas));
+	kbvas_clear_batch(kbvas);
+	kbvas_dequeue(kbvas, NULL);
+
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+	kbvas_enqueue(kbvas, dummy_sample4, sizeof(dummy_sample4));
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+	kbvas_clear(kbvas);
+	LONGS_EQUAL(0, kbvas_count(kbvas));
+}
+
+TEST(KBVAS, count_ShouldBeAskedEveryTime_WhenBackendMakesNoPromise) {
+	backend_count = backend->count;
+	backend->count = count_linearly;
+	backend->caps = 0;
+	mock().expectNCalls(2, "count");
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+	LONGS_EQUAL(1, kbvas_count(kbvas));
+}
+
+TEST(KBVAS, peekRange_ShouldWalkOnce_WhenBackendPeekIsNotRandomAccess) {
+	struct kbvas_entry entries[2];
+	size_t n;
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+	backend->peek_record = NULL;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_peek_range(kbvas, 1, entries, 2, &n));
+	LONGS_EQUAL(2, n);
+	LONGS_EQUAL(2, entries[0].timestamp);
+	LONGS_EQUAL(3, entries[1].timestamp);
+}
+
+TEST(KBVAS, enqueue_ShouldDropDuplicates_WhenDedupWindowSet) {
+	uint64_t bytes;
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_set_dedup_window(kbvas, 2));
+
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, sample1, sizeof(sample1)));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, sample1, sizeof(sample1)));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, sample2, sizeof(sample2)));
+	LONGS_EQUAL(KBVAS_ERROR_NONE, kbvas_enqueue(kbvas, sample2, sizeof(sample2)));
+
+	LONGS_EQUAL(2, kbvas_count(kbvas));
+	LONGS_EQUAL(2, kbvas_count_duplicates(kbvas, &bytes));
+	LONGS_EQUAL(sizeof(sample1) + sizeof(sample2), bytes);
+}
+
+TEST(KBVAS, enqueue_ShouldKeepDuplicates_WhenOutOfDedupWindow) {
+	kbvas_set_dedup_window(kbvas, 2);
+
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample2, sizeof(dummy_sample2));
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample3, sizeof(dummy_sample3));
+
+	LONGS_EQUAL(4, kbvas_count(kbvas));
+	LONGS_EQUAL(1, kbvas_count_duplicates(kbvas, NULL));
+}
+
+TEST(KBVAS, enqueue_ShouldKeepDuplicates_WhenNoDedupWindow) {
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+
+	LONGS_EQUAL(2, kbvas_count(kbvas));
+	LONGS_EQUAL(0, kbvas_count_duplicates(kbvas, NULL));
+}
+
+TEST(KBVAS, enqueue_ShouldNotRememberFrame_WhenRejected) {
+	const uint8_t bad[] = { 0xA1, 0x04, 0x00, 0x00, 0x00, 0x01, 0xA3 };
+
+	kbvas_set_dedup_window(kbvas, 4);
+
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, kbvas_enqueue(kbvas, bad, sizeof(bad)));
+	LONGS_EQUAL(KBVAS_ERROR_INVALID_FORMAT, kbvas_enqueue(kbvas, bad, sizeof(bad)));
+	LONGS_EQUAL(0, kbvas_count_duplicates(kbvas, NULL));
+}
+
+TEST(KBVAS, setDedupWindow_ShouldForgetFingerprints) {
+	kbvas_set_dedup_window(kbvas, 4);
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+
+	kbvas_set_dedup_window(kbvas, 4);
+	kbvas_enqueue(kbvas, dummy_sample1, sizeof(dummy_sample1));
+
+	LONGS_EQUAL(2, kbvas_count(kbvas));
+	LONGS_EQUAL(KBVAS_ERROR_MISSING_PARAM, kbvas_set_dedup_window(NULL, 4));
+}
@@ -0,0 +1,172 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+
+#include "kbvas.h"
+#include "kbvas_ring_backend.h"
+#include "kbvas_clock.h"
+#include "test_frames.h"
+
+#define MAX_EVENTS		32
+
+struct event {
+	kbvas_trace_point_t point;
+	bool begin;
+	uint64_t timestamp;
+};
+
+struct trace {
+	struct event events[MAX_EVENTS];
+	size_t n;
+};
+
+static void record(struct kbvas *self, kbvas_trace_point_t point,
+		bool begin, uint64_t timestamp, void *ctx) {
+	struct trace *trace = (struct trace *)ctx;
+
+	if (trace->n < MAX_EVENTS) {
+		trace->events[trace->n++] = (struct event) {
+			.point = point,
+			.begin = begin,
+			.timestamp = timestamp,
+		};
+	}
+}
+
+static void on_batch(struct kbvas *self, void *ctx) {
+}
+
+static bool visit(struct kbvas *self, const struct kbvas_entry *entry,
+		void *ctx) {
+	return true;
+}
+
+TEST_GROUP(KBVAS_TRACE) {
+	struct kbvas *kbvas;
+	struct kbvas_backend_api *backend;
+	struct trace trace;
+
+	void setup(void) {
+		fake_ticks = 0;
+		fake_step = 1;
+		trace.n = 0;
+		backend = kbvas_ring_backend_create(4,
+				KBVAS_RING_OVERFLOW_REJECT);
+		kbvas = kbvas_create(backend, NULL);
+		kbvas_register_trace_hook(kbvas, record, &trace);
+	}
+	void teardown(void) {
+		kbvas_destroy(kbvas);
+		kbvas_ring_backend_destroy(backend);
+
+		mock().checkExpectations();
+		mock().clear();
+	}
+
+	void check_event(size_t i, kbvas_trace_point_t point, bool begin) {
+		CHECK(i < trace.n);
+		LONGS_EQUAL(point, trace.events[i].point);
+		CHECK_EQUAL(begin, trace.events[i].begin);
+	}
+};
+
+TEST(KBVAS_TRACE, registerTraceHook_ShouldReturnMissingParam_WhenNullGiven) {
+	LONGS_EQUAL(KBVAS_ERROR_MISSING_PARAM,
+			kbvas_register_trace_hook(NULL, record, &trace));
+}
+
+TEST(KBVAS_TRACE, enqueue_ShouldTraceParseEncodeAndPushInTurn) {
+	enqueue_at(kbvas, 1);
+
+	LONGS_EQUAL(6, trace.n);
+	check_event(0, KBVAS_TRACE_PARSE, true);
+	check_event(1, KBVAS_TRACE_PARSE, false);
+	check_event(2, KBVAS_TRACE_ENCODE, true);
+	check_event(3, KBVAS_TRACE_ENCODE, false);
+	check_event(4, KBVAS_TRACE_PUSH, true);
+	check_event(5, KBVAS_TRACE_PUSH, false);
+}
+
+TEST(KBVAS_TRACE, enqueue_ShouldTraceBatchCallback_WhenBatchReady) {
+	kbvas_register_batch_callback(kbvas, on_batch, NULL);
+	kbvas_set_batch_count(kbvas, 1);
+
+	enqueue_at(kbvas, 1);
+
+	LONGS_EQUAL(8, trace.n);
+	check_event(6, KBVAS_TRACE_BATCH_CALLBACK, true);
+	check_event(7, KBVAS_TRACE_BATCH_CALLBACK, false);
+}
+
+TEST(KBVAS_TRACE, iterate_ShouldBeTraced) {
+	kbvas_iterate(kbvas, visit, NULL);
+
+	LONGS_EQUAL(2, trace.n);
+	check_event(0, KBVAS_TRACE_ITERATE, true);
+	check_event(1, KBVAS_TRACE_ITERATE, false);
+}
+
+TEST(KBVAS_TRACE, stream_ShouldTraceParsePerChunkFed) {
+	struct kbvas_stream *stream = kbvas_stream_create(kbvas);
+
+	kbvas_stream_begin(stream, SOC_FRAME_SIZE);
+	kbvas_stream_feed(stream, SOC_FRAME("\x01"), 4);
+	kbvas_stream_feed(stream, SOC_FRAME("\x01") + 4, SOC_FRAME_SIZE - 4);
+	kbvas_stream_destroy(stream);
+
+	size_t parses = 0;
+	size_t pushes = 0;
+	for (size_t i = 0; i < trace.n; i++) {
+		parses += trace.events[i].point == KBVAS_TRACE_PARSE &&
+			trace.events[i].begin;
+		pushes += trace.events[i].point == KBVAS_TRACE_PUSH &&
+			trace.events[i].begin;
+	}
+	LONGS_EQUAL(2, parses);
+	LONGS_EQUAL(1, pushes);
+	check_event(trace.n - 1, KBVAS_TRACE_PUSH, false);
+}
+
+TEST(KBVAS_TRACE, timestamps_ShouldBeZero_WhenNoClockSet) {
+	enqueue_at(kbvas, 1);
+
+	for (size_t i = 0; i < trace.n; i++) {
+		LONGS_EQUAL(0, trace.events[i].timestamp);
+	}
+}
+
+TEST(KBVAS_TRACE, timestamps_ShouldBeReadFromClock_WhenSet) {
+	kbvas_set_clock(kbvas, fake_clock);
+
+	enqueue_at(kbvas, 1);
+
+	for (size_t i = 0; i < trace.n; i++) {
+		LONGS_EQUAL(i, trace.events[i].timestamp);
+	}
+}
+
+TEST(KBVAS_TRACE, hook_ShouldNotBeCalled_WhenUnregistered) {
+	kbvas_register_trace_hook(kbvas, NULL, NULL);
+
+	enqueue_at(kbvas, 1);
+
+	LONGS_EQUAL(0, trace.n);
+}
+
+#if defined(KBVAS_CLOCK_HAS_MONOTONIC)
+TEST(KBVAS_TRACE, timestamps_ShouldNotGoBack_WhenMonotonicClockSet) {
+	kbvas_set_clock(kbvas, kbvas_clock_monotonic_ns);
+
+	enqueue_at(kbvas, 1);
+
+	CHECK(trace.events[0].timestamp > 0);
+	for (size_t i = 1; i < trace.n; i++) {
+		CHECK(trace.events[i].timestamp >= trace.events[i - 1].timestamp);
+	}
+}
+#endif
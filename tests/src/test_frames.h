@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2025 권경환 Kyunghwan Kwon <k@pazzk.net>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TEST_FRAMES_H
+#define TEST_FRAMES_H
+
+#include <string.h>
+#include "kbvas.h"
+
+/* A timestamp and a state of charge, the smallest frame worth storing */
+#define SOC_FRAME(ts)		"\xA1\x04\x00\x00\x00" ts "\xA3\x01\x10"
+#define SOC_FRAME_SIZE		9
+
+static inline kbvas_error_t enqueue_at(struct kbvas *kbvas, uint8_t ts)
+{
+	uint8_t frame[SOC_FRAME_SIZE];
+
+	memcpy(frame, SOC_FRAME("\x00"), sizeof(frame));
+	frame[5] = ts;
+
+	return kbvas_enqueue(kbvas, frame, sizeof(frame));
+}
+
+static uint64_t fake_ticks;
+static uint64_t fake_step;
+
+/* A clock for kbvas_set_clock() that advances by fake_step on every read,
+ * so each measured operation takes fake_step ticks times the clock reads
+ * in between, plus one */
+static inline uint64_t fake_clock(void)
+{
+	uint64_t now = fake_ticks;
+	fake_ticks += fake_step;
+	return now;
+}
+
+/* Appends the timestamp of each record to the array ctx points to */
+static inline bool collect_timestamps(struct kbvas *self,
+		const struct kbvas_record *record, void *ctx)
+{
+	time_t **p = (time_t **)ctx;
+	*(*p)++ = record->timestamp;
+	return true;
+}
+
+/* Fields of a TLV frame. All but the timestamp are left out when 0 or NULL,
+ * so a SOC or BPV of 0 cannot be given */
+struct test_frame {
+	uint32_t timestamp;
+	const char *vin;		/* 17 characters */
+	uint8_t soc;
+	uint16_t bpv;
+	const uint8_t *cells;		/* made up if NULL and ncells given */
+	uint16_t ncells;
+	const uint8_t *modules;
+	uint8_t nmodules;
+};
+
+static inline size_t make_frame(uint8_t *buf, const struct test_frame *f)
+{
+	size_t n = 0;
+
+	buf[n++] = KBVAS_TLV_TIMESTAMP; buf[n++] = 4;
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		buf[n++] = (uint8_t)(f->timestamp >> shift);
+	}
+	if (f->vin) {
+		buf[n++] = KBVAS_TLV_VIN; buf[n++] = 17;
+		memcpy(&buf[n], f->vin, 17); n += 17;
+	}
+	if (f->soc) {
+		buf[n++] = KBVAS_TLV_SOC; buf[n++] = 1; buf[n++] = f->soc;
+	}
+	if (f->bpv) {
+		buf[n++] = KBVAS_TLV_BPV; buf[n++] = 2;
+		buf[n++] = (uint8_t)(f->bpv >> 8); buf[n++] = (uint8_t)f->bpv;
+	}
+	if (f->ncells) {
+		buf[n++] = KBVAS_TLV_BSV;
+		buf[n++] = (uint8_t)(f->ncells >> 8);
+		buf[n++] = (uint8_t)f->ncells;
+		for (uint16_t i = 0; i < f->ncells; i++) {
+			buf[n++] = f->cells? f->cells[i] : (uint8_t)(0x96 + i % 7);
+		}
+	}
+	if (f->nmodules) {
+		buf[n++] = KBVAS_TLV_BMT; buf[n++] = f->nmodules;
+		memcpy(&buf[n], f->modules, f->nmodules); n += f->nmodules;
+	}
+
+	return n;
+}
+
+#endif /* TEST_FRAMES_H */